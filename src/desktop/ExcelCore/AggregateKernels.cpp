@@ -0,0 +1,524 @@
+#include "AggregateKernels.h"
+#include "ColumnStore.h"
+#include "DataStructures.h"
+#include "EvaluationArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define EXCELCORE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define EXCELCORE_TARGET_SSE2
+#define EXCELCORE_TARGET_AVX2
+#else
+#define EXCELCORE_TARGET_SSE2 __attribute__((target("sse2")))
+#define EXCELCORE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace ExcelCore {
+
+namespace {
+
+constexpr uint8_t kNumberTag = static_cast<uint8_t>(CellType::Number);
+constexpr uint8_t kDateTag = static_cast<uint8_t>(CellType::Date);
+constexpr uint8_t kErrorTag = static_cast<uint8_t>(CellType::Error);
+
+// Neumaier's variant of Kahan summation: also exact when the term is larger than the sum
+inline void compensatedAdd(double& sum, double& compensation, double value) {
+    double total = sum + value;
+    if (std::fabs(sum) >= std::fabs(value)) {
+        compensation += (sum - total) + value;
+    } else {
+        compensation += (value - total) + sum;
+    }
+    sum = total;
+}
+
+inline size_t popCount(uint32_t bits) {
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    return static_cast<size_t>((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+
+// Scalar kernels: the fallback on every platform and the tail of the vector loops
+
+double sumScalar(const double* values, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        sum += values[i];
+    }
+    return sum;
+}
+
+double sumCompensatedScalar(const double* values, size_t count) {
+    double sum = 0.0;
+    double compensation = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        compensatedAdd(sum, compensation, values[i]);
+    }
+    return sum + compensation;
+}
+
+double minScalar(const double* values, size_t count) {
+    double result = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < count; ++i) {
+        result = values[i] < result ? values[i] : result;
+    }
+    return result;
+}
+
+double maxScalar(const double* values, size_t count) {
+    double result = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < count; ++i) {
+        result = values[i] > result ? values[i] : result;
+    }
+    return result;
+}
+
+size_t countTagsScalar(const uint8_t* tags, size_t count, uint8_t first, uint8_t second) {
+    size_t matches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        matches += (tags[i] == first || tags[i] == second) ? 1 : 0;
+    }
+    return matches;
+}
+
+// Combines per-lane Kahan sums and compensations into one value
+double combineLanes(const double* sums, const double* compensations, size_t lanes) {
+    double sum = 0.0;
+    double compensation = 0.0;
+    for (size_t lane = 0; lane < lanes; ++lane) {
+        compensatedAdd(sum, compensation, sums[lane]);
+        compensatedAdd(sum, compensation, -compensations[lane]);
+    }
+    return sum + compensation;
+}
+
+#ifdef EXCELCORE_X86
+
+// SSE2 kernels: two doubles / sixteen tags per instruction
+
+EXCELCORE_TARGET_SSE2 double sumSse2(const double* values, size_t count) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(values + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(values + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+    return lanes[0] + lanes[1] + sumScalar(values + i, count - i);
+}
+
+EXCELCORE_TARGET_SSE2 double sumCompensatedSse2(const double* values, size_t count) {
+    __m128d sum = _mm_setzero_pd();
+    __m128d compensation = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d term = _mm_sub_pd(_mm_loadu_pd(values + i), compensation);
+        __m128d total = _mm_add_pd(sum, term);
+        compensation = _mm_sub_pd(_mm_sub_pd(total, sum), term);
+        sum = total;
+    }
+    double sums[2];
+    double compensations[2];
+    _mm_storeu_pd(sums, sum);
+    _mm_storeu_pd(compensations, compensation);
+    double result = 0.0;
+    double tailCompensation = 0.0;
+    compensatedAdd(result, tailCompensation, combineLanes(sums, compensations, 2));
+    if (i < count) {
+        compensatedAdd(result, tailCompensation, values[i]);
+    }
+    return result + tailCompensation;
+}
+
+EXCELCORE_TARGET_SSE2 double minSse2(const double* values, size_t count) {
+    __m128d acc = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        acc = _mm_min_pd(acc, _mm_loadu_pd(values + i));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return std::min({lanes[0], lanes[1], minScalar(values + i, count - i)});
+}
+
+EXCELCORE_TARGET_SSE2 double maxSse2(const double* values, size_t count) {
+    __m128d acc = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        acc = _mm_max_pd(acc, _mm_loadu_pd(values + i));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return std::max({lanes[0], lanes[1], maxScalar(values + i, count - i)});
+}
+
+EXCELCORE_TARGET_SSE2 size_t countTagsSse2(const uint8_t* tags, size_t count, uint8_t first, uint8_t second) {
+    const __m128i firstTag = _mm_set1_epi8(static_cast<char>(first));
+    const __m128i secondTag = _mm_set1_epi8(static_cast<char>(second));
+    size_t matches = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, firstTag), _mm_cmpeq_epi8(block, secondTag));
+        matches += popCount(static_cast<uint32_t>(_mm_movemask_epi8(hits)));
+    }
+    return matches + countTagsScalar(tags + i, count - i, first, second);
+}
+
+// AVX2 kernels: four doubles / thirty-two tags per instruction, with four
+// independent accumulators to hide the latency of the floating-point adds
+
+EXCELCORE_TARGET_AVX2 double sumAvx2(const double* values, size_t count) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    __m256d acc2 = _mm256_setzero_pd();
+    __m256d acc3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(values + i + 4));
+        acc2 = _mm256_add_pd(acc2, _mm256_loadu_pd(values + i + 8));
+        acc3 = _mm256_add_pd(acc3, _mm256_loadu_pd(values + i + 12));
+    }
+    for (; i + 4 <= count; i += 4) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(values + i));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3)));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumScalar(values + i, count - i);
+}
+
+EXCELCORE_TARGET_AVX2 double sumCompensatedAvx2(const double* values, size_t count) {
+    __m256d sum = _mm256_setzero_pd();
+    __m256d compensation = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d term = _mm256_sub_pd(_mm256_loadu_pd(values + i), compensation);
+        __m256d total = _mm256_add_pd(sum, term);
+        compensation = _mm256_sub_pd(_mm256_sub_pd(total, sum), term);
+        sum = total;
+    }
+    double sums[4];
+    double compensations[4];
+    _mm256_storeu_pd(sums, sum);
+    _mm256_storeu_pd(compensations, compensation);
+    double result = 0.0;
+    double tailCompensation = 0.0;
+    compensatedAdd(result, tailCompensation, combineLanes(sums, compensations, 4));
+    for (; i < count; ++i) {
+        compensatedAdd(result, tailCompensation, values[i]);
+    }
+    return result + tailCompensation;
+}
+
+EXCELCORE_TARGET_AVX2 double minAvx2(const double* values, size_t count) {
+    __m256d acc0 = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    __m256d acc1 = acc0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_min_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_min_pd(acc1, _mm256_loadu_pd(values + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_min_pd(acc0, acc1));
+    return std::min({lanes[0], lanes[1], lanes[2], lanes[3], minScalar(values + i, count - i)});
+}
+
+EXCELCORE_TARGET_AVX2 double maxAvx2(const double* values, size_t count) {
+    __m256d acc0 = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    __m256d acc1 = acc0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_max_pd(acc0, _mm256_loadu_pd(values + i));
+        acc1 = _mm256_max_pd(acc1, _mm256_loadu_pd(values + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_max_pd(acc0, acc1));
+    return std::max({lanes[0], lanes[1], lanes[2], lanes[3], maxScalar(values + i, count - i)});
+}
+
+EXCELCORE_TARGET_AVX2 size_t countTagsAvx2(const uint8_t* tags, size_t count, uint8_t first, uint8_t second) {
+    const __m256i firstTag = _mm256_set1_epi8(static_cast<char>(first));
+    const __m256i secondTag = _mm256_set1_epi8(static_cast<char>(second));
+    size_t matches = 0;
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, firstTag), _mm256_cmpeq_epi8(block, secondTag));
+        matches += popCount(static_cast<uint32_t>(_mm256_movemask_epi8(hits)));
+    }
+    return matches + countTagsScalar(tags + i, count - i, first, second);
+}
+
+#endif // EXCELCORE_X86
+
+InstructionSet detectInstructionSet() {
+#ifdef EXCELCORE_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    if (maxLeaf >= 7 && osSavesYmm) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return InstructionSet::AVX2;
+        }
+    }
+    return sse2 ? InstructionSet::SSE2 : InstructionSet::Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return InstructionSet::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return InstructionSet::SSE2;
+    }
+    return InstructionSet::Scalar;
+#endif
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+InstructionSet supportedInstructionSet() {
+    static const InstructionSet supported = detectInstructionSet();
+    return supported;
+}
+
+std::atomic<InstructionSet>& activeInstructionSet() {
+    static std::atomic<InstructionSet> active(supportedInstructionSet());
+    return active;
+}
+
+inline bool isNumericTag(uint8_t tag) {
+    return tag == kNumberTag || tag == kDateTag;
+}
+
+} // namespace
+
+void AggregateResult::add(double value, SummationMode mode) {
+    if (mode == SummationMode::Compensated) {
+        compensatedAdd(sum, compensation, value);
+    } else {
+        sum += value;
+    }
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+    ++count;
+}
+
+void AggregateResult::merge(const AggregateResult& other, SummationMode mode) {
+    if (mode == SummationMode::Compensated) {
+        compensatedAdd(sum, compensation, other.sum);
+        compensation += other.compensation;
+    } else {
+        sum += other.total();
+    }
+    min = other.min < min ? other.min : min;
+    max = other.max > max ? other.max : max;
+    count += other.count;
+    if (error == ErrorCode::None) {
+        error = other.error;
+    }
+}
+
+namespace Aggregates {
+
+double sum(const double* values, size_t count, SummationMode mode) {
+    bool compensated = mode == SummationMode::Compensated;
+    switch (activeInstructionSet().load(std::memory_order_relaxed)) {
+#ifdef EXCELCORE_X86
+        case InstructionSet::AVX2:
+            return compensated ? sumCompensatedAvx2(values, count) : sumAvx2(values, count);
+        case InstructionSet::SSE2:
+            return compensated ? sumCompensatedSse2(values, count) : sumSse2(values, count);
+#endif
+        default:
+            return compensated ? sumCompensatedScalar(values, count) : sumScalar(values, count);
+    }
+}
+
+double min(const double* values, size_t count) {
+    switch (activeInstructionSet().load(std::memory_order_relaxed)) {
+#ifdef EXCELCORE_X86
+        case InstructionSet::AVX2:
+            return minAvx2(values, count);
+        case InstructionSet::SSE2:
+            return minSse2(values, count);
+#endif
+        default:
+            return minScalar(values, count);
+    }
+}
+
+double max(const double* values, size_t count) {
+    switch (activeInstructionSet().load(std::memory_order_relaxed)) {
+#ifdef EXCELCORE_X86
+        case InstructionSet::AVX2:
+            return maxAvx2(values, count);
+        case InstructionSet::SSE2:
+            return maxSse2(values, count);
+#endif
+        default:
+            return maxScalar(values, count);
+    }
+}
+
+size_t countTags(const uint8_t* tags, size_t count, uint8_t first, uint8_t second) {
+    switch (activeInstructionSet().load(std::memory_order_relaxed)) {
+#ifdef EXCELCORE_X86
+        case InstructionSet::AVX2:
+            return countTagsAvx2(tags, count, first, second);
+        case InstructionSet::SSE2:
+            return countTagsSse2(tags, count, first, second);
+#endif
+        default:
+            return countTagsScalar(tags, count, first, second);
+    }
+}
+
+AggregateResult aggregateColumn(const ColumnStore& store, uint32_t column, uint32_t firstRow, uint32_t lastRow,
+                                SummationMode mode) {
+    AggregateResult result;
+    uint32_t chunkCount = store.getChunkCount(column);
+    if (firstRow > lastRow || chunkCount == 0) {
+        return result;
+    }
+
+    uint32_t firstChunk = firstRow / ColumnChunk::kRows;
+    uint32_t lastChunk = std::min(lastRow / ColumnChunk::kRows, chunkCount - 1);
+    for (uint32_t chunkIndex = firstChunk; chunkIndex <= lastChunk; ++chunkIndex) {
+        const ColumnChunk* chunk = store.getChunk(column, chunkIndex);
+        if (chunk == nullptr) {
+            continue;
+        }
+
+        // Rows [begin, end) of this chunk that fall inside the range
+        uint32_t baseRow = chunkIndex * ColumnChunk::kRows;
+        uint32_t begin = std::max(firstRow, baseRow) - baseRow;
+        uint32_t end = std::min(lastRow - baseRow, ColumnChunk::kRows - 1) + 1;
+
+        if (chunk->getMode() == ColumnChunk::Mode::Dense) {
+            size_t length = end - begin;
+            const uint8_t* types = chunk->types() + begin;
+            if (result.error == ErrorCode::None && countTags(types, length, kErrorTag, kErrorTag) > 0) {
+                // Error slots keep their code in the numbers array
+                const uint8_t* errorTag = std::find(types, types + length, kErrorTag);
+                result.error = static_cast<ErrorCode>(static_cast<uint8_t>(chunk->numbers()[begin + (errorTag - types)]));
+            }
+            AggregateResult part;
+            part.count = countTags(types, length, kNumberTag, kDateTag);
+            if (part.count == 0) {
+                continue;
+            }
+            const double* numbers = chunk->numbers() + begin;
+            if (countTags(types, length, kDateTag, kDateTag) > 0) {
+                // Dates hold seconds but count as serial days, so such chunks go slot by slot
+                part.count = 0;
+                for (size_t i = 0; i < length; ++i) {
+                    if (types[i] == kNumberTag) {
+                        part.add(numbers[i], mode);
+                    } else if (types[i] == kDateTag) {
+                        part.add(dateSecondsToSerial(numbers[i]), mode);
+                    }
+                }
+                result.merge(part, mode);
+                continue;
+            }
+            // Non-numeric slots hold 0.0, so the sum needs no mask
+            part.sum = sum(numbers, length, mode);
+            if (part.count == length) {
+                part.min = min(numbers, length);
+                part.max = max(numbers, length);
+            } else {
+                for (size_t i = 0; i < length; ++i) {
+                    if (isNumericTag(types[i])) {
+                        part.min = numbers[i] < part.min ? numbers[i] : part.min;
+                        part.max = numbers[i] > part.max ? numbers[i] : part.max;
+                    }
+                }
+            }
+            result.merge(part, mode);
+            continue;
+        }
+
+        const auto& entries = chunk->sparseEntries();
+        auto it = std::lower_bound(entries.begin(), entries.end(), begin,
+                                   [](const ColumnChunk::SparseEntry& entry, uint32_t row) { return entry.row < row; });
+        for (; it != entries.end() && it->row < end; ++it) {
+            if (isNumericTag(it->type)) {
+                result.add(it->type == kDateTag ? dateSecondsToSerial(it->number) : it->number, mode);
+            } else if (it->type == kErrorTag && result.error == ErrorCode::None) {
+                result.error = static_cast<ErrorCode>(static_cast<uint8_t>(it->number));
+            }
+        }
+    }
+    return result;
+}
+
+AggregateResult aggregateValues(const CellValue* values, size_t count, SummationMode mode) {
+    // Gather the numbers into one contiguous span so the kernels can run over
+    // it; the span is scratch from the calling thread's arena
+    AggregateResult result;
+    EvaluationArena& arena = EvaluationArena::forThread();
+    EvaluationArena::Scope scope(arena);
+    ScratchVector<double> numbers(&arena);
+    numbers.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const CellValue& value = values[i];
+        if (value.getType() == CellType::Number) {
+            numbers.push_back(value.getNumber());
+        } else if (value.getType() == CellType::Date) {
+            numbers.push_back(dateSecondsToSerial(value.getDateSeconds()));
+        } else if (value.isError() && result.error == ErrorCode::None) {
+            result.error = value.getErrorCode();
+        }
+    }
+
+    result.count = numbers.size();
+    if (!numbers.empty()) {
+        result.sum = sum(numbers.data(), numbers.size(), mode);
+        result.min = min(numbers.data(), numbers.size());
+        result.max = max(numbers.data(), numbers.size());
+    }
+    return result;
+}
+
+InstructionSet getInstructionSet() {
+    return activeInstructionSet().load(std::memory_order_relaxed);
+}
+
+void setInstructionSet(InstructionSet instructionSet) {
+    InstructionSet supported = supportedInstructionSet();
+    activeInstructionSet().store(instructionSet > supported ? supported : instructionSet, std::memory_order_relaxed);
+}
+
+const char* getInstructionSetName(InstructionSet instructionSet) {
+    switch (instructionSet) {
+        case InstructionSet::AVX2:
+            return "AVX2";
+        case InstructionSet::SSE2:
+            return "SSE2";
+        default:
+            return "Scalar";
+    }
+}
+
+} // namespace Aggregates
+
+} // namespace ExcelCore
+
+// TODO: Add AVX-512 kernels once the target hardware supports them
+// TODO: Split very large ranges across the recalculation thread pool
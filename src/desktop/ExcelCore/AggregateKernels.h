@@ -0,0 +1,82 @@
+#pragma once
+
+#include "DataStructures.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace ExcelCore {
+
+// How sums are accumulated. Compensated (Kahan) summation keeps the rounding
+// error independent of the number of terms at roughly twice the cost.
+enum class SummationMode : uint8_t {
+    Fast,
+    Compensated
+};
+
+// Vector instruction sets the kernels can be dispatched to
+enum class InstructionSet : uint8_t {
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+// Running aggregate over numeric cells. Partial results (per chunk, per
+// argument) are combined with add(), which keeps compensated sums compensated.
+struct AggregateResult {
+    double sum = 0.0;
+    double compensation = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    size_t count = 0;
+    // First error value met; Excel aggregates return it instead of a number
+    ErrorCode error = ErrorCode::None;
+
+    void add(double value, SummationMode mode);
+    void merge(const AggregateResult& other, SummationMode mode);
+
+    double total() const {
+        return sum + compensation;
+    }
+
+    double average() const {
+        return count > 0 ? total() / static_cast<double>(count) : 0.0;
+    }
+};
+
+// Aggregate kernels over contiguous spans of doubles. The vector variant is
+// picked once from the CPU's capabilities; every kernel has a scalar fallback.
+namespace Aggregates {
+
+double sum(const double* values, size_t count, SummationMode mode = SummationMode::Fast);
+double min(const double* values, size_t count);
+double max(const double* values, size_t count);
+
+// Number of tags equal to either value (e.g. CellType::Number or CellType::Date)
+size_t countTags(const uint8_t* tags, size_t count, uint8_t first, uint8_t second);
+
+// Aggregates the numeric cells in rows [firstRow, lastRow] of one column,
+// dates as their serial day numbers. Only chunks that exist are visited, so whole-column ranges over sparse
+// columns cost as much as the data they hold.
+AggregateResult aggregateColumn(const ColumnStore& store, uint32_t column, uint32_t firstRow, uint32_t lastRow,
+                                SummationMode mode = SummationMode::Fast);
+
+// Aggregates the numeric values (numbers, and dates as serial days) among function arguments
+AggregateResult aggregateValues(const CellValue* values, size_t count, SummationMode mode = SummationMode::Fast);
+
+inline AggregateResult aggregateValues(const std::vector<CellValue>& values, SummationMode mode = SummationMode::Fast) {
+    return aggregateValues(values.data(), values.size(), mode);
+}
+
+InstructionSet getInstructionSet();
+
+// Restricts dispatch to the given instruction set (clamped to what the CPU
+// supports); used for benchmarking and to compare kernels against each other
+void setInstructionSet(InstructionSet instructionSet);
+
+const char* getInstructionSetName(InstructionSet instructionSet);
+
+} // namespace Aggregates
+
+} // namespace ExcelCore
@@ -1,12 +1,46 @@
 #include "CalculationEngine.h"
 #include "DataStructures.h"
 #include "FormulaParser.h"
+#include "CompiledFormula.h"
+#include "WorkbookSnapshot.h"
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <limits>
+
+using ExcelCore::Worksheet;
+
+namespace {
+// Below this many dirty cells the cost of waking the pool outweighs the work
+const size_t kParallelRecalcThreshold = 256;
+
+// Whether an iterated result has settled: numbers within the tolerance
+// (relative once their magnitude exceeds 1), other values unchanged
+bool hasConverged(const CellValue& previous, const CellValue& current, double tolerance) {
+    if (previous.getType() != current.getType()) {
+        return false;
+    }
+    switch (current.getType()) {
+        case CellValue::Type::Number:
+        case CellValue::Type::Boolean:
+            return std::fabs(current.getNumber() - previous.getNumber()) <=
+                   tolerance * std::max(1.0, std::fabs(current.getNumber()));
+        case CellValue::Type::Date:
+            return std::fabs(current.getDateSeconds() - previous.getDateSeconds()) <=
+                   tolerance * std::max(1.0, std::fabs(current.getDateSeconds()));
+        case CellValue::Type::String:
+            return current.getString() == previous.getString();
+        case CellValue::Type::Error:
+            return current.getErrorCode() == previous.getErrorCode();
+        default:
+            return true;
+    }
+}
+}
 
 // Constructor for the CalculationEngine class
 CalculationEngine::CalculationEngine() {
@@ -15,19 +49,11 @@ CalculationEngine::CalculationEngine() {
     initializeOptimizationStructures();
 }
 
-// Initialize the builtInFunctions map with standard Excel functions
-void CalculationEngine::initializeBuiltInFunctions() {
-    builtInFunctions["SUM"] = [](const std::vector<CellValue>& args) {
-        double sum = 0;
-        for (const auto& arg : args) {
-            if (arg.type == CellValueType::Number) {
-                sum += arg.numberValue;
-            }
-        }
-        return CellValue(sum);
-    };
+CalculationEngine::~CalculationEngine() = default;
 
-    // Add more built-in functions here...
+// Create the function registry with the standard Excel functions
+void CalculationEngine::initializeBuiltInFunctions() {
+    functionRegistry = FormulaParser::createFunctionRegistry();
 }
 
 // Set up error handling for division by zero and other common errors
@@ -42,98 +68,645 @@ void CalculationEngine::initializeOptimizationStructures() {
 
 // Sets the current workbook for calculations
 void CalculationEngine::setWorkbook(std::shared_ptr<Workbook> workbook) {
-    currentWorkbook = workbook;
+    std::unique_ptr<FormulaParser> workbookParser = workbook ? std::make_unique<FormulaParser>(workbook, functionRegistry) : nullptr;
+    attachWorkbook(std::move(workbook), std::move(workbookParser));
+}
+
+void CalculationEngine::attachWorkbook(std::shared_ptr<Workbook> workbook, std::unique_ptr<FormulaParser> workbookParser) {
+    currentWorkbook = std::move(workbook);
+    parser = std::move(workbookParser);
+    if (parser) {
+        // Cells are evaluated in dependency order, so precedents are read, not re-evaluated
+        parser->setRecursiveEvaluation(false);
+    }
+    pendingChanges.clear();
     clearCalculationCache();
+    // Built on first use, so a workbook opened only to be read never pays for it
+    dependencyGraph.clear();
+    volatileCells.clear();
+    dependencyGraphBuilt = false;
+}
+
+// Building the graph compiles every formula, so the snapshot holds programs rather than text
+void CalculationEngine::saveSnapshot(const std::string& path) {
+    if (!currentWorkbook) {
+        throw std::runtime_error("No workbook set for calculation");
+    }
+    ensureDependencyGraph();
+    ExcelCore::SnapshotWriter writer(path);
+    writer.write(*currentWorkbook, functionRegistry->getNames(), pendingChanges);
+}
+
+// The snapshot's programs are bound to a parser created for the new workbook
+// before it is attached, so no formula is recompiled and the dependency graph
+// is built from the stored programs when first needed
+std::shared_ptr<Workbook> CalculationEngine::openSnapshot(const std::string& path) {
+    auto workbook = std::make_shared<Workbook>();
+    auto workbookParser = std::make_unique<FormulaParser>(workbook, functionRegistry);
+    ExcelCore::SnapshotReader reader(path);
+    reader.read(*workbook, [&](const std::string& name) { return functionRegistry->getId(name); });
+    for (const auto& program : reader.getPrograms()) {
+        workbookParser->adoptFormula(program);
+    }
+
+    attachWorkbook(workbook, std::move(workbookParser));
+    pendingChanges = reader.getDirtyCells();
+    return workbook;
 }
 
 // Clear any cached calculation results from the previous workbook
 void CalculationEngine::clearCalculationCache() {
-    // Implementation for clearing calculation cache
+    if (parser) {
+        parser->invalidateResults();
+    }
 }
 
 // Evaluates a formula and returns the result
-CellValue CalculationEngine::evaluateFormula(const std::string& formula, const CellAddress& cellAddress) {
+CellValue CalculationEngine::evaluateFormula(const std::string& formula, const CellAddress& cellAddress, size_t sheetIndex) {
     try {
-        auto tokens = FormulaParser::tokenizeFormula(formula);
-        auto expressionTree = buildExpressionTree(tokens);
-        return evaluateExpressionTree(expressionTree, cellAddress);
+        if (!parser) {
+            throw std::runtime_error("No workbook set for calculation");
+        }
+        return parser->parseFormula(formula, cellAddress, sheetIndex);
     } catch (const std::exception& e) {
         // Handle and log the error
-        return CellValue(CellValueType::Error, e.what());
+        return CellValue(CellValue::Type::Error, e.what());
     }
 }
 
-// Build an expression tree from the tokens
-std::unique_ptr<ExpressionNode> CalculationEngine::buildExpressionTree(const std::vector<Token>& tokens) {
-    // Implementation for building expression tree
-    return nullptr; // Placeholder
+// Updates a cell's value based on its formula
+void CalculationEngine::updateCell(const CellAddress& address, size_t sheetIndex) {
+    if (!currentWorkbook) {
+        return;
+    }
+    FormulaCell* cell = currentWorkbook->getWorksheet(sheetIndex).findFormulaCell(address);
+    if (cell != nullptr && cell->hasFormula()) {
+        calculateCell(*cell, address, sheetIndex);
+        updateDependentCells(address, sheetIndex);
+    }
 }
 
-// Traverse the expression tree, evaluating each node
-CellValue CalculationEngine::evaluateExpressionTree(const std::unique_ptr<ExpressionNode>& root, const CellAddress& cellAddress) {
-    // Implementation for evaluating expression tree
-    return CellValue(); // Placeholder
+// Update any dependent cells (cells that reference this cell in their formulas).
+// Dependents are only marked; they are evaluated by the next recalculate()
+void CalculationEngine::updateDependentCells(const CellAddress& address, size_t sheetIndex) {
+    ensureDependencyGraph();
+    SheetCellAddress key(static_cast<uint32_t>(sheetIndex), address);
+    dependencyGraph.forEachDependent(key, [&](const SheetCellAddress& dependent) {
+        pendingChanges.push_back(dependent);
+    });
 }
 
-// Updates a cell's value based on its formula
-void CalculationEngine::updateCell(Cell& cell) {
-    if (cell.hasFormula()) {
-        CellValue result = evaluateFormula(cell.getFormula(), cell.getAddress());
-        cell.setValue(result);
-        updateDependentCells(cell);
+// Sets a cell's formula and replaces its edges in the dependency graph
+void CalculationEngine::setCellFormula(size_t sheetIndex, const CellAddress& address, const std::string& formula) {
+    if (!currentWorkbook) {
+        throw std::runtime_error("No workbook set for calculation");
+    }
+    Worksheet& worksheet = currentWorkbook->getWorksheet(sheetIndex);
+    worksheet.setCellFormula(address, formula);
+
+    // An unbuilt graph picks the formula up when it is built
+    SheetCellAddress key(static_cast<uint32_t>(sheetIndex), address);
+    FormulaCell* cell = worksheet.findFormulaCell(address);
+    if (cell != nullptr) {
+        if (dependencyGraphBuilt) {
+            updateCellPrecedents(key, *cell);
+        }
+    } else {
+        dependencyGraph.removeCell(key);
+        volatileCells.erase(key);
+    }
+    pendingChanges.push_back(key);
+}
+
+// Sets a constant value; a constant has no precedents, so any previous edges are dropped
+void CalculationEngine::setCellValue(size_t sheetIndex, const CellAddress& address, const CellValue& value) {
+    if (!currentWorkbook) {
+        throw std::runtime_error("No workbook set for calculation");
+    }
+    currentWorkbook->getWorksheet(sheetIndex).setCellValue(address, value);
+
+    SheetCellAddress key(static_cast<uint32_t>(sheetIndex), address);
+    dependencyGraph.removeCell(key);
+    volatileCells.erase(key);
+    pendingChanges.push_back(key);
+}
+
+// Same bookkeeping as setCellValue, but the graph is only touched for cells
+// that held a formula before
+void CalculationEngine::setRangeValues(size_t sheetIndex, const CellAddress& first, uint32_t columnCount,
+                                       const CellValue* values, size_t count) {
+    if (!currentWorkbook) {
+        throw std::runtime_error("No workbook set for calculation");
+    }
+    if (columnCount == 0) {
+        return;
+    }
+    Worksheet& worksheet = currentWorkbook->getWorksheet(sheetIndex);
+    pendingChanges.reserve(pendingChanges.size() + count);
+    for (size_t i = 0; i < count; ++i) {
+        CellAddress address(first.row + static_cast<uint32_t>(i / columnCount),
+                            first.column + static_cast<uint32_t>(i % columnCount));
+        SheetCellAddress key(static_cast<uint32_t>(sheetIndex), address);
+        if (worksheet.findFormulaCell(address) != nullptr) {
+            dependencyGraph.removeCell(key);
+            volatileCells.erase(key);
+        }
+        worksheet.setCellValue(address, values[i]);
+        pendingChanges.push_back(key);
+    }
+}
+
+// Compiles (interns) a formula cell and re-derives its precedents from the
+// relative references of its shared program
+void CalculationEngine::updateCellPrecedents(const SheetCellAddress& key, FormulaCell& cell) {
+    if (!cell.hasFormula()) {
+        dependencyGraph.removeCell(key);
+        volatileCells.erase(key);
+        return;
     }
+
+    const CompiledFormula& program = parser->getCompiledFormula(cell, key.address);
+    if (parser->isVolatile(program)) {
+        volatileCells.insert(key);
+    } else {
+        volatileCells.erase(key);
+    }
+    std::vector<SheetCellAddress> precedents;
+    precedents.reserve(program.references.size());
+    for (const auto& reference : program.references) {
+        CellAddress resolved;
+        if (reference.resolve(key.address, resolved)) {
+            precedents.emplace_back(key.sheetIndex, resolved);
+        }
+    }
+
+    // Ranges become single range edges, however many cells they span
+    std::vector<SheetRange> rangePrecedents;
+    rangePrecedents.reserve(program.ranges.size());
+    for (const auto& range : program.ranges) {
+        CellAddress first;
+        CellAddress last;
+        if (range.resolve(key.address, first, last)) {
+            rangePrecedents.emplace_back(key.sheetIndex, first, last);
+        }
+    }
+    dependencyGraph.setPrecedents(key, precedents, rangePrecedents);
+}
+
+// Runs the cell's compiled program and stores the result in the column store
+void CalculationEngine::calculateCell(FormulaCell& cell, const CellAddress& address, size_t sheetIndex) {
+    Worksheet& worksheet = currentWorkbook->getWorksheet(sheetIndex);
+    try {
+        worksheet.setFormulaResult(address, parser->execute(parser->getCompiledFormula(cell, address), address, sheetIndex));
+    } catch (const std::exception& e) {
+        worksheet.setFormulaResult(address, CellValue(CellValue::Type::Error, e.what()));
+    }
+}
+
+bool CalculationEngine::hasDirtyCells() const {
+    return !pendingChanges.empty();
+}
+
+// Recalculates the cells changed since the last pass and their transitive dependents
+void CalculationEngine::recalculate() {
+    prepareRecalculation();
+    runPreparedRecalculation();
+}
+
+void CalculationEngine::prepareRecalculation() {
+    preparedCells.clear();
+    preparedComponents.clear();
+    if (!currentWorkbook) {
+        return;
+    }
+
+    // No evaluation runs between passes, so result strings of the last pass
+    // that no cell kept can be freed now, as can programs of replaced formulas
+    currentWorkbook->stringPool->reclaim();
+    parser->purgeUnusedFormulas();
+
+    ensureDependencyGraph();
+    updateVolatileFunctions();
+    if (pendingChanges.empty()) {
+        return;
+    }
+    auto dirtyCells = dependencyGraph.collectDirty(pendingChanges);
+    pendingChanges.clear();
+    std::vector<SheetCellAddress> cyclicCells;
+    preparedCells = topologicalSort(dirtyCells, cyclicCells);
+    if (!cyclicCells.empty()) {
+        preparedComponents = dependencyGraph.stronglyConnectedComponents(cyclicCells);
+    }
+
+    // Compile every program and reserve every result slot now; evaluation
+    // (possibly on many workers) then never changes the workbook's structure
+    auto prepareCell = [&](const SheetCellAddress& key) {
+        Worksheet& worksheet = currentWorkbook->getWorksheet(key.sheetIndex);
+        FormulaCell* cell = worksheet.findFormulaCell(key.address);
+        if (cell != nullptr && cell->hasFormula()) {
+            parser->getCompiledFormula(*cell, key.address);
+            worksheet.values.reserve(key.address);
+        }
+    };
+    for (const auto& key : preparedCells) {
+        prepareCell(key);
+    }
+    for (const auto& component : preparedComponents) {
+        for (const auto& key : component.cells) {
+            prepareCell(key);
+        }
+    }
+}
+
+void CalculationEngine::runPreparedRecalculation(RecalculationProgress* progress) {
+    if (!currentWorkbook || (preparedCells.empty() && preparedComponents.empty())) {
+        return;
+    }
+    if (progress) {
+        size_t total = preparedCells.size();
+        for (const auto& component : preparedComponents) {
+            total += component.cells.size();
+        }
+        progress->total.store(total, std::memory_order_relaxed);
+    }
+
+    if (calculationThreads != 1 && preparedCells.size() >= kParallelRecalcThreshold) {
+        evaluateCellsParallel(preparedCells, progress);
+    } else {
+        evaluateCells(preparedCells, progress);
+    }
+    // Cycles read the acyclic cells evaluated above, never the other way round
+    if (!progress || !progress->isCancelled()) {
+        handleCircularReferences(preparedComponents, progress);
+    }
+
+    // A cancelled pass leaves its cells dirty; re-evaluating the ones that did
+    // finish is harmless, and cheaper than tracking them
+    if (progress && progress->isCancelled()) {
+        pendingChanges.insert(pendingChanges.end(), preparedCells.begin(), preparedCells.end());
+        for (const auto& component : preparedComponents) {
+            pendingChanges.insert(pendingChanges.end(), component.cells.begin(), component.cells.end());
+        }
+        preparedCells.clear();
+        preparedComponents.clear();
+        return;
+    }
+
+    notifyRangeSubscribers();
+    preparedCells.clear();
+    preparedComponents.clear();
+}
+
+uint64_t CalculationEngine::subscribeRange(const SheetRange& range, RangeChangeListener listener) {
+    uint64_t subscription = nextSubscription++;
+    rangeSubscriptions.emplace(subscription, RangeSubscription{range, std::move(listener)});
+    return subscription;
 }
 
-// Update any dependent cells (cells that reference this cell in their formulas)
-void CalculationEngine::updateDependentCells(const Cell& cell) {
-    // Implementation for updating dependent cells
+void CalculationEngine::unsubscribeRange(uint64_t subscription) {
+    rangeSubscriptions.erase(subscription);
+}
+
+// Reports the cells of the finished pass (edited cells are part of the dirty
+// set) to each subscriber whose range they fall in, merged into runs of
+// consecutive rows per column
+void CalculationEngine::notifyRangeSubscribers() {
+    if (rangeSubscriptions.empty()) {
+        return;
+    }
+    std::vector<SheetCellAddress> changedCells = preparedCells;
+    for (const auto& component : preparedComponents) {
+        changedCells.insert(changedCells.end(), component.cells.begin(), component.cells.end());
+    }
+    std::sort(changedCells.begin(), changedCells.end(), [](const SheetCellAddress& a, const SheetCellAddress& b) {
+        if (a.sheetIndex != b.sheetIndex) {
+            return a.sheetIndex < b.sheetIndex;
+        }
+        return a.address.column != b.address.column ? a.address.column < b.address.column : a.address.row < b.address.row;
+    });
+
+    // Copied, so listeners may unsubscribe while being notified
+    std::vector<RangeSubscription> subscriptions;
+    subscriptions.reserve(rangeSubscriptions.size());
+    for (const auto& entry : rangeSubscriptions) {
+        subscriptions.push_back(entry.second);
+    }
+    for (const auto& subscription : subscriptions) {
+        std::vector<SheetRange> changed;
+        for (const auto& cell : changedCells) {
+            if (!subscription.range.contains(cell)) {
+                continue;
+            }
+            SheetRange* run = changed.empty() ? nullptr : &changed.back();
+            if (run != nullptr && run->first.column == cell.address.column && run->last.row + 1 >= cell.address.row) {
+                run->last.row = std::max(run->last.row, cell.address.row);
+            } else {
+                changed.emplace_back(cell.sheetIndex, cell.address, cell.address);
+            }
+        }
+        if (!changed.empty()) {
+            subscription.listener(changed);
+        }
+    }
+}
+
+// Evaluates cells one after another in topological order
+void CalculationEngine::evaluateCells(const std::vector<SheetCellAddress>& sortedCells, RecalculationProgress* progress) {
+    for (const auto& key : sortedCells) {
+        if (progress && progress->isCancelled()) {
+            return;
+        }
+        FormulaCell* cell = currentWorkbook->getWorksheet(key.sheetIndex).findFormulaCell(key.address);
+        if (cell != nullptr && cell->hasFormula()) {
+            calculateCell(*cell, key.address, key.sheetIndex);
+        }
+        if (progress) {
+            progress->completed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Evaluates cells on the work-stealing pool as a dataflow graph: every cell
+// counts its dirty precedents, and the worker that finishes the last one runs
+// the cell next. Independent subgraphs therefore proceed without level barriers.
+void CalculationEngine::evaluateCellsParallel(const std::vector<SheetCellAddress>& sortedCells, RecalculationProgress* progress) {
+    if (!threadPool) {
+        threadPool = std::make_unique<ThreadPool>(
+            calculationThreads == 0 ? ThreadPool::defaultThreadCount() : calculationThreads);
+    }
+
+    const size_t count = sortedCells.size();
+    std::unordered_map<SheetCellAddress, size_t> indexOf;
+    indexOf.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        indexOf.emplace(sortedCells[i], i);
+    }
+
+    // Resolve cells and dependency counts up front. Programs are compiled and
+    // result slots reserved by prepareRecalculation(), so workers only read the
+    // cached programs and never allocate chunks.
+    std::vector<FormulaCell*> cells(count, nullptr);
+    std::vector<std::atomic<size_t>> remainingPrecedents(count);
+    for (size_t i = 0; i < count; ++i) {
+        const SheetCellAddress& key = sortedCells[i];
+        cells[i] = currentWorkbook->getWorksheet(key.sheetIndex).findFormulaCell(key.address);
+        remainingPrecedents[i].store(0, std::memory_order_relaxed);
+    }
+
+    // Count dirty precedents from the precedent side, which also covers range edges
+    for (size_t i = 0; i < count; ++i) {
+        dependencyGraph.forEachDependent(sortedCells[i], [&](const SheetCellAddress& dependent) {
+            auto it = indexOf.find(dependent);
+            if (it != indexOf.end()) {
+                remainingPrecedents[it->second].fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::function<void(size_t)> evaluate = [&](size_t index) {
+        while (index != none) {
+            // A cancelled pass stops scheduling: dependents of this cell never
+            // become ready, so the pool drains without evaluating them
+            if (progress && progress->isCancelled()) {
+                return;
+            }
+            const SheetCellAddress& key = sortedCells[index];
+            FormulaCell* cell = cells[index];
+            if (cell != nullptr && cell->hasFormula()) {
+                calculateCell(*cell, key.address, key.sheetIndex);
+            }
+            if (progress) {
+                progress->completed.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // Continue inline with the first dependent that became ready and
+            // hand any others to the pool where idle workers can steal them
+            size_t next = none;
+            dependencyGraph.forEachDependent(key, [&](const SheetCellAddress& dependent) {
+                auto it = indexOf.find(dependent);
+                if (it == indexOf.end()) {
+                    return;
+                }
+                if (remainingPrecedents[it->second].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if (next == none) {
+                        next = it->second;
+                    } else {
+                        size_t ready = it->second;
+                        threadPool->submit([&evaluate, ready] { evaluate(ready); });
+                    }
+                }
+            });
+            index = next;
+        }
+    };
+
+    // Collect the roots before submitting anything: once workers run, other
+    // counters reach zero too and those cells are already scheduled by them
+    std::vector<size_t> roots;
+    for (size_t i = 0; i < count; ++i) {
+        if (remainingPrecedents[i].load(std::memory_order_relaxed) == 0) {
+            roots.push_back(i);
+        }
+    }
+    for (size_t root : roots) {
+        threadPool->submit([&evaluate, root] { evaluate(root); });
+    }
+    threadPool->waitIdle();
+}
+
+void CalculationEngine::setCalculationThreads(size_t threadCount) {
+    if (threadCount != calculationThreads) {
+        calculationThreads = threadCount;
+        threadPool.reset();
+    }
+}
+
+size_t CalculationEngine::getCalculationThreads() const {
+    return calculationThreads;
+}
+
+// Takes effect for cells evaluated from now on; results are not recomputed
+void CalculationEngine::setSummationMode(SummationMode mode) {
+    functionRegistry->setSummationMode(mode);
+}
+
+SummationMode CalculationEngine::getSummationMode() const {
+    return functionRegistry->getSummationMode();
+}
+
+void CalculationEngine::setIterationLimits(size_t maxIterations, double tolerance) {
+    if (maxIterations == 0 || !(tolerance >= 0.0)) {
+        throw std::invalid_argument("Invalid iteration limits");
+    }
+    this->maxIterations = maxIterations;
+    iterationTolerance = tolerance;
+}
+
+size_t CalculationEngine::getMaxIterations() const {
+    return maxIterations;
+}
+
+double CalculationEngine::getIterationTolerance() const {
+    return iterationTolerance;
 }
 
 // Recalculates all cells in the current workbook
 void CalculationEngine::recalculateWorkbook() {
-    auto dependencyGraph = buildDependencyGraph();
-    auto sortedCells = topologicalSort(dependencyGraph);
+    if (!currentWorkbook) {
+        return;
+    }
+
+    // A full recalculation trusts no previously computed result
+    clearCalculationCache();
+    buildDependencyGraph();
 
-    for (const auto& cell : sortedCells) {
-        updateCell(*cell);
+    pendingChanges.clear();
+    for (size_t sheetIndex = 0; sheetIndex < currentWorkbook->getWorksheetCount(); ++sheetIndex) {
+        for (const auto& entry : currentWorkbook->getWorksheet(sheetIndex).formulas) {
+            if (entry.second.hasFormula()) {
+                pendingChanges.emplace_back(static_cast<uint32_t>(sheetIndex), entry.first);
+            }
+        }
     }
 
-    handleCircularReferences();
-    updateVolatileFunctions();
+    recalculate();
 }
 
-// Build a dependency graph of all cells in the workbook
-std::unordered_map<Cell*, std::vector<Cell*>> CalculationEngine::buildDependencyGraph() {
-    // Implementation for building dependency graph
-    return {}; // Placeholder
+// Build the dependency graph of all formula cells in the workbook from scratch
+void CalculationEngine::buildDependencyGraph() {
+    dependencyGraph.clear();
+    volatileCells.clear();
+    dependencyGraphBuilt = true;
+    if (!currentWorkbook) {
+        return;
+    }
+
+    size_t formulaCount = 0;
+    for (size_t sheetIndex = 0; sheetIndex < currentWorkbook->getWorksheetCount(); ++sheetIndex) {
+        formulaCount += currentWorkbook->getWorksheet(sheetIndex).formulas.size();
+    }
+    dependencyGraph.reserve(formulaCount);
+
+    for (size_t sheetIndex = 0; sheetIndex < currentWorkbook->getWorksheetCount(); ++sheetIndex) {
+        for (auto& entry : currentWorkbook->getWorksheet(sheetIndex).formulas) {
+            if (entry.second.hasFormula()) {
+                updateCellPrecedents(SheetCellAddress(static_cast<uint32_t>(sheetIndex), entry.first), entry.second);
+            }
+        }
+    }
 }
 
-// Perform a topological sort on the dependency graph
-std::vector<Cell*> CalculationEngine::topologicalSort(const std::unordered_map<Cell*, std::vector<Cell*>>& graph) {
-    // Implementation for topological sort
-    return {}; // Placeholder
+void CalculationEngine::ensureDependencyGraph() {
+    if (!dependencyGraphBuilt) {
+        buildDependencyGraph();
+    }
 }
 
-// Handle circular references by using iterative calculation with a maximum number of iterations
-void CalculationEngine::handleCircularReferences() {
-    // Implementation for handling circular references
+// Perform a topological sort of the dirty cells; cells on cycles are reported separately
+std::vector<SheetCellAddress> CalculationEngine::topologicalSort(const std::unordered_set<SheetCellAddress>& dirtyCells,
+                                                                 std::vector<SheetCellAddress>& cyclicCells) {
+    return dependencyGraph.topologicalOrder(dirtyCells, cyclicCells);
 }
 
-// Update volatile functions (e.g., NOW(), RAND()) even if they don't have dependencies
+// Solves each cyclic component by iteration (Gauss-Seidel): its cells are
+// recalculated in turn, starting from their previous results, until a pass
+// changes no result beyond the tolerance or maxIterations passes have run.
+// An unconverged cycle keeps the results of its last pass, as in Excel.
+// Acyclic components downstream of a cycle are evaluated once, in order.
+void CalculationEngine::handleCircularReferences(const std::vector<DependencyGraph::Component>& components,
+                                                 RecalculationProgress* progress) {
+    std::vector<FormulaCell*> cells;
+    for (const auto& component : components) {
+        if (progress && progress->isCancelled()) {
+            return;
+        }
+        cells.clear();
+        for (const auto& key : component.cells) {
+            FormulaCell* cell = currentWorkbook->getWorksheet(key.sheetIndex).findFormulaCell(key.address);
+            cells.push_back(cell != nullptr && cell->hasFormula() ? cell : nullptr);
+        }
+
+        size_t passes = component.cyclic ? maxIterations : 1;
+        for (size_t pass = 0; pass < passes; ++pass) {
+            bool converged = true;
+            for (size_t i = 0; i < cells.size(); ++i) {
+                if (cells[i] == nullptr) {
+                    continue;
+                }
+                const SheetCellAddress& key = component.cells[i];
+                Worksheet& worksheet = currentWorkbook->getWorksheet(key.sheetIndex);
+                CellValue previous = worksheet.getCellValue(key.address);
+                calculateCell(*cells[i], key.address, key.sheetIndex);
+                if (converged && !hasConverged(previous, worksheet.getCellValue(key.address), iterationTolerance)) {
+                    converged = false;
+                }
+            }
+            if (converged || (progress && progress->isCancelled())) {
+                break;
+            }
+        }
+        if (progress) {
+            progress->completed.fetch_add(component.cells.size(), std::memory_order_relaxed);
+        }
+    }
+}
+
+// Volatile cells (calling NOW(), RAND(), ...) count as changed on every
+// recalculation. Only they are queued; collectDirty adds their dependents,
+// so the rest of the workbook is left alone.
 void CalculationEngine::updateVolatileFunctions() {
-    // Implementation for updating volatile functions
+    pendingChanges.insert(pendingChanges.end(), volatileCells.begin(), volatileCells.end());
 }
 
 // Adds a custom function to the calculation engine
-void CalculationEngine::addCustomFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function) {
-    std::string lowerCaseName = functionName;
-    std::transform(lowerCaseName.begin(), lowerCaseName.end(), lowerCaseName.begin(), ::tolower);
+void CalculationEngine::addCustomFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function,
+                                          const FunctionTraits& traits) {
+    registerFunction(functionName, [function](ArgumentList<CellValue> args) {
+        return function(std::vector<CellValue>(args.begin(), args.end()));
+    }, traits);
+}
 
-    if (builtInFunctions.find(lowerCaseName) != builtInFunctions.end()) {
+void CalculationEngine::registerFunction(const std::string& functionName, std::function<CellValue(ArgumentList<CellValue>)> function,
+                                         const FunctionTraits& traits) {
+    uint32_t id = functionRegistry->find(functionName);
+    if (id != FunctionRegistry::kUnknown && (*functionRegistry)[id].builtIn) {
         throw std::runtime_error("Cannot override built-in function: " + functionName);
     }
+    updateFunctionCallers(functionRegistry->define(functionName, std::move(function), traits));
+}
 
-    builtInFunctions[lowerCaseName] = function;
+// Compiled programs call functions by ID, so a new or changed definition
+// reaches them without recompiling; the cells calling it are queued, and
+// their volatility re-derived from the new traits
+void CalculationEngine::updateFunctionCallers(uint32_t functionId) {
+    if (!currentWorkbook) {
+        return;
+    }
+    for (size_t sheetIndex = 0; sheetIndex < currentWorkbook->getWorksheetCount(); ++sheetIndex) {
+        for (const auto& entry : currentWorkbook->getWorksheet(sheetIndex).formulas) {
+            const FormulaCell& cell = entry.second;
+            if (!cell.hasFormula() || !cell.compiledFormula) {
+                continue;
+            }
+            const auto& code = cell.compiledFormula->code;
+            bool callsFunction = std::any_of(code.begin(), code.end(), [functionId](const ExcelCore::Instruction& instruction) {
+                return instruction.opcode == ExcelCore::OpCode::CallFunction && instruction.operand == functionId;
+            });
+            if (!callsFunction) {
+                continue;
+            }
+            SheetCellAddress key(static_cast<uint32_t>(sheetIndex), entry.first);
+            if (dependencyGraphBuilt) {
+                if (parser->isVolatile(*cell.compiledFormula)) {
+                    volatileCells.insert(key);
+                } else {
+                    volatileCells.erase(key);
+                }
+            }
+            pendingChanges.push_back(key);
+        }
+    }
 }
 
 // Commented list of human tasks
@@ -2,40 +2,195 @@
 
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <atomic>
 #include <functional>
 #include <vector>
 #include <string>
+#include "DependencyGraph.h"
+#include "ThreadPool.h"
+#include "AggregateKernels.h"
+#include "FunctionRegistry.h"
 
 // Forward declarations
-class Workbook;
-class CellAddress;
-class CellValue;
+class FormulaParser;
+using ExcelCore::Workbook;
+using ExcelCore::FormulaCell;
+using ExcelCore::CellAddress;
+using ExcelCore::CellValue;
+using ExcelCore::SheetCellAddress;
+using ExcelCore::SheetRange;
+using ExcelCore::DependencyGraph;
+using ExcelCore::ThreadPool;
+using ExcelCore::SummationMode;
+using ExcelCore::FunctionTraits;
+using ExcelCore::FunctionRegistry;
+using ExcelCore::ArgumentList;
 
 // Global constant
 const double EPSILON = 1e-10;
 
+// Progress of a running recalculation, shared with the thread that started it.
+// Cancellation is cooperative: evaluation stops at the next cell boundary, and
+// cells left unevaluated stay dirty for the next recalculation.
+class RecalculationProgress {
+public:
+    void cancel() {
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool isCancelled() const {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+
+    size_t getCompleted() const {
+        return completed.load(std::memory_order_relaxed);
+    }
+
+    size_t getTotal() const {
+        return total.load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CalculationEngine;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> total{0};
+};
+
 class CalculationEngine {
 public:
     // Constructor
     CalculationEngine();
+    ~CalculationEngine();
 
     // Public methods
     void setWorkbook(std::shared_ptr<Workbook> workbook);
-    CellValue evaluateFormula(const std::string& formula, const CellAddress& cellAddress);
-    void updateCell(Cell& cell);
+
+    // Native snapshots (see WorkbookSnapshot.h). Saving records the compiled
+    // formulas and the cells still dirty; opening replaces the current workbook
+    // with the snapshot's and returns it, with those cells still dirty.
+    void saveSnapshot(const std::string& path);
+    std::shared_ptr<Workbook> openSnapshot(const std::string& path);
+    CellValue evaluateFormula(const std::string& formula, const CellAddress& cellAddress, size_t sheetIndex = 0);
+    void updateCell(const CellAddress& address, size_t sheetIndex = 0);
     void recalculateWorkbook();
-    void addCustomFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function);
+    // Makes a function available to formulas of every workbook; traits declare
+    // its arity and whether it is volatile or thread-safe. Names are
+    // case-insensitive, and built-in functions cannot be replaced. Formulas
+    // already calling the name (#NAME? until now) are recalculated by the
+    // next recalculate().
+    void addCustomFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function,
+                           const FunctionTraits& traits = FunctionTraits());
+
+    // Like addCustomFunction, but the function views its arguments in place
+    // instead of receiving a copy, so calls cost the same as built-ins
+    void registerFunction(const std::string& functionName, std::function<CellValue(ArgumentList<CellValue>)> function,
+                          const FunctionTraits& traits = FunctionTraits());
+
+    // Incremental editing: these keep the dependency graph current and mark
+    // the edited cell's transitive dependents dirty without recalculating
+    void setCellFormula(size_t sheetIndex, const CellAddress& address, const std::string& formula);
+    void setCellValue(size_t sheetIndex, const CellAddress& address, const CellValue& value);
+
+    // Bulk counterpart of setCellValue: writes a row-major block of values
+    // whose top-left cell is first, columnCount cells per row
+    void setRangeValues(size_t sheetIndex, const CellAddress& first, uint32_t columnCount,
+                        const CellValue* values, size_t count);
+
+    // Recalculates only the cells dirtied since the last recalculation, plus
+    // the cells calling volatile functions (NOW, RAND) and their dependents
+    void recalculate();
+    bool hasDirtyCells() const;
+
+    // recalculate() in two phases, for hosts that let readers run alongside a
+    // recalculation. prepareRecalculation() does every structural change (dirty
+    // set, ordering, compiling, reserving result slots) and needs exclusive
+    // access to the workbook. runPreparedRecalculation() only overwrites the
+    // reserved result slots in place, so concurrent readers are safe; edits
+    // must still wait until it returns.
+    void prepareRecalculation();
+    void runPreparedRecalculation(RecalculationProgress* progress = nullptr);
+
+    // Number of threads used for recalculation: 1 evaluates serially on the
+    // calling thread, 0 uses one thread per hardware core
+    void setCalculationThreads(size_t threadCount);
+    size_t getCalculationThreads() const;
+
+    // Iterative calculation of circular references: each cycle is recalculated
+    // until no result changes by more than tolerance (relative to the result
+    // once its magnitude exceeds 1), or for at most maxIterations passes
+    void setIterationLimits(size_t maxIterations, double tolerance = EPSILON);
+    size_t getMaxIterations() const;
+    double getIterationTolerance() const;
+
+    // Plain or Kahan-compensated summation for SUM and AVERAGE
+    void setSummationMode(SummationMode mode);
+    SummationMode getSummationMode() const;
+
+    std::shared_ptr<Workbook> getWorkbook() const {
+        return currentWorkbook;
+    }
+
+    // Change notifications. After each completed recalculation, a subscriber
+    // is told which parts of its range were written (edited cells and
+    // recalculated formulas) as column runs clipped to the range. Listeners
+    // run on the thread that ran the recalculation, after every result is
+    // stored, and must not edit the workbook. Subscriptions stay in place
+    // across setWorkbook(); subscribeRange returns the ID to unsubscribe with.
+    using RangeChangeListener = std::function<void(const std::vector<SheetRange>& changed)>;
+    uint64_t subscribeRange(const SheetRange& range, RangeChangeListener listener);
+    void unsubscribeRange(uint64_t subscription);
 
 private:
     // Private member variables
-    std::unordered_map<std::string, std::function<CellValue(const std::vector<CellValue>&)>> builtInFunctions;
+    // Built-in and custom functions, shared by the parsers of every workbook
+    std::shared_ptr<FunctionRegistry> functionRegistry;
     std::shared_ptr<Workbook> currentWorkbook;
+    std::unique_ptr<FormulaParser> parser;
+    DependencyGraph dependencyGraph;
+    bool dependencyGraphBuilt = false;
+    // Formula cells that call a volatile function; kept with the dependency graph
+    std::unordered_set<SheetCellAddress> volatileCells;
+    std::vector<SheetCellAddress> pendingChanges;
+    size_t calculationThreads = 1;
+    std::unique_ptr<ThreadPool> threadPool;
+    size_t maxIterations = 100;
+    double iterationTolerance = EPSILON;
+    // Output of prepareRecalculation(), consumed by runPreparedRecalculation():
+    // the acyclic cells in topological order, then the cycles and everything
+    // downstream of them as components in dependency order
+    std::vector<SheetCellAddress> preparedCells;
+    std::vector<DependencyGraph::Component> preparedComponents;
+    struct RangeSubscription {
+        SheetRange range;
+        RangeChangeListener listener;
+    };
+    std::unordered_map<uint64_t, RangeSubscription> rangeSubscriptions;
+    uint64_t nextSubscription = 1;
 
     // Private helper methods
+    void attachWorkbook(std::shared_ptr<Workbook> workbook, std::unique_ptr<FormulaParser> workbookParser);
     void initializeBuiltInFunctions();
+    void setupErrorHandling();
+    void initializeOptimizationStructures();
+    void clearCalculationCache();
+    void updateDependentCells(const CellAddress& address, size_t sheetIndex);
+    void updateCellPrecedents(const SheetCellAddress& key, FormulaCell& cell);
+    void calculateCell(FormulaCell& cell, const CellAddress& address, size_t sheetIndex);
+    void buildDependencyGraph();
+    void ensureDependencyGraph();
+    std::vector<SheetCellAddress> topologicalSort(const std::unordered_set<SheetCellAddress>& dirtyCells,
+                                                  std::vector<SheetCellAddress>& cyclicCells);
+    void evaluateCells(const std::vector<SheetCellAddress>& sortedCells, RecalculationProgress* progress);
+    void evaluateCellsParallel(const std::vector<SheetCellAddress>& sortedCells, RecalculationProgress* progress);
+    void handleCircularReferences(const std::vector<DependencyGraph::Component>& components,
+                                  RecalculationProgress* progress);
+    void updateVolatileFunctions();
+    void updateFunctionCallers(uint32_t functionId);
+    void notifyRangeSubscribers();
 };
 
-// TODO: Implement circular reference detection and resolution
 // TODO: Add support for array formulas and dynamic arrays
-// TODO: Implement multi-threaded calculation for large workbooks
-// TODO: Add support for external data connections and real-time data
\ No newline at end of file
+// TODO: Add support for external data connections and real-time data
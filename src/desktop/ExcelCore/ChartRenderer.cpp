@@ -0,0 +1,423 @@
+#include "ChartRenderer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+namespace ExcelCore {
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+
+float clampCoverage(double value) {
+    return static_cast<float>(std::min(1.0, std::max(0.0, value)));
+}
+
+double distanceToSegment(double px, double py, const ChartPoint& a, const ChartPoint& b) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = lengthSquared > 0 ? std::min(1.0, std::max(0.0, ((px - a.x) * dx + (py - a.y) * dy) / lengthSquared)) : 0.0;
+    double ex = a.x + t * dx - px;
+    double ey = a.y + t * dy - py;
+    return std::sqrt(ex * ex + ey * ey);
+}
+
+void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+    // 5552 is the largest run whose sums cannot overflow 32 bits
+    constexpr size_t kRun = 5552;
+    uint32_t a = 1;
+    uint32_t b = 0;
+    while (size > 0) {
+        size_t run = std::min(size, kRun);
+        for (size_t i = 0; i < run; ++i) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += run;
+        size -= run;
+    }
+    return b << 16 | a;
+}
+}
+
+void RasterCanvas::reset(uint32_t newWidth, uint32_t newHeight, Color background) {
+    width = newWidth;
+    height = newHeight;
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    pixels.resize(pixelCount * 3);
+    for (size_t i = 0; i < pixelCount; ++i) {
+        pixels[i * 3] = background.red;
+        pixels[i * 3 + 1] = background.green;
+        pixels[i * 3 + 2] = background.blue;
+    }
+    coverage.assign(pixelCount, 0.0f);
+}
+
+void RasterCanvas::blend(uint32_t x, uint32_t y, Color color, float alpha) {
+    uint8_t* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+    pixel[0] = static_cast<uint8_t>(pixel[0] + (color.red - pixel[0]) * alpha + 0.5f);
+    pixel[1] = static_cast<uint8_t>(pixel[1] + (color.green - pixel[1]) * alpha + 0.5f);
+    pixel[2] = static_cast<uint8_t>(pixel[2] + (color.blue - pixel[2]) * alpha + 0.5f);
+}
+
+// Each pixel is covered by the overlap of its unit square with the rectangle
+void RasterCanvas::fillRect(double x, double y, double rectWidth, double rectHeight, Color color) {
+    if (rectWidth < 0) {
+        x += rectWidth;
+        rectWidth = -rectWidth;
+    }
+    if (rectHeight < 0) {
+        y += rectHeight;
+        rectHeight = -rectHeight;
+    }
+    double left = std::max(x, 0.0);
+    double top = std::max(y, 0.0);
+    double right = std::min(x + rectWidth, static_cast<double>(width));
+    double bottom = std::min(y + rectHeight, static_cast<double>(height));
+    if (!(left < right && top < bottom)) {
+        return;
+    }
+    uint32_t firstColumn = static_cast<uint32_t>(left);
+    uint32_t lastColumn = static_cast<uint32_t>(std::ceil(right));
+    uint32_t firstRow = static_cast<uint32_t>(top);
+    uint32_t lastRow = static_cast<uint32_t>(std::ceil(bottom));
+    for (uint32_t row = firstRow; row < lastRow; ++row) {
+        double rowCoverage = std::min(bottom, row + 1.0) - std::max(top, static_cast<double>(row));
+        for (uint32_t column = firstColumn; column < lastColumn; ++column) {
+            double columnCoverage = std::min(right, column + 1.0) - std::max(left, static_cast<double>(column));
+            blend(column, row, color, static_cast<float>(rowCoverage * columnCoverage));
+        }
+    }
+}
+
+// Pixels within half the line width of a segment are covered; coverage falls
+// off linearly over the pixel at the edge
+void RasterCanvas::drawPolyline(const ChartPoint* points, size_t count, double lineWidth, Color color) {
+    if (count == 0 || width == 0 || height == 0) {
+        return;
+    }
+    double halfWidth = std::max(lineWidth, 0.5) / 2;
+    double reach = halfWidth + 1;
+    uint32_t boundsLeft = width;
+    uint32_t boundsTop = height;
+    uint32_t boundsRight = 0;
+    uint32_t boundsBottom = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const ChartPoint& a = points[i];
+        const ChartPoint& b = i + 1 < count ? points[i + 1] : points[i];
+        if (!std::isfinite(a.x) || !std::isfinite(a.y) || !std::isfinite(b.x) || !std::isfinite(b.y)) {
+            continue;
+        }
+        // A lone point is drawn as a dot; otherwise the last point adds nothing
+        if (i + 1 == count && count > 1) {
+            break;
+        }
+        double left = std::max(0.0, std::floor(std::min(a.x, b.x) - reach));
+        double top = std::max(0.0, std::floor(std::min(a.y, b.y) - reach));
+        double right = std::min(static_cast<double>(width), std::ceil(std::max(a.x, b.x) + reach));
+        double bottom = std::min(static_cast<double>(height), std::ceil(std::max(a.y, b.y) + reach));
+        if (!(left < right && top < bottom)) {
+            continue;
+        }
+        uint32_t x0 = static_cast<uint32_t>(left);
+        uint32_t x1 = static_cast<uint32_t>(right);
+        uint32_t y0 = static_cast<uint32_t>(top);
+        uint32_t y1 = static_cast<uint32_t>(bottom);
+        for (uint32_t y = y0; y < y1; ++y) {
+            float* row = &coverage[static_cast<size_t>(y) * width];
+            for (uint32_t x = x0; x < x1; ++x) {
+                float value = clampCoverage(halfWidth + 0.5 - distanceToSegment(x + 0.5, y + 0.5, a, b));
+                row[x] = std::max(row[x], value);
+            }
+        }
+        boundsLeft = std::min(boundsLeft, x0);
+        boundsTop = std::min(boundsTop, y0);
+        boundsRight = std::max(boundsRight, x1);
+        boundsBottom = std::max(boundsBottom, y1);
+    }
+
+    for (uint32_t y = boundsTop; y < boundsBottom; ++y) {
+        float* row = &coverage[static_cast<size_t>(y) * width];
+        for (uint32_t x = boundsLeft; x < boundsRight; ++x) {
+            if (row[x] > 0) {
+                blend(x, y, color, row[x]);
+                row[x] = 0;
+            }
+        }
+    }
+}
+
+// Coverage comes from the signed distance to the nearest edge: the arc, or
+// the two radii bounding the wedge
+void RasterCanvas::fillWedge(double centerX, double centerY, double radius, double startAngle, double endAngle, Color color) {
+    double sweep = endAngle - startAngle;
+    if (!(sweep > 0) || !(radius > 0)) {
+        return;
+    }
+    bool fullCircle = sweep >= 2 * kPi - 1e-9;
+    double startX = std::cos(startAngle);
+    double startY = std::sin(startAngle);
+    double endX = std::cos(endAngle);
+    double endY = std::sin(endAngle);
+
+    double left = std::max(0.0, std::floor(centerX - radius - 1));
+    double top = std::max(0.0, std::floor(centerY - radius - 1));
+    double right = std::min(static_cast<double>(width), std::ceil(centerX + radius + 1));
+    double bottom = std::min(static_cast<double>(height), std::ceil(centerY + radius + 1));
+    for (double y = top; y < bottom; ++y) {
+        for (double x = left; x < right; ++x) {
+            double dx = x + 0.5 - centerX;
+            double dy = y + 0.5 - centerY;
+            double distance = radius - std::sqrt(dx * dx + dy * dy);
+            if (!fullCircle) {
+                // Positive on the inner side of each radius
+                double fromStart = startX * dy - startY * dx;
+                double fromEnd = dx * endY - dy * endX;
+                double angular = sweep <= kPi ? std::min(fromStart, fromEnd) : std::max(fromStart, fromEnd);
+                distance = std::min(distance, angular);
+            }
+            float alpha = clampCoverage(distance + 0.5);
+            if (alpha > 0) {
+                blend(static_cast<uint32_t>(x), static_cast<uint32_t>(y), color, alpha);
+            }
+        }
+    }
+}
+
+void RasterCanvas::drawText(double, double, std::string_view, double, Color) {}
+
+void SvgCanvas::append(std::string_view text) {
+    out->insert(out->end(), text.begin(), text.end());
+}
+
+// Two decimals are finer than the pixel grid; trailing zeros are dropped
+void SvgCanvas::appendNumber(double value) {
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 2);
+    char* end = result.ptr;
+    while (end > buffer && end[-1] == '0') {
+        --end;
+    }
+    if (end > buffer && end[-1] == '.') {
+        --end;
+    }
+    std::string_view text(buffer, static_cast<size_t>(end - buffer));
+    append(text == "-0" || text.empty() ? std::string_view("0") : text);
+}
+
+void SvgCanvas::appendColor(Color color) {
+    static const char kHex[] = "0123456789abcdef";
+    char text[7] = {'#',
+                    kHex[color.red >> 4], kHex[color.red & 15],
+                    kHex[color.green >> 4], kHex[color.green & 15],
+                    kHex[color.blue >> 4], kHex[color.blue & 15]};
+    append(std::string_view(text, sizeof(text)));
+}
+
+void SvgCanvas::begin(std::vector<uint8_t>& output, uint32_t width, uint32_t height, Color background) {
+    out = &output;
+    append("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    appendNumber(width);
+    append("\" height=\"");
+    appendNumber(height);
+    append("\" viewBox=\"0 0 ");
+    appendNumber(width);
+    append(" ");
+    appendNumber(height);
+    append("\">\n<rect width=\"100%\" height=\"100%\" fill=\"");
+    appendColor(background);
+    append("\"/>\n");
+}
+
+void SvgCanvas::end() {
+    append("</svg>\n");
+    out = nullptr;
+}
+
+void SvgCanvas::fillRect(double x, double y, double width, double height, Color color) {
+    if (width < 0) {
+        x += width;
+        width = -width;
+    }
+    if (height < 0) {
+        y += height;
+        height = -height;
+    }
+    append("<rect x=\"");
+    appendNumber(x);
+    append("\" y=\"");
+    appendNumber(y);
+    append("\" width=\"");
+    appendNumber(width);
+    append("\" height=\"");
+    appendNumber(height);
+    append("\" fill=\"");
+    appendColor(color);
+    append("\"/>\n");
+}
+
+void SvgCanvas::drawPolyline(const ChartPoint* points, size_t count, double lineWidth, Color color) {
+    if (count == 0) {
+        return;
+    }
+    append("<polyline fill=\"none\" stroke-linejoin=\"round\" stroke-linecap=\"round\" stroke=\"");
+    appendColor(color);
+    append("\" stroke-width=\"");
+    appendNumber(lineWidth);
+    append("\" points=\"");
+    bool first = true;
+    for (size_t i = 0; i < count; ++i) {
+        if (!std::isfinite(points[i].x) || !std::isfinite(points[i].y)) {
+            continue;
+        }
+        if (!first) {
+            append(" ");
+        }
+        first = false;
+        appendNumber(points[i].x);
+        append(",");
+        appendNumber(points[i].y);
+    }
+    append("\"/>\n");
+}
+
+void SvgCanvas::fillWedge(double centerX, double centerY, double radius, double startAngle, double endAngle, Color color) {
+    double sweep = endAngle - startAngle;
+    if (!(sweep > 0) || !(radius > 0)) {
+        return;
+    }
+    if (sweep >= 2 * kPi - 1e-9) {
+        append("<circle cx=\"");
+        appendNumber(centerX);
+        append("\" cy=\"");
+        appendNumber(centerY);
+        append("\" r=\"");
+        appendNumber(radius);
+        append("\" fill=\"");
+        appendColor(color);
+        append("\"/>\n");
+        return;
+    }
+    // Sweep flag 1 draws in the direction of increasing angle (clockwise on screen)
+    append("<path d=\"M");
+    appendNumber(centerX);
+    append(" ");
+    appendNumber(centerY);
+    append("L");
+    appendNumber(centerX + radius * std::cos(startAngle));
+    append(" ");
+    appendNumber(centerY + radius * std::sin(startAngle));
+    append("A");
+    appendNumber(radius);
+    append(" ");
+    appendNumber(radius);
+    append(sweep > kPi ? " 0 1 1 " : " 0 0 1 ");
+    appendNumber(centerX + radius * std::cos(endAngle));
+    append(" ");
+    appendNumber(centerY + radius * std::sin(endAngle));
+    append("Z\" fill=\"");
+    appendColor(color);
+    append("\"/>\n");
+}
+
+void SvgCanvas::drawText(double x, double y, std::string_view text, double size, Color color) {
+    append("<text x=\"");
+    appendNumber(x);
+    append("\" y=\"");
+    appendNumber(y);
+    append("\" font-family=\"sans-serif\" font-size=\"");
+    appendNumber(size);
+    append("\" fill=\"");
+    appendColor(color);
+    append("\">");
+    for (char c : text) {
+        switch (c) {
+            case '<': append("&lt;"); break;
+            case '>': append("&gt;"); break;
+            case '&': append("&amp;"); break;
+            case '"': append("&quot;"); break;
+            default: out->push_back(static_cast<uint8_t>(c)); break;
+        }
+    }
+    append("</text>\n");
+}
+
+void PngEncoder::appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size) {
+    appendBigEndian(out, static_cast<uint32_t>(size));
+    size_t typeOffset = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    // The CRC covers the chunk type and data
+    appendBigEndian(out, crc32(out.data() + typeOffset, size + 4));
+}
+
+void PngEncoder::encode(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out) {
+    static const uint8_t kSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.assign(kSignature, kSignature + sizeof(kSignature));
+
+    uint8_t header[13];
+    for (int i = 0; i < 4; ++i) {
+        header[i] = static_cast<uint8_t>(width >> (24 - 8 * i));
+        header[4 + i] = static_cast<uint8_t>(height >> (24 - 8 * i));
+    }
+    header[8] = 8;   // bits per channel
+    header[9] = 2;   // RGB
+    header[10] = 0;  // deflate
+    header[11] = 0;  // adaptive filtering
+    header[12] = 0;  // not interlaced
+    appendChunk(out, "IHDR", header, sizeof(header));
+
+    // Each row is stored as a filter type byte and the row's residuals
+    size_t stride = static_cast<size_t>(width) * 3;
+    filtered.resize((stride + 1) * height);
+    candidates.resize(stride * 2);
+    uint8_t* sub = candidates.data();
+    uint8_t* up = candidates.data() + stride;
+    auto cost = [stride](const uint8_t* row) {
+        size_t sum = 0;
+        for (size_t i = 0; i < stride; ++i) {
+            sum += row[i] < 128 ? row[i] : 256 - row[i];
+        }
+        return sum;
+    };
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* row = pixels + y * stride;
+        const uint8_t* above = y > 0 ? row - stride : nullptr;
+        for (size_t i = 0; i < stride; ++i) {
+            sub[i] = static_cast<uint8_t>(row[i] - (i >= 3 ? row[i - 3] : 0));
+            up[i] = static_cast<uint8_t>(row[i] - (above ? above[i] : 0));
+        }
+        size_t costs[3] = {cost(row), cost(sub), cost(up)};
+        uint8_t filter = static_cast<uint8_t>(std::min_element(costs, costs + 3) - costs);
+        const uint8_t* chosen = filter == 0 ? row : filter == 1 ? sub : up;
+        uint8_t* target = filtered.data() + y * (stride + 1);
+        target[0] = filter;
+        std::memcpy(target + 1, chosen, stride);
+    }
+
+    // zlib stream: header (deflate, 32 KB window, fastest level), data, Adler-32
+    idat.assign({0x78, 0x01});
+    deflater.reset();
+    deflater.write(filtered.data(), filtered.size());
+    deflater.finish();
+    std::vector<uint8_t>& compressed = deflater.getOutput();
+    idat.insert(idat.end(), compressed.begin(), compressed.end());
+    compressed.clear();
+    appendBigEndian(idat, adler32(filtered.data(), filtered.size()));
+    appendChunk(out, "IDAT", idat.data(), idat.size());
+    appendChunk(out, "IEND", nullptr, 0);
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Downsampling.h"
+#include "ZipArchive.h"
+
+namespace ExcelCore {
+
+struct Color {
+    uint8_t red = 0;
+    uint8_t green = 0;
+    uint8_t blue = 0;
+};
+
+// The surface chart types draw on, in pixel coordinates with y pointing down.
+// Angles are in radians, clockwise from the positive x axis.
+class ChartCanvas {
+public:
+    virtual ~ChartCanvas() = default;
+
+    virtual void fillRect(double x, double y, double width, double height, Color color) = 0;
+    virtual void drawPolyline(const ChartPoint* points, size_t count, double lineWidth, Color color) = 0;
+    virtual void fillWedge(double centerX, double centerY, double radius, double startAngle, double endAngle, Color color) = 0;
+    // Baseline-left anchored text
+    virtual void drawText(double x, double y, std::string_view text, double size, Color color) = 0;
+};
+
+// An opaque RGB image drawn with anti-aliasing: every primitive is reduced to
+// a per-pixel coverage (exact box overlap for rectangles, distance to the
+// outline for lines and wedges) and blended over what is there.
+class RasterCanvas : public ChartCanvas {
+public:
+    // Resizes and clears; the pixel buffer is kept between images
+    void reset(uint32_t width, uint32_t height, Color background);
+
+    uint32_t getWidth() const {
+        return width;
+    }
+
+    uint32_t getHeight() const {
+        return height;
+    }
+
+    // Rows of width * 3 bytes, top to bottom
+    const uint8_t* getPixels() const {
+        return pixels.data();
+    }
+
+    void fillRect(double x, double y, double width, double height, Color color) override;
+    void drawPolyline(const ChartPoint* points, size_t count, double lineWidth, Color color) override;
+    void fillWedge(double centerX, double centerY, double radius, double startAngle, double endAngle, Color color) override;
+    // Not drawn: the raster has no font rasterizer
+    void drawText(double x, double y, std::string_view text, double size, Color color) override;
+
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+    // Coverage of the polyline being drawn. Segments take the maximum instead
+    // of blending one by one, so joints are not drawn twice.
+    std::vector<float> coverage;
+
+    void blend(uint32_t x, uint32_t y, Color color, float alpha);
+};
+
+// Writes SVG markup straight into a caller-owned byte buffer, so one buffer
+// can be reused for every chart a thread renders
+class SvgCanvas : public ChartCanvas {
+public:
+    // Appends the document header and background to out, which must outlive end()
+    void begin(std::vector<uint8_t>& out, uint32_t width, uint32_t height, Color background);
+    void end();
+
+    void fillRect(double x, double y, double width, double height, Color color) override;
+    void drawPolyline(const ChartPoint* points, size_t count, double lineWidth, Color color) override;
+    void fillWedge(double centerX, double centerY, double radius, double startAngle, double endAngle, Color color) override;
+    void drawText(double x, double y, std::string_view text, double size, Color color) override;
+
+private:
+    std::vector<uint8_t>* out = nullptr;
+
+    void append(std::string_view text);
+    void appendNumber(double value);
+    void appendColor(Color color);
+};
+
+// Encodes RGB images as PNG: each row takes the filter (none, sub or up) with
+// the smallest sum of absolute residuals, and the zlib stream uses the ZIP
+// writer's deflater. Scratch buffers are kept between images.
+class PngEncoder {
+public:
+    // Replaces the contents of out
+    void encode(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out);
+
+private:
+    Deflater deflater;
+    std::vector<uint8_t> filtered;     // filter byte and residuals of each row
+    std::vector<uint8_t> candidates;   // one row filtered with sub, one with up
+    std::vector<uint8_t> idat;
+
+    static void appendChunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, size_t size);
+};
+
+} // namespace ExcelCore
+
+// TODO: Rasterize text (titles, axis labels) with an embedded bitmap font
+// TODO: Use dynamic Huffman blocks for smaller PNG files
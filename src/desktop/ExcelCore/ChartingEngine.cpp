@@ -1,10 +1,282 @@
 #include "ChartingEngine.h"
 #include "DataStructures.h"
+#include "ColumnStore.h"
+#include "CalculationEngine.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
 #include <stdexcept>
 #include <memory>
 #include <vector>
 
+using ExcelCore::ColumnChunk;
+using ExcelCore::ColumnStore;
+using ExcelCore::CellType;
+using ExcelCore::SheetRange;
+using ExcelCore::ThreadPool;
+using ExcelCore::Color;
+using ExcelCore::RasterCanvas;
+using ExcelCore::SvgCanvas;
+using ExcelCore::PngEncoder;
+
+namespace Downsampling = ExcelCore::Downsampling;
+
+namespace {
+constexpr double kPi = 3.14159265358979323846;
+const Color kBackground{255, 255, 255};
+const Color kAxisColor{134, 134, 134};
+const Color kTitleColor{64, 64, 64};
+
+bool isNumericTag(uint8_t type) {
+    return type == static_cast<uint8_t>(CellType::Number) || type == static_cast<uint8_t>(CellType::Date);
+}
+
+// Copies rows [firstRow, lastRow] of one column, chunk by chunk, into out;
+// rows without a number stay NaN
+void extractColumn(const ColumnStore& store, uint32_t column, uint32_t firstRow, uint32_t lastRow, double* out) {
+    uint32_t chunkCount = store.getChunkCount(column);
+    if (chunkCount == 0) {
+        return;
+    }
+    uint32_t lastChunk = std::min(lastRow / ColumnChunk::kRows, chunkCount - 1);
+    for (uint32_t chunkIndex = firstRow / ColumnChunk::kRows; chunkIndex <= lastChunk; ++chunkIndex) {
+        const ColumnChunk* chunk = store.getChunk(column, chunkIndex);
+        if (chunk == nullptr) {
+            continue;
+        }
+        uint32_t baseRow = chunkIndex * ColumnChunk::kRows;
+        uint32_t begin = std::max(firstRow, baseRow) - baseRow;
+        uint32_t end = std::min(lastRow - baseRow, ColumnChunk::kRows - 1) + 1;
+        double* target = out + (baseRow + begin - firstRow);
+        if (chunk->getMode() == ColumnChunk::Mode::Dense) {
+            const double* numbers = chunk->numbers();
+            const uint8_t* types = chunk->types();
+            for (uint32_t row = begin; row < end; ++row) {
+                if (isNumericTag(types[row])) {
+                    target[row - begin] = numbers[row];
+                }
+            }
+            continue;
+        }
+        for (const auto& entry : chunk->sparseEntries()) {
+            if (entry.row >= begin && entry.row < end && isNumericTag(entry.type)) {
+                target[entry.row - begin] = entry.number;
+            }
+        }
+    }
+}
+}
+
+Chart::Chart(ChartType type, const std::string& title) : type(type), title(title) {}
+
+void Chart::setData(const std::vector<double>& newData) {
+    setData(std::vector<std::vector<double>>{newData});
+}
+
+void Chart::setData(std::vector<std::vector<double>> newData) {
+    data = std::move(newData);
+    renderSeriesCurrent = false;
+}
+
+void Chart::setSize(uint32_t newWidth, uint32_t newHeight) {
+    if (newWidth != width) {
+        renderSeriesCurrent = false;
+    }
+    width = newWidth;
+    height = newHeight;
+}
+
+void Chart::setDownsampleMethod(DownsampleMethod method) {
+    if (method != downsampleMethod) {
+        renderSeriesCurrent = false;
+    }
+    downsampleMethod = method;
+}
+
+const std::vector<std::vector<ChartPoint>>& Chart::getRenderSeries() {
+    updateRenderSeries();
+    return renderSeries;
+}
+
+// Reduction runs in time linear in the series length and yields points in
+// proportion to the width, so drawing cost no longer grows with the range
+bool Chart::updateRenderSeries() {
+    if (renderSeriesCurrent) {
+        return false;
+    }
+    // A pie has one wedge per value; dropping values would change the whole
+    DownsampleMethod method = type == ChartType::Pie ? DownsampleMethod::None : downsampleMethod;
+    std::vector<std::vector<ChartPoint>> updated(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        updated[i] = Downsampling::reduce(data[i].data(), data[i].size(), method, width);
+    }
+    renderSeriesCurrent = true;
+
+    auto samePoints = [](const std::vector<ChartPoint>& a, const std::vector<ChartPoint>& b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const ChartPoint& p, const ChartPoint& q) {
+            return p.x == q.x && p.y == q.y;
+        });
+    };
+    bool changed = renderVersion == 0 || !std::equal(updated.begin(), updated.end(), renderSeries.begin(), renderSeries.end(), samePoints);
+    renderSeries = std::move(updated);
+    if (changed) {
+        ++renderVersion;
+    }
+    return changed;
+}
+
+bool Chart::patchData(size_t seriesIndex, size_t offset, const double* values, size_t count) {
+    if (seriesIndex >= data.size() || offset > data[seriesIndex].size()) {
+        return false;
+    }
+    double* target = data[seriesIndex].data() + offset;
+    count = std::min(count, data[seriesIndex].size() - offset);
+    bool changed = false;
+    for (size_t i = 0; i < count; ++i) {
+        // Gaps are NaN, which never compares equal to itself
+        bool same = target[i] == values[i] || (std::isnan(target[i]) && std::isnan(values[i]));
+        if (!same) {
+            target[i] = values[i];
+            changed = true;
+        }
+    }
+    if (changed) {
+        renderSeriesCurrent = false;
+    }
+    return changed;
+}
+
+Chart::PlotArea Chart::drawFrame(ChartCanvas& canvas, bool axes) const {
+    // Room for the title above and for labels left of and below the axes
+    constexpr double kTitleHeight = 40;
+    constexpr double kMargin = 16;
+    constexpr double kAxisMargin = 48;
+    if (!title.empty()) {
+        canvas.drawText(kMargin, 26, title, 16, kTitleColor);
+    }
+    double left = axes ? kAxisMargin : kMargin;
+    double bottom = axes ? kAxisMargin - kMargin : 0;
+    PlotArea area{left, kTitleHeight, std::max(1.0, width - left - kMargin), std::max(1.0, height - kTitleHeight - kMargin - bottom)};
+    if (axes) {
+        canvas.fillRect(area.left - 1, area.top, 1, area.height + 1, kAxisColor);
+        canvas.fillRect(area.left - 1, area.top + area.height, area.width + 1, 1, kAxisColor);
+    }
+    return area;
+}
+
+void Chart::getValueRange(double& low, double& high) {
+    low = 0;
+    high = 0;
+    for (const auto& series : getRenderSeries()) {
+        for (const auto& point : series) {
+            low = std::min(low, point.y);
+            high = std::max(high, point.y);
+        }
+    }
+    if (high == low) {
+        high = low + 1;
+    }
+}
+
+size_t Chart::getCategoryCount() const {
+    size_t count = 0;
+    for (const auto& series : data) {
+        count = std::max(count, series.size());
+    }
+    return count;
+}
+
+// The default Office theme's accent colours
+Color Chart::getSeriesColor(size_t seriesIndex) {
+    static const Color kPalette[] = {
+        {0x44, 0x72, 0xC4}, {0xED, 0x7D, 0x31}, {0xA5, 0xA5, 0xA5},
+        {0xFF, 0xC0, 0x00}, {0x5B, 0x9B, 0xD5}, {0x70, 0xAD, 0x47},
+    };
+    return kPalette[seriesIndex % (sizeof(kPalette) / sizeof(kPalette[0]))];
+}
+
+void BarChart::draw(ChartCanvas& canvas) {
+    PlotArea area = drawFrame(canvas, true);
+    const auto& series = getRenderSeries();
+    size_t categoryCount = getCategoryCount();
+    if (series.empty() || categoryCount == 0) {
+        return;
+    }
+    double low;
+    double high;
+    getValueRange(low, high);
+    double scale = area.height / (high - low);
+    double baseline = area.top + high * scale;
+
+    // Bars of a category share 80% of its slot; downsampled series would
+    // vanish below a pixel, so a bar is never narrower than one
+    double slot = area.width / static_cast<double>(categoryCount);
+    double barWidth = slot * 0.8 / static_cast<double>(series.size());
+    double drawnWidth = std::max(barWidth, 1.0);
+    for (size_t s = 0; s < series.size(); ++s) {
+        Color color = getSeriesColor(s);
+        for (const auto& point : series[s]) {
+            double x = area.left + point.x * slot + slot * 0.1 + (static_cast<double>(s) + 0.5) * barWidth - drawnWidth / 2;
+            canvas.fillRect(x, baseline, drawnWidth, -point.y * scale, color);
+        }
+    }
+}
+
+void LineChart::draw(ChartCanvas& canvas) {
+    PlotArea area = drawFrame(canvas, true);
+    const auto& series = getRenderSeries();
+    size_t categoryCount = getCategoryCount();
+    if (series.empty() || categoryCount == 0) {
+        return;
+    }
+    double low;
+    double high;
+    getValueRange(low, high);
+    double scale = area.height / (high - low);
+    // Points sit in the middle of their category's slot
+    double slot = area.width / static_cast<double>(categoryCount);
+
+    std::vector<ChartPoint> points;
+    for (size_t s = 0; s < series.size(); ++s) {
+        points.clear();
+        for (const auto& point : series[s]) {
+            points.push_back({area.left + (point.x + 0.5) * slot, area.top + (high - point.y) * scale});
+        }
+        canvas.drawPolyline(points.data(), points.size(), 2, getSeriesColor(s));
+    }
+}
+
+void PieChart::draw(ChartCanvas& canvas) {
+    PlotArea area = drawFrame(canvas, false);
+    const auto& series = getRenderSeries();
+    if (series.empty()) {
+        return;
+    }
+    double total = 0;
+    for (const auto& point : series.front()) {
+        if (point.y > 0) {
+            total += point.y;
+        }
+    }
+    if (!(total > 0)) {
+        return;
+    }
+    double radius = std::min(area.width, area.height) * 0.45;
+    double centerX = area.left + area.width / 2;
+    double centerY = area.top + area.height / 2;
+    double angle = -kPi / 2;
+    size_t wedge = 0;
+    for (const auto& point : series.front()) {
+        if (point.y > 0) {
+            double sweep = 2 * kPi * point.y / total;
+            canvas.fillWedge(centerX, centerY, radius, angle, angle + sweep, getSeriesColor(wedge++));
+            angle += sweep;
+        }
+    }
+}
+
 // Constructor implementation for the ChartingEngine class
 ChartingEngine::ChartingEngine() {
     // Initialize any necessary resources for chart creation and management
@@ -12,26 +284,27 @@ ChartingEngine::ChartingEngine() {
 }
 
 // Implementation of the createChart function
-std::unique_ptr<Chart> ChartingEngine::createChart(const Worksheet& worksheet, const CellAddress& startCell, const CellAddress& endCell, ChartType type) {
+int ChartingEngine::createChart(const Worksheet& worksheet, const CellAddress& startCell, const CellAddress& endCell, ChartType type, const std::string& title) {
     // Validate input parameters
     if (!isValidRange(startCell, endCell)) {
         throw std::invalid_argument("Invalid cell range for chart creation");
     }
 
-    // Extract data from the specified range in the worksheet
-    std::vector<std::vector<double>> chartData = extractDataFromRange(worksheet, startCell, endCell);
-
     // Create a new Chart object of the specified type using a factory method
-    std::unique_ptr<Chart> newChart = createChartByType(type, chartData);
+    std::shared_ptr<Chart> newChart = createChartByType(type, title);
 
-    // Configure the chart with the extracted data
-    newChart->setData(chartData);
+    // Configure the chart with the data in the range; series are reduced for
+    // the render width when drawn, not here
+    newChart->setData(extractDataFromRange(worksheet, startCell, endCell));
+    newChart->sourceFirst = startCell;
+    newChart->sourceLast = endCell;
 
-    // Add the chart to the charts vector
-    charts.push_back(newChart.get());
+    // The pool owns the chart from here on
+    return charts.add(std::move(newChart));
+}
 
-    // Return a unique pointer to the created chart
-    return newChart;
+std::shared_ptr<Chart> ChartingEngine::getChart(int handle) const {
+    return charts.find(handle);
 }
 
 // Implementation of the updateChart function
@@ -41,106 +314,203 @@ bool ChartingEngine::updateChart(Chart& chart, const Worksheet& worksheet, const
         return false;
     }
 
-    // Extract new data from the specified range in the worksheet
+    // Same source: patch the cached series in place, so the render series
+    // (and the version) only change if a value did
+    if (startCell == chart.sourceFirst && endCell == chart.sourceLast) {
+        refreshChart(chart, worksheet, startCell, endCell);
+        return true;
+    }
+
+    // A new source range is extracted in full; a subscription follows it
     std::vector<std::vector<double>> newData = extractDataFromRange(worksheet, startCell, endCell);
+    chart.setData(std::move(newData));
+    chart.sourceFirst = startCell;
+    chart.sourceLast = endCell;
+    if (chart.sourceEngine != nullptr) {
+        CalculationEngine& engine = *chart.sourceEngine;
+        size_t sheetIndex = chart.sourceSheet;
+        unsubscribeChart(chart);
+        subscribeChart(chart, engine, sheetIndex);
+    }
+    return true;
+}
 
-    // Update the chart with the new data using chart.setData()
-    chart.setData(newData);
+bool ChartingEngine::refreshChart(Chart& chart, const Worksheet& worksheet, const CellAddress& first, const CellAddress& last) {
+    patchChart(chart, worksheet, first, last);
+    return chart.updateRenderSeries();
+}
 
-    // Recalculate and redraw the chart
-    chart.recalculate();
-    chart.redraw();
+void ChartingEngine::patchChart(Chart& chart, const Worksheet& worksheet, const CellAddress& first, const CellAddress& last) {
+    // Clip to the source range
+    uint32_t firstRow = std::max(first.row, chart.sourceFirst.row);
+    uint32_t lastRow = std::min(last.row, chart.sourceLast.row);
+    uint32_t firstColumn = std::max(first.column, chart.sourceFirst.column);
+    uint32_t lastColumn = std::min(last.column, chart.sourceLast.column);
+    if (firstRow > lastRow || firstColumn > lastColumn) {
+        return;
+    }
 
-    return true;
+    std::vector<double> values(static_cast<size_t>(lastRow - firstRow) + 1);
+    for (uint32_t column = firstColumn; column <= lastColumn; ++column) {
+        std::fill(values.begin(), values.end(), std::numeric_limits<double>::quiet_NaN());
+        extractColumn(worksheet.values, column, firstRow, lastRow, values.data());
+        chart.patchData(column - chart.sourceFirst.column, firstRow - chart.sourceFirst.row, values.data(), values.size());
+    }
 }
 
-// Implementation of the deleteChart function
-bool ChartingEngine::deleteChart(const Chart& chart) {
-    // Find the specified chart in the charts vector using std::find_if
-    auto it = std::find_if(charts.begin(), charts.end(),
-        [&chart](const Chart* c) { return c == &chart; });
-
-    // If found, use std::vector::erase to remove the chart from the vector
-    if (it != charts.end()) {
-        charts.erase(it);
-        return true;
+void ChartingEngine::subscribeChart(Chart& chart, CalculationEngine& engine, size_t sheetIndex) {
+    unsubscribeChart(chart);
+    SheetRange range(static_cast<uint32_t>(sheetIndex), chart.sourceFirst, chart.sourceLast);
+    chart.sourceEngine = &engine;
+    chart.sourceSheet = sheetIndex;
+    chart.sourceSubscription = engine.subscribeRange(range, [this, &chart, &engine](const std::vector<SheetRange>& changed) {
+        auto workbook = engine.getWorkbook();
+        if (!workbook || changed.front().sheetIndex >= workbook->getWorksheetCount()) {
+            return;
+        }
+        const Worksheet& worksheet = workbook->getWorksheet(changed.front().sheetIndex);
+        for (const auto& part : changed) {
+            patchChart(chart, worksheet, part.first, part.last);
+        }
+        if (chart.updateRenderSeries() && chartChanged) {
+            chartChanged(chart);
+        }
+    });
+}
+
+void ChartingEngine::unsubscribeChart(Chart& chart) {
+    if (chart.sourceEngine != nullptr) {
+        chart.sourceEngine->unsubscribeRange(chart.sourceSubscription);
+        chart.sourceEngine = nullptr;
+        chart.sourceSubscription = 0;
     }
+}
 
-    return false;
+void ChartingEngine::setChartChangedCallback(std::function<void(Chart&)> callback) {
+    chartChanged = std::move(callback);
 }
 
-// Implementation of the renderChart function
-std::vector<uint8_t> ChartingEngine::renderChart(const Chart& chart, RenderFormat format) {
-    // Validate the chart and format parameters
-    if (!isValidChart(chart) || !isValidRenderFormat(format)) {
-        throw std::invalid_argument("Invalid chart or render format");
+// Implementation of the deleteChart function
+bool ChartingEngine::deleteChart(int handle) {
+    std::shared_ptr<Chart> chart = charts.remove(handle);
+    if (!chart) {
+        return false;
     }
+    unsubscribeChart(*chart);
+    return true;
+}
 
-    // Prepare the rendering context based on the specified format
-    RenderContext context(format);
+// Implementation of the renderChart function
+std::vector<uint8_t> ChartingEngine::renderChart(Chart& chart, RenderFormat format) {
+    std::vector<uint8_t> out;
+    renderChart(chart, format, out);
+    return out;
+}
 
-    // Call chart.render() to get the raw chart data
-    std::vector<uint8_t> rawData = chart.render(context);
+void ChartingEngine::renderChart(Chart& chart, RenderFormat format, std::vector<uint8_t>& out) {
+    // Scratch kept per thread, so parallel batches share nothing
+    thread_local RasterCanvas raster;
+    thread_local PngEncoder png;
+    thread_local SvgCanvas svg;
 
-    // Convert the raw data to the specified format if necessary
-    std::vector<uint8_t> formattedData = convertToFormat(rawData, format);
+    if (chart.getWidth() == 0 || chart.getHeight() == 0) {
+        throw std::invalid_argument("Chart has no area to render");
+    }
+    out.clear();
+    switch (format) {
+        case RenderFormat::PNG:
+            raster.reset(chart.getWidth(), chart.getHeight(), kBackground);
+            chart.draw(raster);
+            png.encode(raster.getPixels(), raster.getWidth(), raster.getHeight(), out);
+            break;
+        case RenderFormat::SVG:
+            svg.begin(out, chart.getWidth(), chart.getHeight(), kBackground);
+            chart.draw(svg);
+            svg.end();
+            break;
+        default:
+            throw std::invalid_argument("Unsupported render format");
+    }
+}
 
-    // Return the rendered data as a vector of bytes
-    return formattedData;
+std::vector<std::vector<uint8_t>> ChartingEngine::renderCharts(const std::vector<Chart*>& batch, RenderFormat format, size_t threadCount) {
+    if (std::find(batch.begin(), batch.end(), nullptr) != batch.end()) {
+        throw std::invalid_argument("Null chart in render batch");
+    }
+    std::vector<std::vector<uint8_t>> results(batch.size());
+    if (threadCount == 0) {
+        threadCount = ThreadPool::defaultThreadCount();
+    }
+    if (threadCount == 1 || batch.size() <= 1) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            renderChart(*batch[i], format, results[i]);
+        }
+        return results;
+    }
+
+    if (!renderPool || renderPool->size() != threadCount) {
+        renderPool = std::make_unique<ThreadPool>(threadCount);
+    }
+    // The pool drops exceptions, so each task keeps its own
+    std::vector<std::exception_ptr> errors(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        renderPool->submit([&batch, &results, &errors, format, i]() {
+            try {
+                renderChart(*batch[i], format, results[i]);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    renderPool->waitIdle();
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
 }
 
 // Helper function to check if a cell range is valid
 bool ChartingEngine::isValidRange(const CellAddress& startCell, const CellAddress& endCell) {
-    // Implement logic to check if the range is valid
-    // For example, check if startCell is before endCell in both row and column
-    return true; // Placeholder
+    // The start cell must be the top-left corner
+    return startCell.row <= endCell.row && startCell.column <= endCell.column;
 }
 
-// Helper function to extract data from a worksheet range
+// Helper function to extract data from a worksheet range: one series per
+// column, read straight from the column store's chunks
 std::vector<std::vector<double>> ChartingEngine::extractDataFromRange(const Worksheet& worksheet, const CellAddress& startCell, const CellAddress& endCell) {
-    // Implement logic to extract data from the worksheet
-    // This is a placeholder implementation
-    return std::vector<std::vector<double>>();
+    size_t rowCount = static_cast<size_t>(endCell.row - startCell.row) + 1;
+    std::vector<std::vector<double>> series;
+    series.reserve(endCell.column - startCell.column + 1);
+    for (uint32_t column = startCell.column; column <= endCell.column; ++column) {
+        series.emplace_back(rowCount, std::numeric_limits<double>::quiet_NaN());
+        extractColumn(worksheet.values, column, startCell.row, endCell.row, series.back().data());
+    }
+    return series;
 }
 
 // Helper function to create a chart based on its type
-std::unique_ptr<Chart> ChartingEngine::createChartByType(ChartType type, const std::vector<std::vector<double>>& data) {
-    // Implement a factory method to create different types of charts
-    // This is a placeholder implementation
-    return std::make_unique<Chart>();
-}
-
-// Helper function to check if a chart is valid
-bool ChartingEngine::isValidChart(const Chart& chart) {
-    // Implement logic to validate the chart
-    return true; // Placeholder
-}
-
-// Helper function to check if a render format is valid
-bool ChartingEngine::isValidRenderFormat(RenderFormat format) {
-    // Implement logic to validate the render format
-    return true; // Placeholder
-}
-
-// Helper function to convert raw data to a specific format
-std::vector<uint8_t> ChartingEngine::convertToFormat(const std::vector<uint8_t>& rawData, RenderFormat format) {
-    // Implement logic to convert raw data to the specified format
-    // This is a placeholder implementation
-    return rawData;
+std::unique_ptr<Chart> ChartingEngine::createChartByType(ChartType type, const std::string& title) {
+    switch (type) {
+        case ChartType::Bar:
+            return std::make_unique<BarChart>(title);
+        case ChartType::Line:
+            return std::make_unique<LineChart>(title);
+        case ChartType::Pie:
+            return std::make_unique<PieChart>(title);
+        default:
+            throw std::invalid_argument("Unsupported chart type");
+    }
 }
 
 // Destructor implementation for the ChartingEngine class
 ChartingEngine::~ChartingEngine() {
-    // Implement memory management and resource cleanup
-    for (auto chart : charts) {
-        delete chart;
-    }
-    charts.clear();
+    // Charts may outlive the engine through getChart, but their subscriptions
+    // call back into it
+    charts.forEach([this](const std::shared_ptr<Chart>& chart) { unsubscribeChart(*chart); });
 }
 
 // Human tasks:
-// 1. Implement specific chart creation logic for different chart types
-// 2. Add error handling and logging for chart operations
-// 3. Implement memory management and resource cleanup in the ChartingEngine destructor
-// 4. Optimize data extraction and chart rendering for large datasets
-// 5. Implement thread-safety for chart operations if required
\ No newline at end of file
+// 1. Add error handling and logging for chart operations
+// 2. Implement thread-safety for chart operations if required
\ No newline at end of file
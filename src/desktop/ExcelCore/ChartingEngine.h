@@ -1,11 +1,28 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "ChartRenderer.h"
+#include "DataStructures.h"
+#include "Downsampling.h"
+#include "HandleRegistry.h"
+
 // Forward declarations
-class Worksheet;
-class CellAddress;
+class CalculationEngine;
+
+namespace ExcelCore {
+class ThreadPool;
+}
+
+using ExcelCore::Worksheet;
+using ExcelCore::CellAddress;
+using ExcelCore::ChartPoint;
+using ExcelCore::DownsampleMethod;
+using ExcelCore::ChartCanvas;
 
 // Enum for chart types
 enum class ChartType {
@@ -28,39 +45,192 @@ public:
     Chart(ChartType type, const std::string& title);
     virtual ~Chart() = default;
 
+    // One series, or one series per column of the source range. Cells that
+    // hold no number are NaN and drawn as gaps.
     void setData(const std::vector<double>& newData);
-    virtual std::vector<uint8_t> render() = 0;
+    void setData(std::vector<std::vector<double>> newData);
+
+    // Output size in pixels; the width bounds how many points are drawn
+    void setSize(uint32_t width, uint32_t height);
+
+    // Reduction applied to line and bar series longer than the output is wide
+    void setDownsampleMethod(DownsampleMethod method);
+
+    // The points to draw for each series, reduced for the current width.
+    // Computed on first use after the data, size or method changes.
+    const std::vector<std::vector<ChartPoint>>& getRenderSeries();
+
+    // Overwrites count values of one series starting at offset; returns
+    // whether any value changed
+    bool patchData(size_t seriesIndex, size_t offset, const double* values, size_t count);
+
+    // Recomputes the render series if they are out of date; returns whether
+    // the points to draw changed. getRenderVersion() changes with them, so a
+    // chart needs drawing again only when its version moves.
+    bool updateRenderSeries();
+
+    uint64_t getRenderVersion() const {
+        return renderVersion;
+    }
+
+    // The worksheet cells the data came from: one series per column
+    const CellAddress& getSourceFirst() const {
+        return sourceFirst;
+    }
+
+    const CellAddress& getSourceLast() const {
+        return sourceLast;
+    }
+
+    ChartType getType() const {
+        return type;
+    }
+
+    const std::string& getTitle() const {
+        return title;
+    }
+
+    uint32_t getWidth() const {
+        return width;
+    }
+
+    uint32_t getHeight() const {
+        return height;
+    }
+
+    // Draws the chart over a canvas of getWidth() x getHeight() pixels
+    virtual void draw(ChartCanvas& canvas) = 0;
 
 protected:
+    struct PlotArea {
+        double left;
+        double top;
+        double width;
+        double height;
+    };
+
+    // Draws the title (and the axes, if asked) and returns the area left for the data
+    PlotArea drawFrame(ChartCanvas& canvas, bool axes) const;
+
+    // Smallest and largest value drawn, widened to include zero
+    void getValueRange(double& low, double& high);
+
+    // Number of values in the longest series
+    size_t getCategoryCount() const;
+
+    static ExcelCore::Color getSeriesColor(size_t seriesIndex);
+
     ChartType type;
     std::string title;
-    std::vector<double> data;
+    std::vector<std::vector<double>> data;
+    uint32_t width = 640;
+    uint32_t height = 480;
+    DownsampleMethod downsampleMethod = DownsampleMethod::Lttb;
+    std::vector<std::vector<ChartPoint>> renderSeries;
+    bool renderSeriesCurrent = false;
+    uint64_t renderVersion = 0;
+
+private:
+    friend class ChartingEngine;
+
+    CellAddress sourceFirst;
+    CellAddress sourceLast;
+    // Set while the chart follows a calculation engine's changes
+    CalculationEngine* sourceEngine = nullptr;
+    size_t sourceSheet = 0;
+    uint64_t sourceSubscription = 0;
+};
+
+// One group of vertical bars per category, rising from zero
+class BarChart : public Chart {
+public:
+    explicit BarChart(const std::string& title) : Chart(ChartType::Bar, title) {}
+
+    void draw(ChartCanvas& canvas) override;
 };
 
-// ChartingEngine class
+// One line per series
+class LineChart : public Chart {
+public:
+    explicit LineChart(const std::string& title) : Chart(ChartType::Line, title) {}
+
+    void draw(ChartCanvas& canvas) override;
+};
+
+// The first series' positive values as wedges, clockwise from the top
+class PieChart : public Chart {
+public:
+    explicit PieChart(const std::string& title) : Chart(ChartType::Pie, title) {}
+
+    void draw(ChartCanvas& canvas) override;
+};
+
+// ChartingEngine class. The engine owns its charts and hands out integer
+// handles: a handle packs a pool slot and its generation, so lookup and
+// deletion are O(1) and a deleted chart's handle never reaches the chart that
+// reuses its slot.
 class ChartingEngine {
 public:
     ChartingEngine();
+    ~ChartingEngine();
 
-    std::unique_ptr<Chart> createChart(const Worksheet& worksheet,
-                                       const CellAddress& startCell,
-                                       const CellAddress& endCell,
-                                       ChartType type);
+    // Returns the new chart's handle (always positive)
+    int createChart(const Worksheet& worksheet,
+                    const CellAddress& startCell,
+                    const CellAddress& endCell,
+                    ChartType type,
+                    const std::string& title = "");
+
+    // Returns the chart, or nullptr for unknown and deleted handles. A chart
+    // deleted while the caller holds it stays alive until released.
+    std::shared_ptr<Chart> getChart(int handle) const;
 
     bool updateChart(Chart& chart,
                      const Worksheet& worksheet,
                      const CellAddress& startCell,
                      const CellAddress& endCell);
 
-    bool deleteChart(const Chart& chart);
+    // Patches the chart's cached series from rows first..last of its source
+    // (clipped to it) instead of re-reading the whole range; returns whether
+    // the points to draw changed
+    bool refreshChart(Chart& chart, const Worksheet& worksheet, const CellAddress& first, const CellAddress& last);
+
+    // Keeps a chart current with the engine's recalculations: the chart
+    // subscribes to its source range on the given sheet and patches the cells
+    // reported changed. The callback runs when a chart's drawn output changed
+    // and it needs rendering again. Deleting a chart unsubscribes it.
+    void subscribeChart(Chart& chart, CalculationEngine& engine, size_t sheetIndex);
+    void unsubscribeChart(Chart& chart);
+    void setChartChangedCallback(std::function<void(Chart&)> callback);
 
-    std::vector<uint8_t> renderChart(const Chart& chart, RenderFormat format);
+    bool deleteChart(int handle);
+
+    static std::unique_ptr<Chart> createChartByType(ChartType type, const std::string& title = "");
+
+    std::vector<uint8_t> renderChart(Chart& chart, RenderFormat format);
+
+    // Renders into out, replacing its contents. Canvas and encoder buffers are
+    // kept per thread, so rendering into a reused vector does not allocate.
+    static void renderChart(Chart& chart, RenderFormat format, std::vector<uint8_t>& out);
+
+    // Renders every chart in parallel, one result per chart in order. The
+    // charts must be distinct. A threadCount of 0 uses every hardware thread;
+    // the pool is kept for the next batch.
+    std::vector<std::vector<uint8_t>> renderCharts(const std::vector<Chart*>& batch,
+                                                   RenderFormat format,
+                                                   size_t threadCount = 0);
 
 private:
-    std::vector<std::unique_ptr<Chart>> charts;
+    ExcelCore::HandleRegistry<Chart> charts;
+    std::function<void(Chart&)> chartChanged;
+    std::unique_ptr<ExcelCore::ThreadPool> renderPool;
+
+    static bool isValidRange(const CellAddress& startCell, const CellAddress& endCell);
+    static void patchChart(Chart& chart, const Worksheet& worksheet, const CellAddress& first, const CellAddress& last);
+    static std::vector<std::vector<double>> extractDataFromRange(const Worksheet& worksheet,
+                                                                 const CellAddress& startCell,
+                                                                 const CellAddress& endCell);
 };
 
-// TODO: Implement specific chart types (e.g., BarChart, LineChart, PieChart) derived from the Chart base class
 // TODO: Add support for more complex chart customization options (e.g., colors, fonts, legends)
 // TODO: Implement error handling for invalid chart data or rendering failures
-// TODO: Optimize chart rendering for large datasets
\ No newline at end of file
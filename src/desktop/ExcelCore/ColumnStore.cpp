@@ -0,0 +1,557 @@
+#include "ColumnStore.h"
+#include "DataStructures.h"
+#include "StringPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+namespace ExcelCore {
+
+namespace {
+constexpr uint8_t kEmptyTag = static_cast<uint8_t>(CellType::Empty);
+constexpr uint32_t kBitWords = ColumnChunk::kRows / 64;
+
+static_assert(ColumnChunk::kDenseBytes % sizeof(uint64_t) == 0, "Dense blocks hold whole 64-bit words");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "Boolean words are stored as plain 64-bit words");
+
+// Error slots keep their code in the numbers array; any error turns an
+// aggregate into that error, so the code never ends up in a sum
+bool holdsNumber(uint8_t type) {
+    return type == static_cast<uint8_t>(CellType::Number) || type == static_cast<uint8_t>(CellType::Date) ||
+           type == static_cast<uint8_t>(CellType::Error);
+}
+
+bool holdsString(uint8_t type) {
+    return type == static_cast<uint8_t>(CellType::String) || type == static_cast<uint8_t>(CellType::Error);
+}
+}
+
+size_t ColumnChunk::memoryUsage() const {
+    size_t bytes = sizeof(ColumnChunk) + entries.capacity() * sizeof(SparseEntry);
+    if (mode == Mode::Dense) {
+        bytes += kDenseBytes;
+    }
+    return bytes;
+}
+
+ColumnChunk::SparseEntry* ColumnChunk::findEntry(uint16_t row) {
+    auto it = std::lower_bound(entries.begin(), entries.end(), row,
+                               [](const SparseEntry& entry, uint16_t value) { return entry.row < value; });
+    return it != entries.end() && it->row == row ? &*it : nullptr;
+}
+
+const ColumnChunk::SparseEntry* ColumnChunk::findEntry(uint16_t row) const {
+    return const_cast<ColumnChunk*>(this)->findEntry(row);
+}
+
+void ColumnChunk::lockSlots() const {
+    while (slotLock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void ColumnChunk::unlockSlots() const {
+    slotLock.clear(std::memory_order_release);
+}
+
+// Writes a slot in place. Sparse chunks insert missing rows; callers that must
+// not allocate check for an existing slot first. Returns the string ID the slot
+// held before (0 if none), for the store to release.
+uint32_t ColumnChunk::write(uint16_t row, const SparseEntry& slot) {
+    lockSlots();
+    uint32_t previous = writeLocked(row, slot);
+    unlockSlots();
+    return previous;
+}
+
+ColumnChunk::SparseEntry ColumnChunk::read(uint16_t row) const {
+    lockSlots();
+    SparseEntry slot = readLocked(row);
+    unlockSlots();
+    return slot;
+}
+
+uint32_t ColumnChunk::writeLocked(uint16_t row, const SparseEntry& slot) {
+    writeCount.fetch_add(1, std::memory_order_release);
+    if (mode == Mode::Dense) {
+        uint32_t previous = holdsString(typeTags[row]) ? stringIds[row] : 0;
+        typeTags[row] = slot.type;
+        numberValues[row] = holdsNumber(slot.type) ? slot.number : 0.0;
+        stringIds[row] = holdsString(slot.type) ? slot.stringId : 0;
+        uint64_t mask = uint64_t(1) << (row % 64);
+        if (slot.type == static_cast<uint8_t>(CellType::Boolean) && slot.number != 0.0) {
+            booleanBits[row / 64].fetch_or(mask, std::memory_order_relaxed);
+        } else {
+            booleanBits[row / 64].fetch_and(~mask, std::memory_order_relaxed);
+        }
+        return previous;
+    }
+
+    // Leave entry->row untouched: concurrent readers binary-search on it
+    if (SparseEntry* entry = findEntry(row)) {
+        uint32_t previous = holdsString(entry->type) ? entry->stringId : 0;
+        entry->type = slot.type;
+        entry->stringId = slot.stringId;
+        entry->number = slot.number;
+        return previous;
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), row,
+                               [](const SparseEntry& entry, uint16_t value) { return entry.row < value; });
+    SparseEntry inserted = slot;
+    inserted.row = row;
+    entries.insert(it, inserted);
+    if (entries.size() > kDenseThreshold) {
+        makeDense();
+    }
+    return 0;
+}
+
+ColumnChunk::SparseEntry ColumnChunk::readLocked(uint16_t row) const {
+    if (mode == Mode::Dense) {
+        SparseEntry slot{row, typeTags[row], stringIds[row], numberValues[row]};
+        if (slot.type == static_cast<uint8_t>(CellType::Boolean)) {
+            slot.number = (booleanBits[row / 64].load(std::memory_order_relaxed) >> (row % 64)) & 1 ? 1.0 : 0.0;
+        }
+        return slot;
+    }
+    const SparseEntry* entry = findEntry(row);
+    return entry ? *entry : SparseEntry{row, kEmptyTag, 0, 0.0};
+}
+
+void ColumnChunk::makeDense() {
+    denseStorage.reset(new uint64_t[kDenseBytes / sizeof(uint64_t)]());
+    attachDense(denseStorage.get());
+    std::fill(typeTags, typeTags + kRows, kEmptyTag);
+
+    mode = Mode::Dense;
+    for (const SparseEntry& entry : entries) {
+        writeLocked(entry.row, entry);
+    }
+    entries.clear();
+    entries.shrink_to_fit();
+}
+
+// Points the dense arrays into a block laid out as described on the class
+void ColumnChunk::attachDense(void* block) {
+    uint8_t* bytes = static_cast<uint8_t*>(block);
+    numberValues = reinterpret_cast<double*>(bytes);
+    stringIds = reinterpret_cast<uint32_t*>(bytes + kRows * sizeof(double));
+    booleanBits = reinterpret_cast<std::atomic<uint64_t>*>(bytes + kRows * (sizeof(double) + sizeof(uint32_t)));
+    typeTags = bytes + kRows * (sizeof(double) + sizeof(uint32_t)) + kBitWords * sizeof(uint64_t);
+}
+
+ColumnStore::ColumnStore(std::shared_ptr<StringPool> strings) : strings(std::move(strings)) {}
+
+ColumnChunk* ColumnStore::findChunk(const CellAddress& address) const {
+    uint32_t chunkIndex = address.row / ColumnChunk::kRows;
+    if (address.column >= columns.size() || chunkIndex >= columns[address.column].size()) {
+        return nullptr;
+    }
+    return columns[address.column][chunkIndex].get();
+}
+
+// The only place storage grows, so addresses past the worksheet limits are
+// stopped here before they can size the column table
+ColumnChunk& ColumnStore::getOrCreateChunk(const CellAddress& address) {
+    if (address.row >= kMaxRows || address.column >= kMaxColumns) {
+        throw std::out_of_range("Cell address outside the worksheet: " + address.toString());
+    }
+    uint32_t chunkIndex = address.row / ColumnChunk::kRows;
+    if (address.column >= columns.size()) {
+        columns.resize(address.column + 1);
+    }
+    auto& column = columns[address.column];
+    if (chunkIndex >= column.size()) {
+        column.resize(chunkIndex + 1);
+    }
+    if (!column[chunkIndex]) {
+        column[chunkIndex] = std::make_unique<ColumnChunk>();
+        if (pinCounts.count(address.column) != 0) {
+            column[chunkIndex]->makeDense();
+        }
+    }
+    return *column[chunkIndex];
+}
+
+// Strings already in this store's pool keep their ID, and a result string
+// gains a reference for the slot about to hold it; strings from any other pool
+// are re-interned here. Every encoded value must end up in a slot.
+uint32_t ColumnStore::internText(const CellValue& value) const {
+    if (value.getStringPool() == strings.get() || value.getStringId() == 0) {
+        strings->retain(value.getStringId());
+        return value.getStringId();
+    }
+    return strings->intern(value.isError() ? value.getErrorMessage() : value.getString());
+}
+
+// Drops the reference of a slot that no longer holds the string
+void ColumnStore::releaseText(uint32_t stringId) const {
+    if (StringPool::isResult(stringId)) {
+        strings->release(stringId);
+    }
+}
+
+ColumnChunk::SparseEntry ColumnStore::encode(const CellValue& value) const {
+    ColumnChunk::SparseEntry slot{0, static_cast<uint8_t>(value.getType()), 0, 0.0};
+    switch (value.getType()) {
+        case CellType::Number:
+        case CellType::Boolean:
+            slot.number = value.getNumber();
+            break;
+        case CellType::Date:
+            slot.number = value.getDateSeconds();
+            break;
+        case CellType::String:
+            slot.stringId = internText(value);
+            break;
+        case CellType::Error:
+            slot.number = static_cast<double>(value.getErrorCode());
+            slot.stringId = internText(value);
+            break;
+        default:
+            break;
+    }
+    return slot;
+}
+
+CellValue ColumnStore::decode(const ColumnChunk::SparseEntry& slot) const {
+    switch (static_cast<CellType>(slot.type)) {
+        case CellType::Number:
+            return CellValue(slot.number);
+        case CellType::Boolean:
+            return CellValue(slot.number != 0.0);
+        case CellType::Date:
+            return CellValue::fromDateSeconds(slot.number);
+        case CellType::String:
+            return CellValue::fromStringId(*strings, slot.stringId);
+        case CellType::Error:
+            return CellValue::fromError(static_cast<ErrorCode>(slot.number), *strings, slot.stringId);
+        default:
+            return CellValue();
+    }
+}
+
+CellValue ColumnStore::get(const CellAddress& address) const {
+    const ColumnChunk* chunk = findChunk(address);
+    if (!chunk) {
+        return CellValue();
+    }
+    return decode(chunk->read(static_cast<uint16_t>(address.row % ColumnChunk::kRows)));
+}
+
+void ColumnStore::set(const CellAddress& address, const CellValue& value) {
+    uint16_t row = static_cast<uint16_t>(address.row % ColumnChunk::kRows);
+    if (value.getType() == CellType::Empty) {
+        ColumnChunk* chunk = findChunk(address);
+        if (!chunk) {
+            return;
+        }
+        uint32_t previous = 0;
+        if (chunk->mode == ColumnChunk::Mode::Dense) {
+            previous = chunk->write(row, ColumnChunk::SparseEntry{row, kEmptyTag, 0, 0.0});
+        } else {
+            chunk->lockSlots();
+            if (ColumnChunk::SparseEntry* entry = chunk->findEntry(row)) {
+                previous = holdsString(entry->type) ? entry->stringId : 0;
+                chunk->entries.erase(chunk->entries.begin() + (entry - chunk->entries.data()));
+                chunk->writeCount.fetch_add(1, std::memory_order_release);
+            }
+            chunk->unlockSlots();
+        }
+        releaseText(previous);
+        return;
+    }
+    ColumnChunk& chunk = getOrCreateChunk(address);
+    releaseText(chunk.write(row, encode(value)));
+}
+
+void ColumnStore::reserve(const CellAddress& address) {
+    uint16_t row = static_cast<uint16_t>(address.row % ColumnChunk::kRows);
+    ColumnChunk& chunk = getOrCreateChunk(address);
+    if (chunk.mode == ColumnChunk::Mode::Sparse && !chunk.findEntry(row)) {
+        chunk.write(row, ColumnChunk::SparseEntry{row, kEmptyTag, 0, 0.0});
+    }
+}
+
+bool ColumnStore::assign(const CellAddress& address, const CellValue& value) {
+    ColumnChunk* chunk = findChunk(address);
+    if (!chunk) {
+        return false;
+    }
+    uint16_t row = static_cast<uint16_t>(address.row % ColumnChunk::kRows);
+    if (chunk->mode == ColumnChunk::Mode::Sparse && !chunk->findEntry(row)) {
+        return false;
+    }
+    releaseText(chunk->write(row, encode(value)));
+    return true;
+}
+
+bool ColumnStore::contains(const CellAddress& address) const {
+    const ColumnChunk* chunk = findChunk(address);
+    return chunk && chunk->read(static_cast<uint16_t>(address.row % ColumnChunk::kRows)).type != kEmptyTag;
+}
+
+void ColumnStore::clear() {
+    if (isPinned()) {
+        throw std::logic_error("Cannot clear a column store while columns are pinned");
+    }
+    for (uint32_t column = 0; column < columns.size(); ++column) {
+        for (uint32_t chunkIndex = 0; chunkIndex < columns[column].size(); ++chunkIndex) {
+            const ColumnChunk* chunk = columns[column][chunkIndex].get();
+            if (!chunk) {
+                continue;
+            }
+            if (chunk->mode == ColumnChunk::Mode::Dense) {
+                for (uint32_t row = 0; row < ColumnChunk::kRows; ++row) {
+                    if (holdsString(chunk->typeTags[row])) {
+                        releaseText(chunk->stringIds[row]);
+                    }
+                }
+            } else {
+                for (const ColumnChunk::SparseEntry& entry : chunk->entries) {
+                    if (holdsString(entry.type)) {
+                        releaseText(entry.stringId);
+                    }
+                }
+            }
+        }
+    }
+    columns.clear();
+    blockOwners.clear();
+}
+
+void ColumnStore::pin(uint32_t column) {
+    for (uint32_t chunkIndex = 0; chunkIndex < getChunkCount(column); ++chunkIndex) {
+        ColumnChunk* chunk = columns[column][chunkIndex].get();
+        if (chunk && chunk->mode == ColumnChunk::Mode::Sparse) {
+            chunk->lockSlots();
+            chunk->makeDense();
+            chunk->unlockSlots();
+        }
+    }
+    ++pinCounts[column];
+}
+
+void ColumnStore::unpin(uint32_t column) {
+    auto it = pinCounts.find(column);
+    if (it != pinCounts.end() && --it->second == 0) {
+        pinCounts.erase(it);
+    }
+}
+
+uint64_t ColumnStore::getGeneration(uint32_t column) const {
+    uint64_t generation = 0;
+    for (uint32_t chunkIndex = 0; chunkIndex < getChunkCount(column); ++chunkIndex) {
+        if (const ColumnChunk* chunk = columns[column][chunkIndex].get()) {
+            generation += chunk->getWriteCount() + 1;
+        }
+    }
+    return generation;
+}
+
+void ColumnStore::forEachCell(const std::function<void(const CellAddress&, const CellValue&)>& visitor) const {
+    for (uint32_t column = 0; column < columns.size(); ++column) {
+        forEachCell(column, 0, std::numeric_limits<uint32_t>::max(), visitor);
+    }
+}
+
+void ColumnStore::forEachCell(uint32_t column, uint32_t firstRow, uint32_t lastRow,
+                              const std::function<void(const CellAddress&, const CellValue&)>& visitor) const {
+    uint32_t chunkCount = getChunkCount(column);
+    if (firstRow > lastRow || chunkCount == 0) {
+        return;
+    }
+    uint32_t lastChunk = std::min(lastRow / ColumnChunk::kRows, chunkCount - 1);
+
+    // Occupied slots are copied in small batches under the chunk's lock and
+    // visited after it is released, so visitors may read the store themselves
+    constexpr size_t kBatch = 128;
+    ColumnChunk::SparseEntry slots[kBatch];
+    for (uint32_t chunkIndex = firstRow / ColumnChunk::kRows; chunkIndex <= lastChunk; ++chunkIndex) {
+        const ColumnChunk* chunk = columns[column][chunkIndex].get();
+        if (!chunk) {
+            continue;
+        }
+        // Rows [begin, end) of this chunk that fall inside the range
+        uint32_t baseRow = chunkIndex * ColumnChunk::kRows;
+        uint32_t begin = std::max(firstRow, baseRow) - baseRow;
+        uint32_t end = std::min(lastRow - baseRow, ColumnChunk::kRows - 1) + 1;
+
+        for (uint32_t next = begin; next < end;) {
+            size_t count = 0;
+            chunk->lockSlots();
+            if (chunk->mode == ColumnChunk::Mode::Sparse) {
+                auto it = std::lower_bound(chunk->entries.begin(), chunk->entries.end(), next,
+                                           [](const ColumnChunk::SparseEntry& entry, uint32_t row) { return entry.row < row; });
+                next = end;
+                for (; it != chunk->entries.end() && it->row < end; ++it) {
+                    if (count == kBatch) {
+                        next = it->row;
+                        break;
+                    }
+                    if (it->type != kEmptyTag) {
+                        slots[count++] = *it;
+                    }
+                }
+            } else {
+                for (; next < end && count < kBatch; ++next) {
+                    if (chunk->typeTags[next] != kEmptyTag) {
+                        slots[count++] = chunk->readLocked(static_cast<uint16_t>(next));
+                    }
+                }
+            }
+            chunk->unlockSlots();
+
+            for (size_t i = 0; i < count; ++i) {
+                visitor(CellAddress(baseRow + slots[i].row, column), decode(slots[i]));
+            }
+        }
+    }
+}
+
+void ColumnStore::copyChunk(uint32_t column, uint32_t chunkIndex, void* denseBlock,
+                            std::vector<ColumnChunk::SparseEntry>& entries) const {
+    const ColumnChunk* chunk = getChunk(column, chunkIndex);
+    entries.clear();
+    if (!chunk) {
+        return;
+    }
+    chunk->lockSlots();
+    bool dense = chunk->mode == ColumnChunk::Mode::Dense;
+    if (dense) {
+        std::memcpy(denseBlock, chunk->numberValues, ColumnChunk::kDenseBytes);
+    } else {
+        entries = chunk->entries;
+    }
+    chunk->unlockSlots();
+
+    auto internResult = [&](uint32_t& stringId) {
+        if (StringPool::isResult(stringId)) {
+            stringId = strings->intern(strings->get(stringId));
+        }
+    };
+    if (dense) {
+        uint8_t* bytes = static_cast<uint8_t*>(denseBlock);
+        uint32_t* stringIds = reinterpret_cast<uint32_t*>(bytes + ColumnChunk::kRows * sizeof(double));
+        for (uint32_t row = 0; row < ColumnChunk::kRows; ++row) {
+            internResult(stringIds[row]);
+        }
+    } else {
+        for (ColumnChunk::SparseEntry& entry : entries) {
+            internResult(entry.stringId);
+        }
+    }
+}
+
+void ColumnStore::attachDenseChunk(uint32_t column, uint32_t chunkIndex, void* block, std::shared_ptr<void> owner) {
+    if (chunkIndex >= kMaxRows / ColumnChunk::kRows) {
+        throw std::out_of_range("Chunk index outside the worksheet");
+    }
+    ColumnChunk& chunk = getOrCreateChunk(CellAddress(chunkIndex * ColumnChunk::kRows, column));
+    chunk.entries.clear();
+    chunk.denseStorage.reset();
+    chunk.attachDense(block);
+    chunk.mode = ColumnChunk::Mode::Dense;
+    if (blockOwners.empty() || blockOwners.back() != owner) {
+        blockOwners.push_back(std::move(owner));
+    }
+}
+
+void ColumnStore::loadSparseChunk(uint32_t column, uint32_t chunkIndex, std::vector<ColumnChunk::SparseEntry> entries) {
+    if (chunkIndex >= kMaxRows / ColumnChunk::kRows) {
+        throw std::out_of_range("Chunk index outside the worksheet");
+    }
+    ColumnChunk& chunk = getOrCreateChunk(CellAddress(chunkIndex * ColumnChunk::kRows, column));
+    chunk.entries = std::move(entries);
+    if (chunk.entries.size() > ColumnChunk::kDenseThreshold) {
+        chunk.makeDense();
+    }
+}
+
+void ColumnStore::reserveColumns(uint32_t columnCount) {
+    if (columnCount > kMaxColumns) {
+        throw std::out_of_range("Column count exceeds the worksheet limit");
+    }
+    if (columnCount > columns.size()) {
+        columns.resize(columnCount);
+    }
+}
+
+void ColumnStore::loadColumn(uint32_t column, uint32_t firstRow, const CellValue* values, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        uint32_t row = firstRow + static_cast<uint32_t>(i);
+        size_t chunkEnd = std::min(count, i + (ColumnChunk::kRows - row % ColumnChunk::kRows));
+        size_t filled = static_cast<size_t>(std::count_if(values + i, values + chunkEnd, [](const CellValue& value) {
+            return value.getType() != CellType::Empty;
+        }));
+        if (filled == 0) {
+            i = chunkEnd;
+            continue;
+        }
+        ColumnChunk& chunk = getOrCreateChunk(CellAddress(row, column));
+        chunk.lockSlots();
+        // Chunks that end up dense are converted first and filled with plain
+        // stores, publishing the whole chunk with one write-count increment
+        if (chunk.mode == ColumnChunk::Mode::Sparse && chunk.entries.size() + filled > ColumnChunk::kDenseThreshold) {
+            chunk.makeDense();
+        }
+        if (chunk.mode == ColumnChunk::Mode::Dense) {
+            uint64_t setBits[kBitWords] = {};
+            uint64_t clearBits[kBitWords] = {};
+            for (; i < chunkEnd; ++i) {
+                if (values[i].getType() == CellType::Empty) {
+                    continue;
+                }
+                uint32_t slotRow = (firstRow + static_cast<uint32_t>(i)) % ColumnChunk::kRows;
+                ColumnChunk::SparseEntry slot = encode(values[i]);
+                if (holdsString(chunk.typeTags[slotRow])) {
+                    releaseText(chunk.stringIds[slotRow]);
+                }
+                chunk.typeTags[slotRow] = slot.type;
+                chunk.numberValues[slotRow] = holdsNumber(slot.type) ? slot.number : 0.0;
+                chunk.stringIds[slotRow] = holdsString(slot.type) ? slot.stringId : 0;
+                uint64_t mask = uint64_t(1) << (slotRow % 64);
+                clearBits[slotRow / 64] |= mask;
+                if (slot.type == static_cast<uint8_t>(CellType::Boolean) && slot.number != 0.0) {
+                    setBits[slotRow / 64] |= mask;
+                }
+            }
+            for (uint32_t word = 0; word < kBitWords; ++word) {
+                if (clearBits[word] != 0) {
+                    chunk.booleanBits[word].fetch_and(~clearBits[word], std::memory_order_relaxed);
+                    chunk.booleanBits[word].fetch_or(setBits[word], std::memory_order_relaxed);
+                }
+            }
+            chunk.writeCount.fetch_add(1, std::memory_order_release);
+        } else {
+            for (; i < chunkEnd; ++i) {
+                if (values[i].getType() != CellType::Empty) {
+                    releaseText(chunk.writeLocked(static_cast<uint16_t>((firstRow + i) % ColumnChunk::kRows), encode(values[i])));
+                }
+            }
+        }
+        chunk.unlockSlots();
+    }
+}
+
+size_t ColumnStore::memoryUsage() const {
+    size_t bytes = sizeof(ColumnStore);
+    for (const auto& column : columns) {
+        bytes += column.capacity() * sizeof(std::unique_ptr<ColumnChunk>);
+        for (const auto& chunk : column) {
+            if (chunk) {
+                bytes += chunk->memoryUsage();
+            }
+        }
+    }
+    return bytes;
+}
+
+} // namespace ExcelCore
+
+// TODO: Shrink dense chunks back to sparse when most of their cells are cleared
+// TODO: Release chunks (and trailing columns) that become completely empty
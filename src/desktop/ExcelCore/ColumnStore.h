@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ExcelCore {
+
+class CellAddress;
+class CellValue;
+class StringPool;
+
+// The cells of one column for a block of kRows consecutive rows. A chunk
+// starts sparse (a sorted list of occupied rows) and switches to dense typed
+// arrays once it fills up:
+//   numbers    - kRows contiguous doubles; 0.0 in slots that hold no number
+//                (error slots hold their ErrorCode), so aggregates can run
+//                over the array without branching
+//   types      - one CellType tag per row
+//   booleans   - one bit per row
+//   stringIds  - StringPool IDs for string and error slots
+// The dense arrays share one block of kDenseBytes, in the order numbers,
+// stringIds, booleans, types.
+class ColumnChunk {
+public:
+    static constexpr uint32_t kRows = 1024;
+    static constexpr uint32_t kDenseThreshold = 256;
+    static constexpr size_t kDenseBytes = kRows * (sizeof(double) + sizeof(uint32_t) + sizeof(uint8_t)) + kRows / 8;
+
+    enum class Mode : uint8_t {
+        Sparse,
+        Dense
+    };
+
+    struct SparseEntry {
+        uint16_t row;      // offset within the chunk
+        uint8_t type;      // CellType
+        uint32_t stringId;  // string text or error message
+        double number;     // numbers and dates; 1.0/0.0 for booleans; ErrorCode for errors
+    };
+
+    Mode getMode() const {
+        return mode;
+    }
+
+    // Dense mode only: kRows values / type tags
+    const double* numbers() const {
+        return numberValues;
+    }
+
+    const uint8_t* types() const {
+        return typeTags;
+    }
+
+    // Sparse mode only: occupied rows in ascending order
+    const std::vector<SparseEntry>& sparseEntries() const {
+        return entries;
+    }
+
+    // Number of writes into the chunk so far
+    uint64_t getWriteCount() const {
+        return writeCount.load(std::memory_order_acquire);
+    }
+
+    size_t memoryUsage() const;
+
+private:
+    friend class ColumnStore;
+
+    Mode mode = Mode::Sparse;
+    std::atomic<uint64_t> writeCount{0};
+    // Guards slot contents against readers outside the engine (host threads
+    // reading while workers store results). The aggregate kernels scan the
+    // arrays without it: they only cover cells finished earlier in dependency order.
+    mutable std::atomic_flag slotLock = ATOMIC_FLAG_INIT;
+    std::vector<SparseEntry> entries;
+    // Owned dense block; empty when the block is borrowed (see ColumnStore::attachDenseChunk)
+    std::unique_ptr<uint64_t[]> denseStorage;
+    double* numberValues = nullptr;
+    uint32_t* stringIds = nullptr;
+    // Atomic words so that concurrent writes to different rows of one chunk
+    // (parallel recalculation) cannot lose each other's bits
+    std::atomic<uint64_t>* booleanBits = nullptr;
+    uint8_t* typeTags = nullptr;
+
+    SparseEntry* findEntry(uint16_t row);
+    const SparseEntry* findEntry(uint16_t row) const;
+    uint32_t write(uint16_t row, const SparseEntry& slot);
+    SparseEntry read(uint16_t row) const;
+    uint32_t writeLocked(uint16_t row, const SparseEntry& slot);
+    SparseEntry readLocked(uint16_t row) const;
+    void makeDense();
+    void attachDense(void* block);
+    void lockSlots() const;
+    void unlockSlots() const;
+};
+
+// Column-major, chunked storage for all cell values of a worksheet. Replaces a
+// hash map of heap-allocated cells: a dense chunk of 1024 numbers is 8 KB of
+// contiguous doubles, and range scans walk chunks instead of hash nodes.
+class ColumnStore {
+public:
+    explicit ColumnStore(std::shared_ptr<StringPool> strings);
+
+    CellValue get(const CellAddress& address) const;
+
+    // Stores a value; an empty value frees the slot
+    void set(const CellAddress& address, const CellValue& value);
+
+    // Materializes an empty slot so later assign() calls need no allocation
+    void reserve(const CellAddress& address);
+
+    // Overwrites an existing slot and returns false if there is none. Never
+    // allocates, so it is safe to call concurrently for distinct cells.
+    bool assign(const CellAddress& address, const CellValue& value);
+
+    bool contains(const CellAddress& address) const;
+
+    // Frees every chunk; throws std::logic_error while a column is pinned
+    void clear();
+
+    // Pinning exposes a column's dense arrays to readers outside the engine.
+    // pin() makes every existing chunk of the column dense, and chunks the
+    // column gains while pinned are dense from the start; dense storage is
+    // never moved or freed, so the arrays stay valid until unpin(). Values are
+    // still updated in place: readers compare getGeneration() before and after
+    // a scan to detect concurrent writes.
+    void pin(uint32_t column);
+    void unpin(uint32_t column);
+
+    bool isPinned() const {
+        return !pinCounts.empty();
+    }
+
+    // Changes whenever a cell of the column is written or a chunk is added
+    uint64_t getGeneration(uint32_t column) const;
+
+    uint32_t getColumnCount() const {
+        return static_cast<uint32_t>(columns.size());
+    }
+
+    uint32_t getChunkCount(uint32_t column) const {
+        return column < columns.size() ? static_cast<uint32_t>(columns[column].size()) : 0;
+    }
+
+    // Returns nullptr for chunks that hold no cells
+    const ColumnChunk* getChunk(uint32_t column, uint32_t chunkIndex) const {
+        if (column >= columns.size() || chunkIndex >= columns[column].size()) {
+            return nullptr;
+        }
+        return columns[column][chunkIndex].get();
+    }
+
+    StringPool& getStringPool() const {
+        return *strings;
+    }
+
+    const std::shared_ptr<StringPool>& getSharedStringPool() const {
+        return strings;
+    }
+
+    // Visits every non-empty cell, column by column
+    void forEachCell(const std::function<void(const CellAddress&, const CellValue&)>& visitor) const;
+
+    // Visits the non-empty cells in rows [firstRow, lastRow] of one column
+    void forEachCell(uint32_t column, uint32_t firstRow, uint32_t lastRow,
+                     const std::function<void(const CellAddress&, const CellValue&)>& visitor) const;
+
+    size_t memoryUsage() const;
+
+    // Bulk loading (imports). reserveColumns makes room for columnCount columns
+    // up front; after that loadColumn may run concurrently for distinct columns.
+    // loadColumn writes values to rows [firstRow, firstRow + count) of one
+    // column and skips empty values instead of clearing their cells.
+    void reserveColumns(uint32_t columnCount);
+    void loadColumn(uint32_t column, uint32_t firstRow, const CellValue* values, size_t count);
+
+    // Snapshot support. copyChunk copies a chunk under its lock: a dense chunk
+    // as its kDenseBytes block, a sparse one as its entries. Result strings are
+    // interned in the copy, as the snapshot keeps only interned strings.
+    void copyChunk(uint32_t column, uint32_t chunkIndex, void* denseBlock,
+                   std::vector<ColumnChunk::SparseEntry>& entries) const;
+
+    // Installs a dense chunk that uses an external block in place (e.g. in a
+    // copy-on-write file mapping); owner keeps the block alive for the store's lifetime
+    void attachDenseChunk(uint32_t column, uint32_t chunkIndex, void* block, std::shared_ptr<void> owner);
+
+    // Installs a sparse chunk; entries must be sorted by row
+    void loadSparseChunk(uint32_t column, uint32_t chunkIndex, std::vector<ColumnChunk::SparseEntry> entries);
+
+private:
+    std::shared_ptr<StringPool> strings;
+    // External memory used by attached chunks; declared before columns so it outlives them
+    std::vector<std::shared_ptr<void>> blockOwners;
+    std::vector<std::vector<std::unique_ptr<ColumnChunk>>> columns;
+    // Pins per pinned column
+    std::unordered_map<uint32_t, uint32_t> pinCounts;
+
+    ColumnChunk* findChunk(const CellAddress& address) const;
+    ColumnChunk& getOrCreateChunk(const CellAddress& address);
+    uint32_t internText(const CellValue& value) const;
+    void releaseText(uint32_t stringId) const;
+    ColumnChunk::SparseEntry encode(const CellValue& value) const;
+    CellValue decode(const ColumnChunk::SparseEntry& slot) const;
+};
+
+} // namespace ExcelCore
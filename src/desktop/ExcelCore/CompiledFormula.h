@@ -0,0 +1,130 @@
+#pragma once
+
+#include "DataStructures.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ExcelCore {
+
+// Operations of the formula bytecode. Operands of the push instructions index
+// into the constant pools of the owning CompiledFormula.
+enum class OpCode : uint8_t {
+    PushNumber,
+    PushString,
+    PushBoolean,
+    PushCell,
+    PushRange,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Power,
+    CallFunction,
+    // Added after CallFunction so stored programs keep their numbering
+    Negate,
+    Percent,
+    Concatenate,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    PushError      // operand is the ErrorCode itself
+};
+
+// A reference stored relative to the formula's own cell (R1C1 style), so the
+// same program serves every cell of a filled-down range. Absolute ($) parts
+// hold the zero-based row/column itself. A reference landing outside the
+// worksheet does not resolve (#REF!).
+struct FormulaReference {
+    int32_t row = 0;
+    int32_t column = 0;
+    bool rowAbsolute = false;
+    bool columnAbsolute = false;
+
+    bool resolve(const CellAddress& origin, CellAddress& resolved) const {
+        int64_t targetRow = rowAbsolute ? row : static_cast<int64_t>(origin.row) + row;
+        int64_t targetColumn = columnAbsolute ? column : static_cast<int64_t>(origin.column) + column;
+        if (targetRow < 0 || targetColumn < 0 || targetRow >= kMaxRows || targetColumn >= kMaxColumns) {
+            return false;
+        }
+        resolved = CellAddress(static_cast<uint32_t>(targetRow), static_cast<uint32_t>(targetColumn));
+        return true;
+    }
+};
+
+// A rectangular range reference (A1:B10), or a whole-column (A:C) or
+// whole-row (1:3) reference whose open side spans the worksheet
+struct FormulaRange {
+    enum class Kind : uint8_t {
+        Cells,
+        Columns,
+        Rows
+    };
+
+    FormulaReference first;
+    FormulaReference last;
+    Kind kind = Kind::Cells;
+
+    // Resolves both corners and orders them, so B10:A1 covers the same cells as A1:B10
+    bool resolve(const CellAddress& origin, CellAddress& resolvedFirst, CellAddress& resolvedLast) const {
+        CellAddress a;
+        CellAddress b;
+        if (!first.resolve(origin, a) || !last.resolve(origin, b)) {
+            return false;
+        }
+        resolvedFirst = CellAddress(std::min(a.row, b.row), std::min(a.column, b.column));
+        resolvedLast = CellAddress(std::max(a.row, b.row), std::max(a.column, b.column));
+        if (kind == Kind::Columns) {
+            resolvedFirst.row = 0;
+            resolvedLast.row = kMaxRows - 1;
+        } else if (kind == Kind::Rows) {
+            resolvedFirst.column = 0;
+            resolvedLast.column = kMaxColumns - 1;
+        }
+        return true;
+    }
+};
+
+// A single 8-byte instruction
+struct Instruction {
+    OpCode opcode;
+    uint16_t argumentCount; // CallFunction only
+    uint32_t operand;       // constant, reference or function index
+};
+
+// A formula compiled once into postfix bytecode. Cell references are resolved
+// to relative offsets and function names to indices into the parser's function
+// table at compile time, so evaluation does no string handling at all.
+// Programs are immutable and shared by every cell with the same R1C1 template.
+struct CompiledFormula {
+    std::vector<Instruction> code;
+    std::vector<double> numbers;
+    std::vector<CellValue> strings;     // interned in the workbook's string pool
+    std::vector<FormulaReference> references;
+    std::vector<FormulaRange> ranges;
+    uint32_t maxStackDepth = 0;
+
+    // Source tokens with cell and range references left empty; tokenReferences
+    // and tokenRanges hold the index into references / ranges for those slots
+    // and -1 elsewhere. Used to render the A1 text for any cell sharing the program.
+    std::vector<std::string> tokens;
+    std::vector<int32_t> tokenReferences;
+    std::vector<int32_t> tokenRanges;
+
+    // Set when the formula could not be compiled; evaluation yields this error.
+    // Such programs are not interned, so each failing cell keeps its own.
+    std::string errorMessage;
+
+    bool isValid() const {
+        return errorMessage.empty();
+    }
+
+    // Rebuilds the A1-style formula text as seen from the given cell
+    std::string render(const CellAddress& origin) const;
+};
+
+} // namespace ExcelCore
@@ -0,0 +1,644 @@
+#include "CsvReader.h"
+#include "AggregateKernels.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define EXCELCORE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define EXCELCORE_TARGET_SSE2
+#else
+#define EXCELCORE_TARGET_SSE2 __attribute__((target("sse2")))
+#endif
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace ExcelCore {
+
+namespace {
+
+constexpr double kSecondsPerDay = 86400.0;
+constexpr size_t kBlockBytes = 16;
+// Per-part cache of interned text; columns of unique values stop adding to it here
+constexpr size_t kMaxCachedStrings = 1 << 16;
+
+enum class ColumnType : uint8_t {
+    General,
+    Number,
+    Boolean,
+    Date,
+    Text
+};
+
+// What a sampled field looks like; one bit each in a column's inference mask
+enum FieldKind : uint8_t {
+    kNumberField = 1,
+    kPaddedNumberField = 2,  // "007": an identifier rather than a number
+    kBooleanField = 4,
+    kDateField = 8,
+    kTextField = 16
+};
+
+inline size_t popCount(uint32_t bits) {
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    return static_cast<size_t>((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+
+inline unsigned countTrailingZeros(uint32_t bits) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+}
+
+// Bit i is set when block[i] is one of the four target characters
+
+uint32_t matchScalar(const char* block, size_t length, const char (&targets)[4]) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < length; ++i) {
+        char character = block[i];
+        if (character == targets[0] || character == targets[1] || character == targets[2] || character == targets[3]) {
+            mask |= uint32_t(1) << i;
+        }
+    }
+    return mask;
+}
+
+size_t countQuotesScalar(const char* begin, const char* end, char quote) {
+    return static_cast<size_t>(std::count(begin, end, quote));
+}
+
+#ifdef EXCELCORE_X86
+
+EXCELCORE_TARGET_SSE2 uint32_t matchSse2(const char* block, const char (&targets)[4]) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(targets[0])),
+                                             _mm_cmpeq_epi8(bytes, _mm_set1_epi8(targets[1]))),
+                                _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(targets[2])),
+                                             _mm_cmpeq_epi8(bytes, _mm_set1_epi8(targets[3]))));
+    return static_cast<uint32_t>(_mm_movemask_epi8(hits));
+}
+
+EXCELCORE_TARGET_SSE2 size_t countQuotesSse2(const char* begin, const char* end, char quote) {
+    __m128i quotes = _mm_set1_epi8(quote);
+    size_t count = 0;
+    const char* position = begin;
+    for (; end - position >= static_cast<ptrdiff_t>(kBlockBytes); position += kBlockBytes) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position));
+        count += popCount(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quotes))));
+    }
+    return count + countQuotesScalar(position, end, quote);
+}
+
+#endif
+
+bool useVectorScan() {
+#ifdef EXCELCORE_X86
+    return Aggregates::getInstructionSet() != InstructionSet::Scalar;
+#else
+    return false;
+#endif
+}
+
+size_t countQuotes(const char* begin, const char* end, char quote, bool vectorized) {
+#ifdef EXCELCORE_X86
+    if (vectorized) {
+        return countQuotesSse2(begin, end, quote);
+    }
+#endif
+    return countQuotesScalar(begin, end, quote);
+}
+
+// Yields the positions of the delimiter, quote, CR and LF characters in
+// [begin, end) in order. Each 16-byte block is matched once; its mask is then
+// consumed a bit at a time.
+class SpecialScanner {
+public:
+    SpecialScanner(const char* begin, const char* end, const CsvOptions& options, bool vectorized)
+        : block(begin), end(end), vectorized(vectorized), targets{options.delimiter, options.quote, '\r', '\n'} {
+        load();
+    }
+
+    // Returns end when no special character is left
+    const char* next() {
+        while (mask == 0) {
+            if (end - block <= static_cast<ptrdiff_t>(kBlockBytes)) {
+                return end;
+            }
+            block += kBlockBytes;
+            load();
+        }
+        const char* position = block + countTrailingZeros(mask);
+        mask &= mask - 1;
+        return position;
+    }
+
+private:
+    const char* block;
+    const char* end;
+    bool vectorized;
+    char targets[4];
+    uint32_t mask = 0;
+
+    void load() {
+        size_t available = static_cast<size_t>(end - block);
+#ifdef EXCELCORE_X86
+        if (vectorized && available >= kBlockBytes) {
+            mask = matchSse2(block, targets);
+            return;
+        }
+#endif
+        mask = matchScalar(block, std::min(available, kBlockBytes), targets);
+    }
+};
+
+// Field text without its quotes; "" inside quotes stands for one quote.
+// stable tells whether the result points into the input rather than scratch.
+std::string_view unquote(const char* begin, const char* end, char quote, std::string& scratch, bool& stable) {
+    // Common case: the whole field is quoted and holds no quotes of its own
+    if (end - begin >= 2 && *begin == quote && end[-1] == quote && std::find(begin + 1, end - 1, quote) == end - 1) {
+        stable = true;
+        return std::string_view(begin + 1, static_cast<size_t>(end - begin - 2));
+    }
+    scratch.clear();
+    bool inQuotes = false;
+    for (const char* position = begin; position < end; ++position) {
+        if (*position != quote) {
+            scratch += *position;
+        } else if (inQuotes && position + 1 < end && position[1] == quote) {
+            scratch += quote;
+            ++position;
+        } else {
+            inQuotes = !inQuotes;
+        }
+    }
+    stable = false;
+    return scratch;
+}
+
+// Splits [begin, end) into records. onField(column, text, stable) receives
+// every field, where stable means text points into the input; onRecord() runs
+// after each record and returns false to stop. A quote toggles quoting
+// wherever it appears, which matches the parity pass that places part
+// boundaries. Returns where parsing stopped.
+template <typename FieldHandler, typename RecordHandler>
+const char* parseRecords(const char* begin, const char* end, const CsvOptions& options, bool vectorized,
+                         std::string& scratch, FieldHandler&& onField, RecordHandler&& onRecord) {
+    SpecialScanner scanner(begin, end, options, vectorized);
+    const char* fieldStart = begin;
+    uint32_t column = 0;
+    bool inQuotes = false;
+    bool quoted = false;
+    auto emit = [&](const char* fieldEnd) {
+        bool stable = true;
+        std::string_view text = quoted ? unquote(fieldStart, fieldEnd, options.quote, scratch, stable)
+                                       : std::string_view(fieldStart, static_cast<size_t>(fieldEnd - fieldStart));
+        onField(column, text, stable);
+        quoted = false;
+    };
+
+    for (;;) {
+        const char* position = scanner.next();
+        if (position == end) {
+            break;
+        }
+        char character = *position;
+        if (character == options.quote) {
+            inQuotes = !inQuotes;
+            quoted = true;
+            continue;
+        }
+        if (inQuotes) {
+            continue;
+        }
+        if (character == options.delimiter) {
+            emit(position);
+            ++column;
+            fieldStart = position + 1;
+            continue;
+        }
+        // CR, LF or CRLF ends the record
+        emit(position);
+        if (character == '\r' && position + 1 < end && position[1] == '\n') {
+            position = scanner.next();
+        }
+        fieldStart = position + 1;
+        column = 0;
+        if (!onRecord()) {
+            return fieldStart;
+        }
+    }
+    // A last record without a line break
+    if (fieldStart < end || column > 0) {
+        emit(end);
+        onRecord();
+    }
+    return end;
+}
+
+std::string_view trimSpaces(std::string_view text) {
+    size_t first = text.find_first_not_of(' ');
+    if (first == std::string_view::npos) {
+        return std::string_view();
+    }
+    return text.substr(first, text.find_last_not_of(' ') - first + 1);
+}
+
+// Decimal numbers with an optional sign and exponent; "inf" and "nan" stay text
+bool parseNumber(std::string_view text, double& value) {
+    text = trimSpaces(text);
+    if (text.size() > 1 && text[0] == '+' && text[1] != '-') {
+        text.remove_prefix(1);
+    }
+    if (text.empty()) {
+        return false;
+    }
+    char first = text[0] == '-' && text.size() > 1 ? text[1] : text[0];
+    if ((first < '0' || first > '9') && first != '.') {
+        return false;
+    }
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// An integer written with leading zeros ("007", "-01")
+bool isPaddedNumber(std::string_view text) {
+    text = trimSpaces(text);
+    if (!text.empty() && text[0] == '-') {
+        text.remove_prefix(1);
+    }
+    return text.size() > 1 && text[0] == '0' && text[1] >= '0' && text[1] <= '9';
+}
+
+bool equalsIgnoreCase(std::string_view text, std::string_view upper) {
+    if (text.size() != upper.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < text.size(); ++i) {
+        char character = text[i] >= 'a' && text[i] <= 'z' ? static_cast<char>(text[i] - 'a' + 'A') : text[i];
+        if (character != upper[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parseBoolean(std::string_view text, bool& value) {
+    text = trimSpaces(text);
+    if (equalsIgnoreCase(text, "TRUE")) {
+        value = true;
+        return true;
+    }
+    if (equalsIgnoreCase(text, "FALSE")) {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseDigits(std::string_view text, size_t offset, size_t count, int& value) {
+    if (offset + count > text.size()) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = offset; i < offset + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// "2024-03-01", optionally followed by "T12:30", "T12:30:45.5" (or a space
+// instead of the T) and a "Z"; returns seconds since 1970
+bool parseDate(std::string_view text, double& seconds) {
+    text = trimSpaces(text);
+    int year, month, day, hour = 0, minute = 0;
+    double second = 0.0;
+    if (text.size() < 10 || text[4] != '-' || text[7] != '-' || !parseDigits(text, 0, 4, year) ||
+        !parseDigits(text, 5, 2, month) || !parseDigits(text, 8, 2, day) || month < 1 || month > 12 || day < 1 ||
+        day > 31) {
+        return false;
+    }
+    std::string_view time = text.substr(10);
+    if (!time.empty() && time.back() == 'Z') {
+        time.remove_suffix(1);
+    }
+    if (!time.empty()) {
+        if (time.size() < 6 || (time[0] != 'T' && time[0] != ' ') || time[3] != ':' ||
+            !parseDigits(time, 1, 2, hour) || !parseDigits(time, 4, 2, minute) || hour > 23 || minute > 59) {
+            return false;
+        }
+        if (time.size() > 6) {
+            std::string_view secondText = time.substr(7);
+            auto result = std::from_chars(secondText.data(), secondText.data() + secondText.size(), second);
+            if (time[6] != ':' || secondText.empty() || secondText[0] < '0' || secondText[0] > '9' ||
+                result.ec != std::errc() || result.ptr != secondText.data() + secondText.size() || second >= 60.0) {
+                return false;
+            }
+        }
+    }
+    seconds = static_cast<double>(daysFromCivil(year, month, day)) * kSecondsPerDay + hour * 3600.0 + minute * 60.0 +
+              second;
+    return true;
+}
+
+uint8_t classifyField(std::string_view text) {
+    double number;
+    bool boolean;
+    if (parseNumber(text, number)) {
+        return isPaddedNumber(text) ? kPaddedNumberField : kNumberField;
+    }
+    if (parseBoolean(text, boolean)) {
+        return kBooleanField;
+    }
+    if (parseDate(text, number)) {
+        return kDateField;
+    }
+    // Error literals ("#N/A") say nothing about the column
+    return !text.empty() && text[0] == '#' && parseErrorCode(std::string(text)) != ErrorCode::None ? 0 : kTextField;
+}
+
+ColumnType inferColumnType(uint8_t kinds) {
+    if (kinds & kPaddedNumberField) {
+        return ColumnType::Text;
+    }
+    switch (kinds) {
+        case kNumberField:
+            return ColumnType::Number;
+        case kBooleanField:
+            return ColumnType::Boolean;
+        case kDateField:
+            return ColumnType::Date;
+        case kTextField:
+            return ColumnType::Text;
+        default:
+            return ColumnType::General;
+    }
+}
+
+// Interns field text into the workbook's pool, remembering the IDs of text
+// seen in this part so repeated values skip the pool's lock
+class StringCache {
+public:
+    explicit StringCache(StringPool& pool) : pool(pool) {}
+
+    CellValue get(std::string_view text, bool stable) {
+        if (!stable || ids.size() >= kMaxCachedStrings) {
+            auto it = ids.find(text);
+            return CellValue::fromStringId(pool, it != ids.end() ? it->second : pool.intern(text));
+        }
+        auto inserted = ids.try_emplace(text, 0);
+        if (inserted.second) {
+            inserted.first->second = pool.intern(text);
+        }
+        return CellValue::fromStringId(pool, inserted.first->second);
+    }
+
+private:
+    StringPool& pool;
+    // Keys point into the input, which outlives the cache
+    std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+// stable tells whether text points into the input (see parseRecords)
+CellValue convertField(std::string_view text, bool stable, ColumnType type, StringCache& strings) {
+    if (text.empty()) {
+        return CellValue();
+    }
+    double number;
+    bool boolean;
+    switch (type) {
+        case ColumnType::Text:
+            return strings.get(text, stable);
+        case ColumnType::Boolean:
+            if (parseBoolean(text, boolean)) {
+                return CellValue(boolean);
+            }
+            break;
+        case ColumnType::Date:
+            if (parseDate(text, number)) {
+                return CellValue::fromDateSeconds(number);
+            }
+            break;
+        default:
+            break;
+    }
+    // Number columns, and fields that do not fit their column's type
+    if (parseNumber(text, number)) {
+        return CellValue(number);
+    }
+    if (type != ColumnType::Number && type != ColumnType::Boolean && parseBoolean(text, boolean)) {
+        return CellValue(boolean);
+    }
+    if (type != ColumnType::Number && type != ColumnType::Date && parseDate(text, number)) {
+        return CellValue::fromDateSeconds(number);
+    }
+    if (text[0] == '#') {
+        ErrorCode code = parseErrorCode(std::string(text));
+        if (code != ErrorCode::None) {
+            return CellValue::error(code);
+        }
+    }
+    return strings.get(text, stable);
+}
+
+// One slice of the input, parsed into per-column values
+struct CsvPart {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    uint32_t rowOffset = 0;
+    uint32_t rowCount = 0;
+    // columns[c][r] is row r of the part; shorter columns end in empty cells
+    std::vector<std::vector<CellValue>> columns;
+    std::exception_ptr error;
+};
+
+// expectedRows sizes the column vectors up front
+void parsePart(CsvPart& part, const CsvOptions& options, bool vectorized, const std::vector<ColumnType>& columnTypes,
+               size_t expectedRows, StringPool& pool) {
+    StringCache strings(pool);
+    std::string scratch;
+    parseRecords(
+        part.begin, part.end, options, vectorized, scratch,
+        [&](uint32_t column, std::string_view text, bool stable) {
+            if (text.empty()) {
+                return;
+            }
+            if (column >= kMaxColumns) {
+                throw std::runtime_error("CSV row has more columns than a worksheet holds");
+            }
+            while (column >= part.columns.size()) {
+                part.columns.emplace_back();
+                part.columns.back().reserve(expectedRows);
+            }
+            ColumnType type = column < columnTypes.size() ? columnTypes[column] : ColumnType::General;
+            std::vector<CellValue>& values = part.columns[column];
+            values.resize(part.rowCount);
+            values.push_back(convertField(text, stable, type, strings));
+        },
+        [&]() {
+            ++part.rowCount;
+            return true;
+        });
+}
+
+} // namespace
+
+CsvReader::CsvReader(const CsvOptions& options) : options(options) {}
+
+size_t CsvReader::readFile(const std::string& path, Worksheet& worksheet) {
+    std::error_code error;
+    if (std::filesystem::file_size(path, error) == 0 && !error) {
+        return 0;
+    }
+    MappedFile file(path);
+    return read(std::string_view(reinterpret_cast<const char*>(file.data()), file.size()), worksheet);
+}
+
+size_t CsvReader::read(std::string_view text, Worksheet& worksheet) {
+    if (text.size() >= 3 && text.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        text.remove_prefix(3);
+    }
+    if (text.empty()) {
+        return 0;
+    }
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    bool vectorized = useVectorScan();
+    size_t threadCount = options.threadCount != 0 ? options.threadCount : ThreadPool::defaultThreadCount();
+    size_t partCount = std::max<size_t>(1, std::min(threadCount, text.size() / kMinPartBytes));
+    std::unique_ptr<ThreadPool> pool;
+    if (partCount > 1) {
+        pool = std::make_unique<ThreadPool>(partCount);
+    }
+    // Runs task(i) for i in [0, count), on the pool when there is one
+    auto forEach = [&](size_t count, const std::function<void(size_t)>& task) {
+        if (!pool) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
+            }
+            return;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            pool->submit([&task, i]() { task(i); });
+        }
+        pool->waitIdle();
+    };
+
+    // Part boundaries: split evenly, then move each split to just after the
+    // first line break outside quotes, using the quote parity up to the split
+    std::vector<const char*> boundaries(partCount + 1, end);
+    boundaries[0] = begin;
+    if (partCount > 1) {
+        std::vector<size_t> quoteCounts(partCount);
+        size_t slice = text.size() / partCount;
+        forEach(partCount, [&](size_t i) {
+            const char* sliceEnd = i + 1 == partCount ? end : begin + (i + 1) * slice;
+            quoteCounts[i] = countQuotes(begin + i * slice, sliceEnd, options.quote, vectorized);
+        });
+        size_t quotesBefore = 0;
+        for (size_t i = 1; i < partCount; ++i) {
+            quotesBefore += quoteCounts[i - 1];
+            bool inQuotes = quotesBefore % 2 != 0;
+            const char* position = begin + i * slice;
+            for (; position < end; ++position) {
+                if (*position == options.quote) {
+                    inQuotes = !inQuotes;
+                } else if (*position == '\n' && !inQuotes) {
+                    ++position;
+                    break;
+                }
+            }
+            boundaries[i] = std::max(position, boundaries[i - 1]);
+        }
+    }
+
+    // Column types from a sample of the rows after the first (usually a header)
+    std::vector<uint8_t> kinds;
+    const char* sampleEnd = begin;
+    size_t sampleRecords = 0;
+    {
+        std::string scratch;
+        size_t record = 0;
+        sampleEnd = parseRecords(
+            begin, end, options, vectorized, scratch,
+            [&](uint32_t column, std::string_view field, bool) {
+                if (record == 0 || field.empty() || column >= kMaxColumns) {
+                    return;
+                }
+                if (column >= kinds.size()) {
+                    kinds.resize(column + 1, 0);
+                }
+                kinds[column] |= classifyField(field);
+            },
+            [&]() { return ++record <= kSampleRows; });
+        sampleRecords = record;
+    }
+    std::vector<ColumnType> columnTypes(kinds.size());
+    std::transform(kinds.begin(), kinds.end(), columnTypes.begin(), inferColumnType);
+
+    std::vector<CsvPart> parts(partCount);
+    for (size_t i = 0; i < partCount; ++i) {
+        parts[i].begin = boundaries[i];
+        parts[i].end = boundaries[i + 1];
+    }
+    double bytesPerRecord =
+        std::max(1.0, static_cast<double>(sampleEnd - begin) / static_cast<double>(std::max<size_t>(sampleRecords, 1)));
+    StringPool& strings = worksheet.values.getStringPool();
+    forEach(partCount, [&](size_t i) {
+        try {
+            // Sized from the sample, with some slack for longer records later on
+            double expectedRows = static_cast<double>(parts[i].end - parts[i].begin) / bytesPerRecord * 1.1 + 16;
+            parsePart(parts[i], options, vectorized, columnTypes,
+                      static_cast<size_t>(std::min(expectedRows, static_cast<double>(kMaxRows))), strings);
+        } catch (...) {
+            parts[i].error = std::current_exception();
+        }
+    });
+
+    size_t rowCount = 0;
+    size_t columnCount = 0;
+    for (CsvPart& part : parts) {
+        if (part.error) {
+            std::rethrow_exception(part.error);
+        }
+        part.rowOffset = static_cast<uint32_t>(std::min<size_t>(rowCount, kMaxRows));
+        rowCount += part.rowCount;
+        columnCount = std::max(columnCount, part.columns.size());
+    }
+    if (rowCount > kMaxRows) {
+        throw std::runtime_error("CSV has more rows than a worksheet holds");
+    }
+
+    // Columns are written in parallel; each task owns one column of the store
+    worksheet.values.reserveColumns(static_cast<uint32_t>(columnCount));
+    forEach(columnCount, [&](size_t column) {
+        for (CsvPart& part : parts) {
+            if (column < part.columns.size()) {
+                std::vector<CellValue>& values = part.columns[column];
+                worksheet.values.loadColumn(static_cast<uint32_t>(column), part.rowOffset, values.data(), values.size());
+                std::vector<CellValue>().swap(values);
+            }
+        }
+    });
+    return rowCount;
+}
+
+} // namespace ExcelCore
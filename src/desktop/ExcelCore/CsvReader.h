@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "DataStructures.h"
+
+namespace ExcelCore {
+
+struct CsvOptions {
+    char delimiter = ',';    // '\t' for TSV
+    char quote = '"';
+    size_t threadCount = 0;  // 0 = ThreadPool::defaultThreadCount()
+};
+
+// Imports delimited text into a worksheet, starting at A1.
+//
+// The input is split into parts that are parsed in parallel. Part boundaries
+// are moved to the next line break outside quotes, found from a quote-parity
+// pass over the whole input, so quoted fields may span lines. Fields are found
+// with a vectorized scan for the delimiter, quote and line-break characters.
+//
+// Column types are inferred from the first kSampleRows rows after the header
+// row: a column whose sample holds only numbers, dates or booleans is parsed as
+// such, a column with only text (or with zero-padded numbers such as "007")
+// stays text throughout, and mixed columns are typed per cell. Numbers use
+// std::from_chars; dates are ISO 8601 ("2024-03-01", "2024-03-01 12:30:00").
+class CsvReader {
+public:
+    static constexpr size_t kSampleRows = 1000;
+    // Inputs are split into parts of at least this size
+    static constexpr size_t kMinPartBytes = 1 << 20;
+
+    explicit CsvReader(const CsvOptions& options = CsvOptions());
+
+    // Both return the number of rows read. Empty fields leave their cells as
+    // they are, so the worksheet is normally a new one.
+    size_t readFile(const std::string& path, Worksheet& worksheet);
+    size_t read(std::string_view text, Worksheet& worksheet);
+
+private:
+    CsvOptions options;
+};
+
+} // namespace ExcelCore
+
+// TODO: Detect the delimiter (comma, semicolon, tab) from the first lines
+// TODO: Accept locale-specific number and date formats (decimal comma, "03/01/2024")
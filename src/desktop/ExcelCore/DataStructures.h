@@ -6,47 +6,407 @@
 #include <unordered_map>
 #include <chrono>
 #include <variant>
+#include <stdexcept>
+#include <cctype>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include "ColumnStore.h"
+#include "StringPool.h"
 
 namespace ExcelCore {
 
+struct CompiledFormula;
+
+// Worksheet limits (same as Excel); whole-column and whole-row references span them
+constexpr uint32_t kMaxRows = 1048576;
+constexpr uint32_t kMaxColumns = 16384;
+
 // Represents the address of a cell in a worksheet
 class CellAddress {
 public:
-    uint32_t row;
-    uint32_t column;
+    uint32_t row = 0;
+    uint32_t column = 0;
+
+    CellAddress() = default;
+    CellAddress(uint32_t row, uint32_t column) : row(row), column(column) {}
 
     std::string toString() const {
-        // TODO: Implement conversion of column number to letter(s) and combine with row number
-        return ""; // Placeholder
+        // Convert the zero-based column number to letters (0 -> A, 25 -> Z, 26 -> AA)
+        std::string letters;
+        uint32_t col = column + 1;
+        while (col > 0) {
+            uint32_t remainder = (col - 1) % 26;
+            letters.insert(letters.begin(), static_cast<char>('A' + remainder));
+            col = (col - 1) / 26;
+        }
+        return letters + std::to_string(row + 1);
+    }
+
+    // Parses an A1-style address (e.g. "B12", "$B$12") into a zero-based
+    // CellAddress; addresses outside A1:XFD1048576 are rejected
+    static CellAddress fromString(const std::string& address) {
+        uint32_t col = 0;
+        uint32_t rowNumber = 0;
+        size_t i = 0;
+        if (i < address.size() && address[i] == '$') ++i;
+        size_t letterStart = i;
+        while (i < address.size() && std::isalpha(static_cast<unsigned char>(address[i]))) {
+            // Three letters at most, so the accumulation cannot overflow
+            if (i - letterStart == 3) {
+                throw std::invalid_argument("Invalid cell address: " + address);
+            }
+            col = col * 26 + static_cast<uint32_t>(std::toupper(static_cast<unsigned char>(address[i])) - 'A' + 1);
+            ++i;
+        }
+        if (i == letterStart || col > kMaxColumns) {
+            throw std::invalid_argument("Invalid cell address: " + address);
+        }
+        if (i < address.size() && address[i] == '$') ++i;
+        size_t digitStart = i;
+        while (i < address.size() && std::isdigit(static_cast<unsigned char>(address[i]))) {
+            rowNumber = rowNumber * 10 + static_cast<uint32_t>(address[i] - '0');
+            // Stop before the next digit could overflow
+            if (rowNumber > kMaxRows) {
+                throw std::invalid_argument("Invalid cell address: " + address);
+            }
+            ++i;
+        }
+        if (i == digitStart || i != address.size() || rowNumber == 0) {
+            throw std::invalid_argument("Invalid cell address: " + address);
+        }
+        return CellAddress(rowNumber - 1, col - 1);
+    }
+
+    bool operator==(const CellAddress& other) const {
+        return row == other.row && column == other.column;
+    }
+
+    bool operator!=(const CellAddress& other) const {
+        return !(*this == other);
+    }
+};
+
+// Identifies a cell across the whole workbook (worksheet index + address)
+struct SheetCellAddress {
+    uint32_t sheetIndex = 0;
+    CellAddress address;
+
+    SheetCellAddress() = default;
+    SheetCellAddress(uint32_t sheetIndex, const CellAddress& address) : sheetIndex(sheetIndex), address(address) {}
+
+    bool operator==(const SheetCellAddress& other) const {
+        return sheetIndex == other.sheetIndex && address == other.address;
+    }
+
+    bool operator!=(const SheetCellAddress& other) const {
+        return !(*this == other);
+    }
+};
+
+// A rectangular block of cells on one worksheet; both corners are inclusive
+struct SheetRange {
+    uint32_t sheetIndex = 0;
+    CellAddress first;
+    CellAddress last;
+
+    SheetRange() = default;
+    SheetRange(uint32_t sheetIndex, const CellAddress& first, const CellAddress& last)
+        : sheetIndex(sheetIndex), first(first), last(last) {}
+
+    bool contains(const SheetCellAddress& cell) const {
+        return cell.sheetIndex == sheetIndex &&
+               cell.address.row >= first.row && cell.address.row <= last.row &&
+               cell.address.column >= first.column && cell.address.column <= last.column;
     }
 };
 
 // Enum to represent different cell types
-enum class CellType {
+enum class CellType : uint8_t {
     String,
     Number,
     Boolean,
     Date,
+    Error,
     Empty
 };
 
-// Represents the value stored in a cell, supporting various data types
+// Excel error values. Errors are ordinary cell values: they are stored,
+// propagated through arithmetic and returned by functions like any other value.
+enum class ErrorCode : uint8_t {
+    None,
+    Null,   // #NULL!
+    Div0,   // #DIV/0!
+    Value,  // #VALUE!
+    Ref,    // #REF!
+    Name,   // #NAME?
+    Num,    // #NUM!
+    NA      // #N/A
+};
+
+inline const char* errorCodeText(ErrorCode code) {
+    switch (code) {
+        case ErrorCode::Null:  return "#NULL!";
+        case ErrorCode::Div0:  return "#DIV/0!";
+        case ErrorCode::Value: return "#VALUE!";
+        case ErrorCode::Ref:   return "#REF!";
+        case ErrorCode::Name:  return "#NAME?";
+        case ErrorCode::Num:   return "#NUM!";
+        case ErrorCode::NA:    return "#N/A";
+        default:               return "";
+    }
+}
+
+// Parses "#DIV/0!" etc.; returns ErrorCode::None for any other text
+inline ErrorCode parseErrorCode(const std::string& text) {
+    for (uint8_t code = static_cast<uint8_t>(ErrorCode::Null); code <= static_cast<uint8_t>(ErrorCode::NA); ++code) {
+        if (text == errorCodeText(static_cast<ErrorCode>(code))) {
+            return static_cast<ErrorCode>(code);
+        }
+    }
+    return ErrorCode::None;
+}
+
+// Days from 1970-01-01 to a date of the proleptic Gregorian calendar
+inline int64_t daysFromCivil(int year, int month, int day) {
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    int yearOfEra = y - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+}
+
+// Dates are stored as seconds since 1970; formulas compute with them as Excel
+// serial days (days since 1899-12-30, the time of day as the fraction)
+inline double dateSecondsToSerial(double seconds) {
+    return seconds / 86400.0 + 25569.0;
+}
+
+// Represents the value stored in a cell, supporting various data types.
+//
+// A 16-byte, trivially copyable tagged value: numbers, booleans and dates live
+// inline, strings are an ID into a StringPool plus a pointer to that pool.
+// Copying a value never allocates. Strings built without an explicit pool
+// (CellValue("text")) go to StringPool::global(), except while a formula is
+// evaluated: then they are result strings of the workbook's pool (see
+// StringPool::ResultScope) and must not be kept past the next recalculation.
+// The workbook's own pool is used for everything the engine stores or
+// evaluates. A string value must not outlive the pool it was interned in.
 class CellValue {
 public:
+    using Type = CellType;
+
+    CellValue() : type(CellType::Empty), errorCode(ErrorCode::None), reserved(0), stringId(0), number(0.0) {}
+    CellValue(double number) : CellValue() {
+        type = CellType::Number;
+        this->number = number;
+    }
+    CellValue(bool boolean) : CellValue() {
+        type = CellType::Boolean;
+        number = boolean ? 1.0 : 0.0;
+    }
+    CellValue(const std::string& text) : CellValue() {
+        type = CellType::String;
+        setUnpooledText(text);
+    }
+    CellValue(const char* text) : CellValue() {
+        type = CellType::String;
+        setUnpooledText(text ? text : "");
+    }
+    CellValue(StringPool& pool, std::string_view text) : CellValue() {
+        type = CellType::String;
+        stringId = pool.intern(text);
+        this->pool = &pool;
+    }
+    CellValue(std::chrono::system_clock::time_point date) : CellValue() {
+        type = CellType::Date;
+        number = std::chrono::duration<double>(date.time_since_epoch()).count();
+    }
+    // Errors given as text ("#N/A") map to their code; any other text becomes
+    // a #VALUE! error carrying the text as its message
+    CellValue(CellType type, const std::string& text) : CellValue(text) {
+        if (type == CellType::Error) {
+            ErrorCode code = parseErrorCode(text);
+            *this = code != ErrorCode::None ? error(code) : error(ErrorCode::Value, text);
+        }
+    }
+
+    static CellValue error(ErrorCode code, std::string_view message = {}) {
+        CellValue value;
+        value.type = CellType::Error;
+        value.errorCode = code;
+        if (!message.empty()) {
+            value.setUnpooledText(message);
+        }
+        return value;
+    }
+
+    // Rebuilds values from their stored parts (used by the column store)
+    static CellValue fromStringId(const StringPool& pool, uint32_t id) {
+        CellValue value;
+        value.type = CellType::String;
+        value.stringId = id;
+        value.pool = &pool;
+        return value;
+    }
+
+    static CellValue fromError(ErrorCode code, const StringPool& pool, uint32_t messageId) {
+        CellValue value = error(code);
+        if (messageId != 0) {
+            value.stringId = messageId;
+            value.pool = &pool;
+        }
+        return value;
+    }
+
+    static CellValue fromDateSeconds(double seconds) {
+        CellValue value;
+        value.type = CellType::Date;
+        value.number = seconds;
+        return value;
+    }
+
     CellType getType() const {
         return type;
     }
 
+    bool isError() const {
+        return type == CellType::Error;
+    }
+
+    ErrorCode getErrorCode() const {
+        return type == CellType::Error ? errorCode : ErrorCode::None;
+    }
+
+    // Optional detail attached to an error (e.g. a formula syntax error)
+    const std::string& getErrorMessage() const {
+        return type == CellType::Error ? text() : emptyString();
+    }
+
+    double getNumber() const {
+        return type == CellType::Number || type == CellType::Boolean ? number : 0.0;
+    }
+
+    bool getBoolean() const {
+        return type == CellType::Boolean && number != 0.0;
+    }
+
+    // The string of a String value; empty for every other type
+    const std::string& getString() const {
+        return type == CellType::String ? text() : emptyString();
+    }
+
+    uint32_t getStringId() const {
+        return stringId;
+    }
+
+    const StringPool* getStringPool() const {
+        return type == CellType::String || type == CellType::Error ? pool : nullptr;
+    }
+
+    // Dates are kept as seconds since the epoch
+    double getDateSeconds() const {
+        return type == CellType::Date ? number : 0.0;
+    }
+
+    // Convenience accessor; unlike the typed getters it copies strings
     std::variant<std::string, double, bool, std::chrono::system_clock::time_point> getValue() const {
-        return value;
+        switch (type) {
+            case CellType::Number:
+                return number;
+            case CellType::Boolean:
+                return number != 0.0;
+            case CellType::Date:
+                return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::duration<double>(number)));
+            case CellType::Error:
+                return std::string(errorCodeText(errorCode));
+            default:
+                return text();
+        }
+    }
+
+    std::string toString() const {
+        switch (type) {
+            case CellType::Number: {
+                std::string text = std::to_string(number);
+                text.erase(text.find_last_not_of('0') + 1);
+                if (!text.empty() && text.back() == '.') text.pop_back();
+                return text;
+            }
+            case CellType::Boolean:
+                return number != 0.0 ? "TRUE" : "FALSE";
+            case CellType::String:
+                return text();
+            case CellType::Error:
+                return errorCodeText(errorCode);
+            case CellType::Date:
+                return std::to_string(static_cast<long long>(number));
+            default:
+                return "";
+        }
     }
 
 private:
     CellType type;
-    std::variant<std::string, double, bool, std::chrono::system_clock::time_point> value;
+    ErrorCode errorCode;
+    uint16_t reserved;
+    uint32_t stringId;     // String text or error message; 0 is the empty string
+    union {
+        double number;     // Number, Boolean (1/0) and Date (seconds since the epoch)
+        const StringPool* pool;
+    };
+
+    static const std::string& emptyString() {
+        static const std::string empty;
+        return empty;
+    }
+
+    const std::string& text() const {
+        return stringId != 0 && pool != nullptr ? pool->get(stringId) : emptyString();
+    }
+
+    // Text given without a pool: a result string while this thread evaluates
+    // a formula, otherwise interned in global()
+    void setUnpooledText(std::string_view text) {
+        if (StringPool* results = StringPool::currentResultPool()) {
+            stringId = results->internResult(text);
+            pool = results;
+        } else {
+            stringId = StringPool::global().intern(text);
+            pool = &StringPool::global();
+        }
+    }
+};
+
+static_assert(sizeof(CellValue) == 16, "CellValue must stay 16 bytes");
+static_assert(std::is_trivially_copyable<CellValue>::value, "CellValue must be trivially copyable");
+
+} // namespace ExcelCore
+
+namespace std {
+template <>
+struct hash<ExcelCore::CellAddress> {
+    size_t operator()(const ExcelCore::CellAddress& address) const noexcept {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(address.column) << 32) | address.row);
+    }
+};
+
+template <>
+struct hash<ExcelCore::SheetCellAddress> {
+    size_t operator()(const ExcelCore::SheetCellAddress& cell) const noexcept {
+        size_t seed = std::hash<ExcelCore::CellAddress>()(cell.address);
+        return seed ^ (std::hash<uint32_t>()(cell.sheetIndex) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
 };
+} // namespace std
+
+namespace ExcelCore {
 
-// Represents a single cell in a worksheet
+// Snapshot of a single cell: its value plus the formula text, if any
 class Cell {
 public:
     CellAddress address;
@@ -60,22 +420,135 @@ public:
     void setValue(const CellValue& newValue) {
         value = newValue;
     }
+
+    bool hasFormula() const {
+        return !formula.empty();
+    }
+
+    const std::string& getFormula() const {
+        return formula;
+    }
+
+    const CellAddress& getAddress() const {
+        return address;
+    }
+
+    const CellValue& getValue() const {
+        return value;
+    }
 };
 
-// Represents a worksheet in a workbook
+// Formula attached to a worksheet cell. The formula's result is stored in the
+// worksheet's column store like any other value.
+class FormulaCell {
+public:
+    // Source text of a formula that has not been compiled yet. Once compiled the
+    // text is released and the cell points at its shared R1C1 template instead.
+    std::string formula;
+    // Shared bytecode for the formula, dropped whenever the formula changes
+    std::shared_ptr<const CompiledFormula> compiledFormula;
+    // Bumped whenever the formula changes
+    uint32_t version = 0;
+    // Formula version and calculation epoch of the stored result; a result
+    // stamped with the parser's current epoch is reused instead of re-evaluated
+    uint32_t resultVersion = 0;
+    uint64_t resultEpoch = 0;
+
+    void setFormula(const std::string& newFormula) {
+        formula = newFormula;
+        compiledFormula.reset();
+        ++version;
+    }
+
+    bool hasCurrentResult(uint64_t epoch) const {
+        return resultEpoch == epoch && resultVersion == version;
+    }
+
+    void stampResult(uint64_t epoch) {
+        resultEpoch = epoch;
+        resultVersion = version;
+    }
+
+    bool hasFormula() const {
+        return !formula.empty() || compiledFormula != nullptr;
+    }
+
+    // Returns the A1-style formula text (rendered from the shared template once compiled)
+    std::string getFormula(const CellAddress& address) const;
+};
+
+// Represents a worksheet in a workbook. Values live in a columnar store;
+// formulas are kept separately, keyed by address.
 class Worksheet {
 public:
     std::string name;
-    std::unordered_map<CellAddress, Cell> cells;
+    ColumnStore values;
+    std::unordered_map<CellAddress, FormulaCell> formulas;
+
+    Worksheet() : values(std::make_shared<StringPool>()) {}
+    explicit Worksheet(std::shared_ptr<StringPool> strings) : values(std::move(strings)) {}
+
+    // Returns a snapshot of the cell; empty cells yield an empty value
+    Cell getCell(const CellAddress& address) const {
+        Cell cell;
+        cell.address = address;
+        cell.value = values.get(address);
+        if (const FormulaCell* formulaCell = findFormulaCell(address)) {
+            cell.formula = formulaCell->getFormula(address);
+        }
+        return cell;
+    }
+
+    // Looks up a formula without creating it; returns nullptr for constant or empty cells
+    const FormulaCell* findFormulaCell(const CellAddress& address) const {
+        auto it = formulas.find(address);
+        return it == formulas.end() ? nullptr : &it->second;
+    }
+
+    FormulaCell* findFormulaCell(const CellAddress& address) {
+        auto it = formulas.find(address);
+        return it == formulas.end() ? nullptr : &it->second;
+    }
 
-    Cell& getCell(const CellAddress& address) {
-        // TODO: Implement cell lookup and creation if it doesn't exist
-        return cells[address]; // Placeholder
+    CellValue getCellValue(const CellAddress& address) const {
+        return values.get(address);
+    }
+
+    void setCellValue(const CellAddress& address, const CellValue& value) {
+        formulas.erase(address);
+        values.set(address, value);
+        ++editVersion;
+    }
+
+    // Reserves the value slot up front so results can be stored without allocating
+    void setCellFormula(const CellAddress& address, const std::string& formula) {
+        ++editVersion;
+        if (formula.empty()) {
+            formulas.erase(address);
+            return;
+        }
+        formulas[address].setFormula(formula);
+        values.reserve(address);
+    }
+
+    // Stores a formula result; safe to call concurrently for distinct formula cells
+    void setFormulaResult(const CellAddress& address, const CellValue& value) {
+        if (!values.assign(address, value)) {
+            values.set(address, value);
+        }
     }
 
     void setName(const std::string& newName) {
         name = newName;
     }
+
+    // Counts edits of values and formulas (not formula results)
+    uint64_t getEditVersion() const {
+        return editVersion;
+    }
+
+private:
+    uint64_t editVersion = 0;
 };
 
 // Represents an Excel workbook containing multiple worksheets
@@ -83,9 +556,14 @@ class Workbook {
 public:
     std::string name;
     std::vector<Worksheet> worksheets;
+    // Shared by all worksheets so equal strings are stored once per workbook
+    std::shared_ptr<StringPool> stringPool = std::make_shared<StringPool>();
+
+    Workbook() = default;
+    explicit Workbook(const std::string& name) : name(name) {}
 
     Worksheet& addWorksheet(const std::string& name) {
-        worksheets.emplace_back();
+        worksheets.emplace_back(stringPool);
         worksheets.back().setName(name);
         return worksheets.back();
     }
@@ -96,10 +574,30 @@ public:
         }
         return worksheets[index];
     }
+
+    const Worksheet& getWorksheet(size_t index) const {
+        if (index >= worksheets.size()) {
+            throw std::out_of_range("Worksheet index out of range");
+        }
+        return worksheets[index];
+    }
+
+    size_t getWorksheetCount() const {
+        return worksheets.size();
+    }
+
+    // Changes whenever a cell of any worksheet is edited or a worksheet is added
+    uint64_t getEditVersion() const {
+        uint64_t version = worksheets.size();
+        for (const auto& worksheet : worksheets) {
+            version += worksheet.getEditVersion();
+        }
+        return version;
+    }
 };
 
 } // namespace ExcelCore
 
 // TODO: Implement error handling for invalid cell addresses and out-of-range worksheet indices
 // TODO: Add support for cell styles and formatting
-// TODO: Implement memory management strategies for large workbooks
\ No newline at end of file
+// TODO: Implement memory management strategies for large workbooks
@@ -0,0 +1,363 @@
+#include "DependencyGraph.h"
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+namespace ExcelCore {
+
+namespace {
+const std::unordered_set<SheetCellAddress> kNoDependents;
+const std::vector<SheetCellAddress> kNoPrecedents;
+const std::vector<SheetRange> kNoRangePrecedents;
+
+// Calls visitor for the row tree nodes that together cover rows
+// [firstRow, lastRow] exactly once, at most two per tree level
+template <typename Visitor>
+void forEachCoveringNode(uint32_t leaves, uint32_t firstRow, uint32_t lastRow, Visitor&& visitor) {
+    uint32_t low = leaves + firstRow;
+    uint32_t high = leaves + std::min(lastRow, leaves - 1) + 1;
+    while (low < high) {
+        if (low & 1) {
+            visitor(low++);
+        }
+        if (high & 1) {
+            visitor(--high);
+        }
+        low >>= 1;
+        high >>= 1;
+    }
+}
+}
+
+// Replaces the precedents of a formula cell, updating the reverse edges
+void DependencyGraph::setPrecedents(const SheetCellAddress& cell, const std::vector<SheetCellAddress>& newPrecedents,
+                                    const std::vector<SheetRange>& newRangePrecedents) {
+    removeCell(cell);
+
+    if (!newPrecedents.empty()) {
+        auto& stored = precedents[cell];
+        stored.reserve(newPrecedents.size());
+        for (const auto& precedent : newPrecedents) {
+            // The same reference may appear several times in a formula; keep one edge
+            if (dependents[precedent].insert(cell).second) {
+                stored.push_back(precedent);
+            }
+        }
+    }
+
+    if (!newRangePrecedents.empty()) {
+        rangePrecedents[cell] = newRangePrecedents;
+        for (const auto& range : newRangePrecedents) {
+            if (isWide(range)) {
+                wideRanges.push_back(RangeEdge{range, cell});
+            } else {
+                for (uint32_t column = range.first.column; column <= range.last.column; ++column) {
+                    RowTree& tree = rangeIndex[columnKey(range.sheetIndex, column)];
+                    forEachCoveringNode(kRowLeaves, range.first.row, range.last.row,
+                                        [&](uint32_t node) { tree[node].push_back(cell); });
+                }
+            }
+        }
+    }
+}
+
+void DependencyGraph::eraseEdge(std::vector<RangeEdge>& edges, const SheetCellAddress& dependent) {
+    edges.erase(std::remove_if(edges.begin(), edges.end(),
+                               [&](const RangeEdge& edge) { return edge.dependent == dependent; }),
+                edges.end());
+}
+
+// Removes a cell's outgoing edges (e.g. when its formula is cleared)
+void DependencyGraph::removeCell(const SheetCellAddress& cell) {
+    auto rangeIt = rangePrecedents.find(cell);
+    if (rangeIt != rangePrecedents.end()) {
+        for (const auto& range : rangeIt->second) {
+            if (isWide(range)) {
+                eraseEdge(wideRanges, cell);
+            } else {
+                for (uint32_t column = range.first.column; column <= range.last.column; ++column) {
+                    auto bucket = rangeIndex.find(columnKey(range.sheetIndex, column));
+                    if (bucket == rangeIndex.end()) {
+                        continue;
+                    }
+                    RowTree& tree = bucket->second;
+                    forEachCoveringNode(kRowLeaves, range.first.row, range.last.row, [&](uint32_t node) {
+                        auto entry = tree.find(node);
+                        if (entry != tree.end()) {
+                            auto& nodeDependents = entry->second;
+                            nodeDependents.erase(std::remove(nodeDependents.begin(), nodeDependents.end(), cell),
+                                                 nodeDependents.end());
+                            if (nodeDependents.empty()) {
+                                tree.erase(entry);
+                            }
+                        }
+                    });
+                    if (tree.empty()) {
+                        rangeIndex.erase(bucket);
+                    }
+                }
+            }
+        }
+        rangePrecedents.erase(rangeIt);
+    }
+
+    auto it = precedents.find(cell);
+    if (it == precedents.end()) {
+        return;
+    }
+
+    for (const auto& precedent : it->second) {
+        auto dependentIt = dependents.find(precedent);
+        if (dependentIt != dependents.end()) {
+            dependentIt->second.erase(cell);
+            if (dependentIt->second.empty()) {
+                dependents.erase(dependentIt);
+            }
+        }
+    }
+    precedents.erase(it);
+}
+
+// Returns the cells whose formulas reference the given cell
+const std::unordered_set<SheetCellAddress>& DependencyGraph::getDependents(const SheetCellAddress& cell) const {
+    auto it = dependents.find(cell);
+    return it == dependents.end() ? kNoDependents : it->second;
+}
+
+// Returns the cells referenced by the given cell's formula
+const std::vector<SheetCellAddress>& DependencyGraph::getPrecedents(const SheetCellAddress& cell) const {
+    auto it = precedents.find(cell);
+    return it == precedents.end() ? kNoPrecedents : it->second;
+}
+
+// Returns the ranges referenced by the given cell's formula
+const std::vector<SheetRange>& DependencyGraph::getRangePrecedents(const SheetCellAddress& cell) const {
+    auto it = rangePrecedents.find(cell);
+    return it == rangePrecedents.end() ? kNoRangePrecedents : it->second;
+}
+
+// Collects the given cells and all of their transitive dependents. Every range
+// stored at a row tree node contains all of the node's rows, so the first dirty
+// cell under a node makes all of its dependents dirty and later cells skip it:
+// each node is expanded once however many changed cells lie in its ranges.
+std::unordered_set<SheetCellAddress> DependencyGraph::collectDirty(const std::vector<SheetCellAddress>& changedCells) const {
+    std::unordered_set<SheetCellAddress> dirty;
+    std::unordered_set<const std::vector<SheetCellAddress>*> expandedNodes;
+    std::vector<SheetCellAddress> pending(changedCells.begin(), changedCells.end());
+
+    auto markDirty = [&](const SheetCellAddress& dependent) {
+        if (dirty.find(dependent) == dirty.end()) {
+            pending.push_back(dependent);
+        }
+    };
+    while (!pending.empty()) {
+        SheetCellAddress cell = pending.back();
+        pending.pop_back();
+        if (!dirty.insert(cell).second) {
+            continue;
+        }
+        for (const auto& dependent : getDependents(cell)) {
+            markDirty(dependent);
+        }
+        forEachRangeNode(cell, [&](const std::vector<SheetCellAddress>& nodeDependents) {
+            if (expandedNodes.insert(&nodeDependents).second) {
+                for (const auto& dependent : nodeDependents) {
+                    markDirty(dependent);
+                }
+            }
+        });
+        forEachWideDependent(cell, markDirty);
+    }
+
+    return dirty;
+}
+
+// Kahn's algorithm restricted to the dirty subgraph: only edges between two
+// dirty cells constrain the order, clean precedents already hold valid values.
+// A row tree node acts as one extra vertex between the dirty cells under it and
+// the dependents stored at it, so a range costs an edge per node rather than
+// one per cell inside it.
+std::vector<SheetCellAddress> DependencyGraph::topologicalOrder(const std::unordered_set<SheetCellAddress>& dirtyCells,
+                                                                std::vector<SheetCellAddress>& cyclicCells) const {
+    std::unordered_map<SheetCellAddress, size_t> inDegree;
+    inDegree.reserve(dirtyCells.size());
+    for (const auto& cell : dirtyCells) {
+        inDegree.emplace(cell, 0);
+    }
+    auto addEdge = [&](const SheetCellAddress& dependent) {
+        auto it = inDegree.find(dependent);
+        if (it != inDegree.end()) {
+            ++it->second;
+        }
+    };
+    // Dirty cells under each node not yet placed in the order
+    std::unordered_map<const std::vector<SheetCellAddress>*, size_t> nodeInDegree;
+    for (const auto& cell : dirtyCells) {
+        for (const auto& dependent : getDependents(cell)) {
+            addEdge(dependent);
+        }
+        forEachRangeNode(cell, [&](const std::vector<SheetCellAddress>& nodeDependents) {
+            ++nodeInDegree[&nodeDependents];
+        });
+        forEachWideDependent(cell, addEdge);
+    }
+    for (const auto& entry : nodeInDegree) {
+        for (const auto& dependent : *entry.first) {
+            addEdge(dependent);
+        }
+    }
+
+    std::deque<SheetCellAddress> ready;
+    for (const auto& entry : inDegree) {
+        if (entry.second == 0) {
+            ready.push_back(entry.first);
+        }
+    }
+
+    std::vector<SheetCellAddress> order;
+    order.reserve(dirtyCells.size());
+    auto removeEdge = [&](const SheetCellAddress& dependent) {
+        auto it = inDegree.find(dependent);
+        if (it != inDegree.end() && --it->second == 0) {
+            ready.push_back(dependent);
+        }
+    };
+    while (!ready.empty()) {
+        SheetCellAddress cell = ready.front();
+        ready.pop_front();
+        order.push_back(cell);
+        for (const auto& dependent : getDependents(cell)) {
+            removeEdge(dependent);
+        }
+        forEachRangeNode(cell, [&](const std::vector<SheetCellAddress>& nodeDependents) {
+            if (--nodeInDegree[&nodeDependents] == 0) {
+                for (const auto& dependent : nodeDependents) {
+                    removeEdge(dependent);
+                }
+            }
+        });
+        forEachWideDependent(cell, removeEdge);
+    }
+
+    cyclicCells.clear();
+    if (order.size() != dirtyCells.size()) {
+        for (const auto& entry : inDegree) {
+            if (entry.second > 0) {
+                cyclicCells.push_back(entry.first);
+            }
+        }
+    }
+
+    return order;
+}
+
+// Iterative, so long reference chains cannot overflow the stack. Tarjan
+// completes a component only after every component it reaches, i.e. its
+// dependents, so the result is reversed at the end.
+std::vector<DependencyGraph::Component> DependencyGraph::stronglyConnectedComponents(
+    const std::vector<SheetCellAddress>& cells) const {
+    const uint32_t count = static_cast<uint32_t>(cells.size());
+    std::unordered_map<SheetCellAddress, uint32_t> indexOf;
+    indexOf.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        indexOf.emplace(cells[i], i);
+    }
+
+    // Edges between the given cells as flat adjacency lists
+    std::vector<uint32_t> edgeStart(count + 1, 0);
+    std::vector<uint32_t> edges;
+    std::vector<bool> selfReference(count, false);
+    for (uint32_t i = 0; i < count; ++i) {
+        edgeStart[i] = static_cast<uint32_t>(edges.size());
+        forEachDependent(cells[i], [&](const SheetCellAddress& dependent) {
+            auto it = indexOf.find(dependent);
+            if (it != indexOf.end()) {
+                edges.push_back(it->second);
+                if (it->second == i) {
+                    selfReference[i] = true;
+                }
+            }
+        });
+    }
+    edgeStart[count] = static_cast<uint32_t>(edges.size());
+
+    const uint32_t unvisited = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> visitOrder(count, unvisited);
+    std::vector<uint32_t> lowLink(count, 0);
+    std::vector<bool> onStack(count, false);
+    std::vector<uint32_t> stack;
+    // (cell, next edge to follow) for each cell on the current search path
+    std::vector<std::pair<uint32_t, uint32_t>> path;
+    uint32_t visited = 0;
+    std::vector<Component> components;
+
+    auto visit = [&](uint32_t cell) {
+        visitOrder[cell] = lowLink[cell] = visited++;
+        stack.push_back(cell);
+        onStack[cell] = true;
+        path.emplace_back(cell, edgeStart[cell]);
+    };
+
+    for (uint32_t root = 0; root < count; ++root) {
+        if (visitOrder[root] != unvisited) {
+            continue;
+        }
+        visit(root);
+        while (!path.empty()) {
+            uint32_t cell = path.back().first;
+            if (path.back().second < edgeStart[cell + 1]) {
+                uint32_t next = edges[path.back().second++];
+                if (visitOrder[next] == unvisited) {
+                    visit(next);
+                } else if (onStack[next]) {
+                    lowLink[cell] = std::min(lowLink[cell], visitOrder[next]);
+                }
+                continue;
+            }
+
+            path.pop_back();
+            if (!path.empty()) {
+                uint32_t parent = path.back().first;
+                lowLink[parent] = std::min(lowLink[parent], lowLink[cell]);
+            }
+            if (lowLink[cell] == visitOrder[cell]) {
+                Component component;
+                uint32_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    onStack[member] = false;
+                    component.cells.push_back(cells[member]);
+                } while (member != cell);
+                component.cyclic = component.cells.size() > 1 || selfReference[cell];
+                std::sort(component.cells.begin(), component.cells.end(),
+                          [](const SheetCellAddress& a, const SheetCellAddress& b) {
+                              if (a.sheetIndex != b.sheetIndex) {
+                                  return a.sheetIndex < b.sheetIndex;
+                              }
+                              return a.address.row != b.address.row ? a.address.row < b.address.row
+                                                                    : a.address.column < b.address.column;
+                          });
+                components.push_back(std::move(component));
+            }
+        }
+    }
+
+    std::reverse(components.begin(), components.end());
+    return components;
+}
+
+void DependencyGraph::clear() {
+    precedents.clear();
+    dependents.clear();
+    rangePrecedents.clear();
+    rangeIndex.clear();
+    wideRanges.clear();
+}
+
+void DependencyGraph::reserve(size_t cellCount) {
+    precedents.reserve(cellCount);
+    dependents.reserve(cellCount);
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "DataStructures.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ExcelCore {
+
+// Persistent precedent/dependent graph for all formula cells in a workbook.
+// Edges are kept in both directions so that an edit can update a cell's
+// precedents in O(references) and walk its dependents without a full rebuild.
+//
+// Range references (A1:A1000, A:A) are stored as one range edge instead of an
+// edge per cell. Range edges are indexed per column in a segment tree over the
+// worksheet rows: a range is stored at the few tree nodes that exactly cover
+// its rows, so the ranges containing a cell are the ones stored on the path
+// from the cell's row up to the root. Ranges wider than kMaxIndexedColumns
+// live in a separate list that is scanned linearly.
+class DependencyGraph {
+public:
+    static constexpr uint32_t kMaxIndexedColumns = 64;
+
+    // Cells that all depend on each other. A single cell is only cyclic when
+    // it references itself.
+    struct Component {
+        std::vector<SheetCellAddress> cells;
+        bool cyclic = false;
+    };
+
+    // Replaces the precedents of a formula cell, updating the reverse edges
+    void setPrecedents(const SheetCellAddress& cell, const std::vector<SheetCellAddress>& newPrecedents,
+                       const std::vector<SheetRange>& newRangePrecedents = {});
+
+    // Removes a cell's outgoing edges (e.g. when its formula is cleared)
+    void removeCell(const SheetCellAddress& cell);
+
+    // Returns the cells whose formulas reference the given cell directly
+    // (range dependents are only reported by forEachDependent)
+    const std::unordered_set<SheetCellAddress>& getDependents(const SheetCellAddress& cell) const;
+
+    // Calls visitor for every cell whose formula references the given cell,
+    // directly or through a range. A cell referenced both ways is visited twice.
+    template <typename Visitor>
+    void forEachDependent(const SheetCellAddress& cell, Visitor&& visitor) const {
+        auto it = dependents.find(cell);
+        if (it != dependents.end()) {
+            for (const auto& dependent : it->second) {
+                visitor(dependent);
+            }
+        }
+        forEachRangeNode(cell, [&](const std::vector<SheetCellAddress>& nodeDependents) {
+            for (const auto& dependent : nodeDependents) {
+                visitor(dependent);
+            }
+        });
+        forEachWideDependent(cell, visitor);
+    }
+
+    // Returns the ranges referenced by the given cell's formula
+    const std::vector<SheetRange>& getRangePrecedents(const SheetCellAddress& cell) const;
+
+    // Returns the cells referenced by the given cell's formula
+    const std::vector<SheetCellAddress>& getPrecedents(const SheetCellAddress& cell) const;
+
+    // Collects the given cells and all of their transitive dependents
+    std::unordered_set<SheetCellAddress> collectDirty(const std::vector<SheetCellAddress>& changedCells) const;
+
+    // Orders a dirty set so that every cell comes after its dirty precedents.
+    // Cells that are part of (or downstream of) a cycle cannot be ordered and
+    // are returned through cyclicCells instead.
+    std::vector<SheetCellAddress> topologicalOrder(const std::unordered_set<SheetCellAddress>& dirtyCells,
+                                                   std::vector<SheetCellAddress>& cyclicCells) const;
+
+    // Splits cells into strongly connected components (Tarjan), considering
+    // only edges between the given cells. Components are returned in dependency
+    // order, and the cells of a component sorted by address.
+    std::vector<Component> stronglyConnectedComponents(const std::vector<SheetCellAddress>& cells) const;
+
+    void clear();
+
+    // Sizes the cell maps for a bulk build over cellCount formula cells
+    void reserve(size_t cellCount);
+
+    size_t size() const {
+        return precedents.size() + rangePrecedents.size();
+    }
+
+private:
+    struct RangeEdge {
+        SheetRange range;
+        SheetCellAddress dependent;
+    };
+
+    // Row tree nodes are numbered as in a binary heap: the root is 1 and the
+    // leaf of row r is kRowLeaves + r. Only nodes that hold ranges are stored.
+    static constexpr uint32_t kRowLeaves = kMaxRows;
+    static_assert((kRowLeaves & (kRowLeaves - 1)) == 0, "row tree needs a power of two leaves");
+    using RowTree = std::unordered_map<uint32_t, std::vector<SheetCellAddress>>;
+
+    std::unordered_map<SheetCellAddress, std::vector<SheetCellAddress>> precedents;
+    std::unordered_map<SheetCellAddress, std::unordered_set<SheetCellAddress>> dependents;
+    std::unordered_map<SheetCellAddress, std::vector<SheetRange>> rangePrecedents;
+    std::unordered_map<uint64_t, RowTree> rangeIndex;
+    std::vector<RangeEdge> wideRanges;
+
+    // Calls visitor with the dependents stored at each row tree node above the
+    // cell; a range containing the cell is stored at exactly one of them
+    template <typename Visitor>
+    void forEachRangeNode(const SheetCellAddress& cell, Visitor&& visitor) const {
+        if (rangeIndex.empty() || cell.address.row >= kRowLeaves) {
+            return;
+        }
+        auto bucket = rangeIndex.find(columnKey(cell.sheetIndex, cell.address.column));
+        if (bucket == rangeIndex.end()) {
+            return;
+        }
+        for (uint32_t node = kRowLeaves + cell.address.row; node != 0; node >>= 1) {
+            auto entry = bucket->second.find(node);
+            if (entry != bucket->second.end()) {
+                visitor(entry->second);
+            }
+        }
+    }
+
+    template <typename Visitor>
+    void forEachWideDependent(const SheetCellAddress& cell, Visitor&& visitor) const {
+        for (const auto& edge : wideRanges) {
+            if (edge.range.contains(cell)) {
+                visitor(edge.dependent);
+            }
+        }
+    }
+
+    static uint64_t columnKey(uint32_t sheetIndex, uint32_t column) {
+        return (static_cast<uint64_t>(sheetIndex) << 32) | column;
+    }
+
+    static bool isWide(const SheetRange& range) {
+        return range.last.column - range.first.column >= kMaxIndexedColumns;
+    }
+
+    static void eraseEdge(std::vector<RangeEdge>& edges, const SheetCellAddress& dependent);
+};
+
+} // namespace ExcelCore
@@ -0,0 +1,168 @@
+#include "Downsampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ExcelCore {
+namespace Downsampling {
+
+namespace {
+std::vector<ChartPoint> finitePoints(const double* values, size_t begin, size_t end) {
+    std::vector<ChartPoint> points;
+    points.reserve(end - begin);
+    for (size_t i = begin; i < end; ++i) {
+        if (std::isfinite(values[i])) {
+            points.push_back({static_cast<double>(i), values[i]});
+        }
+    }
+    return points;
+}
+
+// First index of bucket `bucket` when `count` values starting at `offset` are
+// split into buckets of (fractional) size bucketSize
+size_t bucketStart(size_t offset, size_t bucket, double bucketSize) {
+    return offset + static_cast<size_t>(static_cast<double>(bucket) * bucketSize);
+}
+}
+
+std::vector<ChartPoint> largestTriangleThreeBuckets(const double* values, size_t count, size_t targetPoints) {
+    // The first and last points are always kept, so at least one bucket is needed
+    targetPoints = std::max<size_t>(targetPoints, 3);
+    if (count <= targetPoints) {
+        return finitePoints(values, 0, count);
+    }
+
+    size_t firstIndex = 0;
+    while (firstIndex < count && !std::isfinite(values[firstIndex])) {
+        ++firstIndex;
+    }
+    if (firstIndex == count) {
+        return {};
+    }
+    size_t lastIndex = count - 1;
+    while (!std::isfinite(values[lastIndex])) {
+        --lastIndex;
+    }
+
+    // Points strictly between the first and the last are split into buckets
+    size_t innerCount = lastIndex > firstIndex ? lastIndex - firstIndex - 1 : 0;
+    size_t bucketCount = targetPoints - 2;
+    if (innerCount <= bucketCount) {
+        return finitePoints(values, firstIndex, lastIndex + 1);
+    }
+
+    std::vector<ChartPoint> result;
+    result.reserve(targetPoints);
+    ChartPoint previous{static_cast<double>(firstIndex), values[firstIndex]};
+    ChartPoint last{static_cast<double>(lastIndex), values[lastIndex]};
+    result.push_back(previous);
+
+    double bucketSize = static_cast<double>(innerCount) / static_cast<double>(bucketCount);
+    size_t innerBegin = firstIndex + 1;
+    for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+        size_t begin = bucketStart(innerBegin, bucket, bucketSize);
+        size_t end = bucket + 1 == bucketCount ? lastIndex : bucketStart(innerBegin, bucket + 1, bucketSize);
+
+        // The third vertex is the average of the next bucket (the last point
+        // after the final bucket, or when the next bucket is all gaps)
+        ChartPoint next = last;
+        if (bucket + 1 < bucketCount) {
+            size_t nextEnd = bucket + 2 == bucketCount ? lastIndex : bucketStart(innerBegin, bucket + 2, bucketSize);
+            double sumX = 0;
+            double sumY = 0;
+            size_t finiteCount = 0;
+            for (size_t i = end; i < nextEnd; ++i) {
+                if (std::isfinite(values[i])) {
+                    sumX += static_cast<double>(i);
+                    sumY += values[i];
+                    ++finiteCount;
+                }
+            }
+            if (finiteCount > 0) {
+                next = {sumX / static_cast<double>(finiteCount), sumY / static_cast<double>(finiteCount)};
+            }
+        }
+
+        // Twice the triangle's area; the factor does not change the pick
+        double bestArea = -1;
+        size_t bestIndex = end;
+        for (size_t i = begin; i < end; ++i) {
+            if (!std::isfinite(values[i])) {
+                continue;
+            }
+            double x = static_cast<double>(i);
+            double area = std::fabs((previous.x - next.x) * (values[i] - previous.y) -
+                                    (previous.x - x) * (next.y - previous.y));
+            if (area > bestArea) {
+                bestArea = area;
+                bestIndex = i;
+            }
+        }
+        if (bestIndex != end) {
+            previous = {static_cast<double>(bestIndex), values[bestIndex]};
+            result.push_back(previous);
+        }
+    }
+
+    result.push_back(last);
+    return result;
+}
+
+std::vector<ChartPoint> minMaxBuckets(const double* values, size_t count, size_t bucketCount) {
+    bucketCount = std::max<size_t>(bucketCount, 1);
+    if (count <= 2 * bucketCount) {
+        return finitePoints(values, 0, count);
+    }
+
+    std::vector<ChartPoint> result;
+    result.reserve(2 * bucketCount);
+    double bucketSize = static_cast<double>(count) / static_cast<double>(bucketCount);
+    for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+        size_t begin = bucketStart(0, bucket, bucketSize);
+        size_t end = bucket + 1 == bucketCount ? count : bucketStart(0, bucket + 1, bucketSize);
+
+        size_t minIndex = end;
+        size_t maxIndex = end;
+        for (size_t i = begin; i < end; ++i) {
+            double value = values[i];
+            if (!std::isfinite(value)) {
+                continue;
+            }
+            if (minIndex == end || value < values[minIndex]) {
+                minIndex = i;
+            }
+            if (maxIndex == end || value > values[maxIndex]) {
+                maxIndex = i;
+            }
+        }
+        if (minIndex == end) {
+            continue;
+        }
+        // Keep series order so the line runs through both extremes
+        size_t firstPick = std::min(minIndex, maxIndex);
+        size_t secondPick = std::max(minIndex, maxIndex);
+        result.push_back({static_cast<double>(firstPick), values[firstPick]});
+        if (secondPick != firstPick) {
+            result.push_back({static_cast<double>(secondPick), values[secondPick]});
+        }
+    }
+    return result;
+}
+
+std::vector<ChartPoint> reduce(const double* values, size_t count, DownsampleMethod method, size_t width) {
+    // A width of 0 means the output size is unknown
+    if (width == 0) {
+        method = DownsampleMethod::None;
+    }
+    switch (method) {
+        case DownsampleMethod::Lttb:
+            return largestTriangleThreeBuckets(values, count, width);
+        case DownsampleMethod::MinMax:
+            return minMaxBuckets(values, count, width);
+        default:
+            return finitePoints(values, 0, count);
+    }
+}
+
+} // namespace Downsampling
+} // namespace ExcelCore
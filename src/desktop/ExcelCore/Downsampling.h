@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ExcelCore {
+
+// A point of a chart series; x is the index of the value within the series
+struct ChartPoint {
+    double x;
+    double y;
+};
+
+enum class DownsampleMethod : uint8_t {
+    // Every value is drawn
+    None,
+    // Largest-Triangle-Three-Buckets: one point per bucket, the one that forms
+    // the largest triangle with the points picked around it. Keeps the visual
+    // shape of a line with as many points as the target.
+    Lttb,
+    // The minimum and maximum of each bucket, in series order. Keeps every
+    // peak, so a dense line is drawn with its exact extent in each pixel column.
+    MinMax
+};
+
+// Data reduction between extracting a chart's series and drawing them, so the
+// cost of rendering depends on the output width rather than the source range.
+// Non-finite values (cells that hold no number) are gaps and are never picked.
+// When a series has no more values than the target, its finite values are
+// returned as they are.
+namespace Downsampling {
+
+std::vector<ChartPoint> largestTriangleThreeBuckets(const double* values, size_t count, size_t targetPoints);
+
+// Returns at most 2 * bucketCount points
+std::vector<ChartPoint> minMaxBuckets(const double* values, size_t count, size_t bucketCount);
+
+// Reduces a series for a plot that is width pixels wide: to width points
+// (LTTB), or to the extremes of width buckets (min/max)
+std::vector<ChartPoint> reduce(const double* values, size_t count, DownsampleMethod method, size_t width);
+
+} // namespace Downsampling
+
+} // namespace ExcelCore
+
+// TODO: Downsample series with explicit x values (scatter charts)
@@ -0,0 +1,55 @@
+#include "EvaluationArena.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace ExcelCore {
+
+void* EvaluationArena::do_allocate(size_t bytes, size_t alignment) {
+    // Try the current block, then the blocks kept from earlier passes
+    for (; current < blocks.size(); ++current, offset = 0) {
+        Block& block = blocks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        uintptr_t aligned = (base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (aligned + bytes <= base + block.size) {
+            offset = aligned + bytes - base;
+            return reinterpret_cast<void*>(aligned);
+        }
+    }
+
+    // Oversized requests get a block of their own
+    Block block;
+    block.size = std::max(kBlockSize, bytes + alignment);
+    block.data.reset(new std::byte[block.size]);
+    blocks.push_back(std::move(block));
+    current = blocks.size() - 1;
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(blocks[current].data.get());
+    uintptr_t aligned = (base + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    offset = aligned + bytes - base;
+    return reinterpret_cast<void*>(aligned);
+}
+
+void EvaluationArena::reset() {
+    current = 0;
+    offset = 0;
+    if (blocks.size() > kRetainedBlocks) {
+        blocks.resize(kRetainedBlocks);
+    }
+}
+
+size_t EvaluationArena::capacity() const {
+    size_t bytes = 0;
+    for (const Block& block : blocks) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+EvaluationArena& EvaluationArena::forThread() {
+    thread_local EvaluationArena arena;
+    return arena;
+}
+
+} // namespace ExcelCore
+
+// TODO: Size the retained blocks from the deepest evaluation of the previous pass
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace ExcelCore {
+
+// Bump allocator for evaluation scratch: value stacks, function argument lists
+// and gathered numbers. Allocation is a pointer increment and deallocation is a
+// no-op; memory is handed back in bulk by rewinding to a marker. Each thread
+// owns one arena (forThread), so recalc workers never contend on the heap.
+class EvaluationArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kBlockSize = 64 * 1024;
+    // Blocks kept across resets; anything beyond is returned to the heap
+    static constexpr size_t kRetainedBlocks = 16;
+
+    // A position in the arena to rewind to
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // Rewinds the arena when it goes out of scope. Scopes nest: the interpreter
+    // opens one per formula, so a formula evaluated on behalf of another frees
+    // its scratch before the caller continues.
+    class Scope {
+    public:
+        explicit Scope(EvaluationArena& arena) : arena(arena), marker(arena.mark()) {}
+        ~Scope() {
+            if (marker.block == 0 && marker.offset == 0) {
+                arena.reset();
+            } else {
+                arena.rewind(marker);
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        EvaluationArena& arena;
+        Marker marker;
+    };
+
+    EvaluationArena() = default;
+    EvaluationArena(const EvaluationArena&) = delete;
+    EvaluationArena& operator=(const EvaluationArena&) = delete;
+
+    Marker mark() const {
+        return Marker{current, offset};
+    }
+
+    void rewind(const Marker& marker) {
+        current = marker.block;
+        offset = marker.offset;
+    }
+
+    // Frees everything at once and trims the arena back to kRetainedBlocks
+    void reset();
+
+    // Bytes reserved from the heap
+    size_t capacity() const;
+
+    // The calling thread's arena
+    static EvaluationArena& forThread();
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t offset = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// Vector whose storage comes from an evaluation arena
+template <typename T>
+using ScratchVector = std::pmr::vector<T>;
+
+} // namespace ExcelCore
@@ -4,21 +4,218 @@
 #include "ExcelCoreDLL.h"
 #include "DataStructures.h"
 #include "CalculationEngine.h"
+#include "ChartingEngine.h"
+#include "HandleRegistry.h"
+#include "CsvReader.h"
+#include "ThreadPool.h"
+#include "XlsxReader.h"
+#include "XlsxWriter.h"
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <stdexcept>
+#include <iostream>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+using ExcelCore::Worksheet;
+using ExcelCore::CellType;
+using ExcelCore::ErrorCode;
+
+// A workbook together with its long-lived calculation engine. The engine owns
+// the workbook's dependency graph, so every edit must go through it.
+//
+// Readers share `access`. Edits hold `writer` and then `access` exclusively.
+// Recalculation holds `writer` throughout but only prepares under exclusive
+// `access`; it evaluates under shared `access`, so reads continue meanwhile.
+// Charts are patched by recalculation, so they are read under `writer`.
+struct CalculationJob;
+
+struct WorkbookContext {
+    std::shared_ptr<Workbook> workbook;
+    std::unique_ptr<CalculationEngine> engine;
+    // Declared after the engine, so charts unsubscribe before it is destroyed
+    ChartingEngine charts;
+    std::mutex writer;
+    std::shared_mutex access;
+    // The asynchronous calculation in flight, cancelled by edits that supersede it
+    std::mutex jobMutex;
+    std::weak_ptr<CalculationJob> activeJob;
+};
+
+// A background recalculation started by CalculateWorkbookAsync
+struct CalculationJob {
+    std::shared_ptr<WorkbookContext> context;
+    RecalculationProgress progress;
+    ExcelCalculationCallback callback;
+    void* userData;
+};
+
+// A column pinned by the host. The pin keeps its workbook alive, so the
+// segments outlive a CloseWorkbook call.
+struct ColumnPin {
+    std::shared_ptr<WorkbookContext> context;
+    int worksheetIndex;
+    uint32_t column;
+};
 
 // Global variables
-std::unordered_map<int, std::unique_ptr<Workbook>> g_workbooks;
-int g_nextWorkbookHandle = 1;
+ExcelCore::HandleRegistry<WorkbookContext> g_workbooks;
+ExcelCore::HandleRegistry<ColumnPin> g_columnPins;
+ExcelCore::HandleRegistry<CalculationJob> g_calculationJobs;
+
+// Helper function to get the pool that runs asynchronous calculations
+ExcelCore::ThreadPool& GetCalculationJobPool() {
+    static ExcelCore::ThreadPool pool(ExcelCore::ThreadPool::defaultThreadCount());
+    return pool;
+}
+
+// Helper function to cancel a workbook's asynchronous calculation, if any
+void CancelActiveCalculation(WorkbookContext& context) {
+    std::lock_guard<std::mutex> lock(context.jobMutex);
+    if (std::shared_ptr<CalculationJob> job = context.activeJob.lock()) {
+        job->progress.cancel();
+    }
+}
 
-// Helper function to get a workbook by handle
-Workbook* GetWorkbook(int workbookHandle) {
-    auto it = g_workbooks.find(workbookHandle);
-    if (it == g_workbooks.end()) {
+// Helper function to get a workbook context by handle; fails for closed workbooks
+std::shared_ptr<WorkbookContext> GetWorkbookContext(int workbookHandle) {
+    std::shared_ptr<WorkbookContext> context = g_workbooks.find(workbookHandle);
+    if (!context) {
         throw std::runtime_error("Invalid workbook handle");
     }
-    return it->second.get();
+    return context;
+}
+
+// Read access to a workbook for the duration of a call
+struct WorkbookReader {
+    std::shared_ptr<WorkbookContext> context;
+    std::shared_lock<std::shared_mutex> lock;
+
+    explicit WorkbookReader(std::shared_ptr<WorkbookContext> workbookContext)
+        : context(std::move(workbookContext)), lock(context->access) {}
+    explicit WorkbookReader(int workbookHandle) : WorkbookReader(GetWorkbookContext(workbookHandle)) {}
+};
+
+// Exclusive access to a workbook for the duration of a call. Cell edits pass
+// supersedesCalculation, so they cancel a background recalculation of stale
+// data instead of waiting for it.
+struct WorkbookWriter {
+    std::shared_ptr<WorkbookContext> context;
+    std::unique_lock<std::mutex> writerLock;
+    std::unique_lock<std::shared_mutex> lock;
+
+    explicit WorkbookWriter(std::shared_ptr<WorkbookContext> workbookContext, bool supersedesCalculation = false)
+        : context(std::move(workbookContext)) {
+        if (supersedesCalculation) {
+            CancelActiveCalculation(*context);
+        }
+        writerLock = std::unique_lock<std::mutex>(context->writer);
+        lock = std::unique_lock<std::shared_mutex>(context->access);
+    }
+    explicit WorkbookWriter(int workbookHandle, bool supersedesCalculation = false)
+        : WorkbookWriter(GetWorkbookContext(workbookHandle), supersedesCalculation) {}
+};
+
+// Helper function to get a pin by handle
+std::shared_ptr<ColumnPin> GetColumnPin(int pinHandle) {
+    std::shared_ptr<ColumnPin> pin = g_columnPins.find(pinHandle);
+    if (!pin) {
+        throw std::runtime_error("Invalid pin handle");
+    }
+    return pin;
+}
+
+// Helper function to describe the chunks of a pinned column, which are all dense
+std::vector<ExcelColumnSegment> GetColumnSegments(const ExcelCore::ColumnStore& values, uint32_t column) {
+    std::vector<ExcelColumnSegment> segments;
+    for (uint32_t chunkIndex = 0; chunkIndex < values.getChunkCount(column); ++chunkIndex) {
+        const ExcelCore::ColumnChunk* chunk = values.getChunk(column, chunkIndex);
+        if (chunk != nullptr) {
+            segments.push_back(ExcelColumnSegment{chunkIndex * ExcelCore::ColumnChunk::kRows, ExcelCore::ColumnChunk::kRows,
+                                                  chunk->numbers(), chunk->types(), static_cast<int32_t>(sizeof(double))});
+        }
+    }
+    return segments;
+}
+
+// Helper function to parse "A1:C100" (or a single cell) into ordered corners
+void ParseRange(const char* range, CellAddress& first, CellAddress& last) {
+    if (range == nullptr) {
+        throw std::invalid_argument("Range must not be null");
+    }
+    std::string text(range);
+    size_t colon = text.find(':');
+    CellAddress a = CellAddress::fromString(text.substr(0, colon));
+    CellAddress b = colon == std::string::npos ? a : CellAddress::fromString(text.substr(colon + 1));
+    first = CellAddress(std::min(a.row, b.row), std::min(a.column, b.column));
+    last = CellAddress(std::max(a.row, b.row), std::max(a.column, b.column));
+}
+
+// Helper function to count the cells of a range transferred in one call
+size_t GetRangeCellCount(const CellAddress& first, const CellAddress& last) {
+    uint64_t count = static_cast<uint64_t>(last.row - first.row + 1) * (last.column - first.column + 1);
+    if (count > static_cast<uint64_t>(std::numeric_limits<int32_t>::max() - 1)) {
+        throw std::invalid_argument("Range is too large for a single transfer");
+    }
+    return static_cast<size_t>(count);
+}
+
+// Helper function to import delimited text into a new worksheet. The text is
+// parsed into a detached worksheet that shares the workbook's string pool, so
+// the workbook is locked only to append it.
+static int ImportCsv(int workbookHandle, const char* worksheetName, char delimiter,
+                     const std::function<size_t(ExcelCore::CsvReader&, Worksheet&)>& read) {
+    if (worksheetName == nullptr) {
+        throw std::invalid_argument("Worksheet name must not be null");
+    }
+    std::shared_ptr<ExcelCore::StringPool> strings = WorkbookReader(workbookHandle).context->workbook->stringPool;
+    Worksheet worksheet(strings);
+    worksheet.setName(worksheetName);
+    ExcelCore::CsvOptions options;
+    options.delimiter = delimiter;
+    ExcelCore::CsvReader reader(options);
+    read(reader, worksheet);
+
+    // The new worksheet holds no formulas, so the engine has nothing to update
+    WorkbookWriter access(workbookHandle, true);
+    Workbook* workbook = access.context->workbook.get();
+    workbook->worksheets.push_back(std::move(worksheet));
+    return static_cast<int>(workbook->getWorksheetCount() - 1);
+}
+
+// Runs on the job pool: the same two phases as CalculateWorkbook, with
+// progress and cancellation checked between cells
+static void RunCalculationJob(int jobId, const std::shared_ptr<CalculationJob>& job) {
+    ExcelCalculationStatus status = ExcelCalculationCompleted;
+    try {
+        WorkbookContext& context = *job->context;
+        std::lock_guard<std::mutex> writerLock(context.writer);
+        if (!job->progress.isCancelled()) {
+            {
+                std::unique_lock<std::shared_mutex> lock(context.access);
+                context.engine->prepareRecalculation();
+            }
+            std::shared_lock<std::shared_mutex> lock(context.access);
+            context.engine->runPreparedRecalculation(&job->progress);
+        }
+        if (job->progress.isCancelled()) {
+            status = ExcelCalculationCancelled;
+        }
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in CalculateWorkbookAsync: " << e.what() << std::endl;
+        status = ExcelCalculationFailed;
+    }
+
+    g_calculationJobs.remove(jobId);
+    if (job->callback != nullptr) {
+        job->callback(jobId, status, job->userData);
+    }
 }
 
 extern "C" {
@@ -26,16 +223,14 @@ extern "C" {
 EXCELCORE_API int CreateWorkbook(const char* name) {
     try {
         // Create a new Workbook object with the given name
-        auto workbook = std::make_unique<Workbook>(name);
-        
-        // Generate a unique handle for the workbook
-        int handle = g_nextWorkbookHandle++;
+        auto context = std::make_shared<WorkbookContext>();
+        context->workbook = std::make_shared<Workbook>(name);
+        context->engine = std::make_unique<CalculationEngine>();
+        context->engine->setWorkbook(context->workbook);
         
-        // Store the Workbook object in the g_workbooks map using the handle as the key
-        g_workbooks[handle] = std::move(workbook);
-        
-        // Return the handle
-        return handle;
+        // Register the context; the handle carries a generation, so it never
+        // aliases a workbook created after this one is closed
+        return g_workbooks.add(std::move(context));
     } catch (const std::exception& e) {
         // Log the error (implement proper logging)
         std::cerr << "Error in CreateWorkbook: " << e.what() << std::endl;
@@ -43,13 +238,145 @@ EXCELCORE_API int CreateWorkbook(const char* name) {
     }
 }
 
+EXCELCORE_API bool CloseWorkbook(int workbookHandle) {
+    try {
+        // The handle stops working at once; calls already inside the workbook
+        // (and pinned columns) keep it alive until they finish
+        std::shared_ptr<WorkbookContext> context = g_workbooks.remove(workbookHandle);
+        if (!context) {
+            throw std::runtime_error("Invalid workbook handle");
+        }
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in CloseWorkbook: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API int OpenWorkbookFile(const char* path) {
+    try {
+        if (path == nullptr) {
+            throw std::invalid_argument("Path must not be null");
+        }
+        // Name the workbook after the file, without directory and extension
+        std::string name(path);
+        size_t slash = name.find_last_of("/\\");
+        if (slash != std::string::npos) {
+            name.erase(0, slash + 1);
+        }
+        size_t dot = name.rfind('.');
+        if (dot != std::string::npos && dot > 0) {
+            name.erase(dot);
+        }
+
+        // The workbook is loaded before it is registered, so no lock is needed
+        auto context = std::make_shared<WorkbookContext>();
+        context->workbook = std::make_shared<Workbook>(name);
+        ExcelCore::XlsxReader reader(path);
+        reader.read(*context->workbook);
+        context->engine = std::make_unique<CalculationEngine>();
+        context->engine->setWorkbook(context->workbook);
+
+        return g_workbooks.add(std::move(context));
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in OpenWorkbookFile: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API bool SaveWorkbookFile(int workbookHandle, const char* path) {
+    try {
+        if (path == nullptr) {
+            throw std::invalid_argument("Path must not be null");
+        }
+        // Saving only reads the workbook
+        WorkbookReader access(workbookHandle);
+        ExcelCore::XlsxWriter writer(path);
+        writer.write(*access.context->workbook);
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SaveWorkbookFile: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool SaveSnapshot(int workbookHandle, const char* path) {
+    try {
+        if (path == nullptr) {
+            throw std::invalid_argument("Path must not be null");
+        }
+        // The writer lock waits out a background calculation; the snapshot
+        // includes the engine's dirty cells, so it must not change meanwhile
+        WorkbookWriter access(workbookHandle);
+        access.context->engine->saveSnapshot(path);
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SaveSnapshot: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API int OpenSnapshot(const char* path) {
+    try {
+        if (path == nullptr) {
+            throw std::invalid_argument("Path must not be null");
+        }
+        // The workbook is loaded before it is registered, so no lock is needed
+        auto context = std::make_shared<WorkbookContext>();
+        context->engine = std::make_unique<CalculationEngine>();
+        context->workbook = context->engine->openSnapshot(path);
+
+        return g_workbooks.add(std::move(context));
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in OpenSnapshot: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API int ImportCsvFile(int workbookHandle, const char* path, const char* worksheetName, char delimiter) {
+    try {
+        if (path == nullptr) {
+            throw std::invalid_argument("Path must not be null");
+        }
+        return ImportCsv(workbookHandle, worksheetName, delimiter,
+                         [path](ExcelCore::CsvReader& reader, Worksheet& worksheet) { return reader.readFile(path, worksheet); });
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in ImportCsvFile: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API int ImportCsvBuffer(int workbookHandle, const char* data, int64_t size, const char* worksheetName,
+                                  char delimiter) {
+    try {
+        if (data == nullptr || size < 0) {
+            throw std::invalid_argument("Invalid CSV buffer");
+        }
+        std::string_view text(data, static_cast<size_t>(size));
+        return ImportCsv(workbookHandle, worksheetName, delimiter,
+                         [text](ExcelCore::CsvReader& reader, Worksheet& worksheet) { return reader.read(text, worksheet); });
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in ImportCsvBuffer: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
 EXCELCORE_API int AddWorksheet(int workbookHandle, const char* name) {
     try {
-        // Retrieve the Workbook object using the workbookHandle from g_workbooks
-        Workbook* workbook = GetWorkbook(workbookHandle);
+        // Adding a worksheet may move the others, so it needs exclusive access
+        WorkbookWriter access(workbookHandle);
+        Workbook* workbook = access.context->workbook.get();
         
         // Call the addWorksheet method on the Workbook object with the given name
-        int worksheetIndex = workbook->addWorksheet(name);
+        workbook->addWorksheet(name);
+        int worksheetIndex = static_cast<int>(workbook->getWorksheetCount() - 1);
         
         // Return the index of the newly added worksheet
         return worksheetIndex;
@@ -62,20 +389,18 @@ EXCELCORE_API int AddWorksheet(int workbookHandle, const char* name) {
 
 EXCELCORE_API bool SetCellValue(int workbookHandle, int worksheetIndex, const char* cellAddress, const char* value) {
     try {
-        // Retrieve the Workbook object using the workbookHandle from g_workbooks
-        Workbook* workbook = GetWorkbook(workbookHandle);
-        
-        // Get the Worksheet object at the specified worksheetIndex
-        Worksheet* worksheet = workbook->getWorksheet(worksheetIndex);
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle, true);
+        WorkbookContext& context = *access.context;
         
         // Parse the cellAddress string to create a CellAddress object
         CellAddress address = CellAddress::fromString(cellAddress);
         
-        // Create a CellValue object from the provided value string
-        CellValue cellValue(value);
+        // Create a CellValue object from the provided value string, interned in the workbook's pool
+        CellValue cellValue(*context.workbook->stringPool, value ? value : "");
         
-        // Set the cell value using the parsed address and created CellValue
-        worksheet->setCellValue(address, cellValue);
+        // Set the cell value through the engine so its dependents are marked dirty
+        context.engine->setCellValue(worksheetIndex, address, cellValue);
         
         return true;
     } catch (const std::exception& e) {
@@ -87,17 +412,18 @@ EXCELCORE_API bool SetCellValue(int workbookHandle, int worksheetIndex, const ch
 
 EXCELCORE_API bool GetCellValue(int workbookHandle, int worksheetIndex, const char* cellAddress, char* buffer, int bufferSize) {
     try {
-        // Retrieve the Workbook object using the workbookHandle from g_workbooks
-        Workbook* workbook = GetWorkbook(workbookHandle);
+        // Retrieve the Workbook object using the workbookHandle, locked for reading
+        WorkbookReader access(workbookHandle);
+        Workbook* workbook = access.context->workbook.get();
         
         // Get the Worksheet object at the specified worksheetIndex
-        Worksheet* worksheet = workbook->getWorksheet(worksheetIndex);
+        Worksheet& worksheet = workbook->getWorksheet(worksheetIndex);
         
         // Parse the cellAddress string to create a CellAddress object
         CellAddress address = CellAddress::fromString(cellAddress);
         
         // Get the cell value using the parsed address
-        CellValue cellValue = worksheet->getCellValue(address);
+        CellValue cellValue = worksheet.getCellValue(address);
         
         // Convert the cell value to a string
         std::string valueStr = cellValue.toString();
@@ -116,17 +442,15 @@ EXCELCORE_API bool GetCellValue(int workbookHandle, int worksheetIndex, const ch
 
 EXCELCORE_API bool SetCellFormula(int workbookHandle, int worksheetIndex, const char* cellAddress, const char* formula) {
     try {
-        // Retrieve the Workbook object using the workbookHandle from g_workbooks
-        Workbook* workbook = GetWorkbook(workbookHandle);
-        
-        // Get the Worksheet object at the specified worksheetIndex
-        Worksheet* worksheet = workbook->getWorksheet(worksheetIndex);
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle, true);
+        WorkbookContext& context = *access.context;
         
         // Parse the cellAddress string to create a CellAddress object
         CellAddress address = CellAddress::fromString(cellAddress);
         
-        // Set the cell formula using the parsed address and provided formula
-        worksheet->setCellFormula(address, formula);
+        // Set the cell formula through the engine so the dependency graph stays current
+        context.engine->setCellFormula(worksheetIndex, address, formula);
         
         return true;
     } catch (const std::exception& e) {
@@ -136,18 +460,236 @@ EXCELCORE_API bool SetCellFormula(int workbookHandle, int worksheetIndex, const
     }
 }
 
+EXCELCORE_API bool SetRangeValues(int workbookHandle, int worksheetIndex, const char* range,
+                                  const uint8_t* types, const double* numbers, const char* text, const int32_t* offsets) {
+    try {
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle, true);
+        WorkbookContext& context = *access.context;
+
+        CellAddress first;
+        CellAddress last;
+        ParseRange(range, first, last);
+        size_t count = GetRangeCellCount(first, last);
+
+        // Build the values up front so a malformed cell leaves the worksheet untouched
+        ExcelCore::StringPool& pool = *context.workbook->stringPool;
+        std::vector<CellValue> values(count);
+        for (size_t i = 0; i < count; ++i) {
+            CellType type = types ? static_cast<CellType>(types[i]) : CellType::Number;
+            double number = numbers ? numbers[i] : 0.0;
+            switch (type) {
+                case CellType::String:
+                    if (text == nullptr || offsets == nullptr || offsets[i] < 0 || offsets[i + 1] < offsets[i]) {
+                        throw std::invalid_argument("Invalid string offsets");
+                    }
+                    values[i] = CellValue(pool, std::string_view(text + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i])));
+                    break;
+                case CellType::Number:
+                    values[i] = CellValue(number);
+                    break;
+                case CellType::Boolean:
+                    values[i] = CellValue(number != 0.0);
+                    break;
+                case CellType::Date:
+                    values[i] = CellValue::fromDateSeconds(number);
+                    break;
+                case CellType::Error:
+                    if (!(number >= static_cast<double>(ErrorCode::Null) && number <= static_cast<double>(ErrorCode::NA))) {
+                        throw std::invalid_argument("Invalid error code");
+                    }
+                    values[i] = CellValue::error(static_cast<ErrorCode>(static_cast<uint8_t>(number)));
+                    break;
+                case CellType::Empty:
+                    break;
+                default:
+                    throw std::invalid_argument("Invalid cell type tag");
+            }
+        }
+
+        // One engine call marks every written cell dirty
+        context.engine->setRangeValues(worksheetIndex, first, last.column - first.column + 1, values.data(), count);
+
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SetRangeValues: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API int GetRangeValues(int workbookHandle, int worksheetIndex, const char* range,
+                                 uint8_t* types, double* numbers, char* text, int textCapacity, int32_t* offsets) {
+    try {
+        if (types == nullptr || numbers == nullptr || offsets == nullptr) {
+            throw std::invalid_argument("Output arrays must not be null");
+        }
+
+        // Retrieve the Workbook object using the workbookHandle, locked for reading
+        WorkbookReader access(workbookHandle);
+        Workbook* workbook = access.context->workbook.get();
+        const Worksheet& worksheet = workbook->getWorksheet(worksheetIndex);
+
+        CellAddress first;
+        CellAddress last;
+        ParseRange(range, first, last);
+        size_t count = GetRangeCellCount(first, last);
+        uint32_t columnCount = last.column - first.column + 1;
+
+        std::fill(types, types + count, static_cast<uint8_t>(CellType::Empty));
+        std::fill(numbers, numbers + count, 0.0);
+
+        // Walk the stored cells column by column (empty cells cost nothing) and
+        // remember string IDs; the text is laid out row-major afterwards
+        std::vector<uint32_t> stringIds;
+        for (uint32_t column = first.column; column <= last.column && column < worksheet.values.getColumnCount(); ++column) {
+            worksheet.values.forEachCell(column, first.row, last.row, [&](const CellAddress& address, const CellValue& value) {
+                size_t index = static_cast<size_t>(address.row - first.row) * columnCount + (address.column - first.column);
+                types[index] = static_cast<uint8_t>(value.getType());
+                switch (value.getType()) {
+                    case CellType::String:
+                        if (stringIds.empty()) {
+                            stringIds.resize(count);
+                        }
+                        stringIds[index] = value.getStringId();
+                        break;
+                    case CellType::Date:
+                        numbers[index] = value.getDateSeconds();
+                        break;
+                    case CellType::Error:
+                        numbers[index] = static_cast<double>(value.getErrorCode());
+                        break;
+                    default:
+                        numbers[index] = value.getNumber();
+                        break;
+                }
+            });
+        }
+
+        // Offsets first, so the caller learns the size even when the buffer is short
+        const ExcelCore::StringPool& pool = *workbook->stringPool;
+        int64_t total = 0;
+        offsets[0] = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!stringIds.empty() && stringIds[i] != 0) {
+                total += static_cast<int64_t>(pool.get(stringIds[i]).size());
+                if (total > std::numeric_limits<int32_t>::max()) {
+                    throw std::length_error("Range text exceeds 2 GB");
+                }
+            }
+            offsets[i + 1] = static_cast<int32_t>(total);
+        }
+        if (text != nullptr && total > 0 && total <= textCapacity) {
+            for (size_t i = 0; i < count; ++i) {
+                if (offsets[i + 1] > offsets[i]) {
+                    const std::string& string = pool.get(stringIds[i]);
+                    std::memcpy(text + offsets[i], string.data(), string.size());
+                }
+            }
+        }
+
+        return static_cast<int>(total);
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in GetRangeValues: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API int PinColumn(int workbookHandle, int worksheetIndex, int column, uint64_t* generation) {
+    try {
+        if (column < 0 || static_cast<uint32_t>(column) >= ExcelCore::kMaxColumns) {
+            throw std::invalid_argument("Column index out of range");
+        }
+
+        // Pinning changes chunk layout, so it needs exclusive access
+        WorkbookWriter access(workbookHandle);
+        Workbook* workbook = access.context->workbook.get();
+        ExcelCore::ColumnStore& values = workbook->getWorksheet(worksheetIndex).values;
+
+        // Pinning makes the column's chunks dense, so each one is a plain array
+        auto pin = std::make_shared<ColumnPin>(ColumnPin{access.context, worksheetIndex, static_cast<uint32_t>(column)});
+        values.pin(pin->column);
+        if (generation != nullptr) {
+            *generation = values.getGeneration(pin->column);
+        }
+
+        int handle = g_columnPins.add(pin);
+        return handle;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in PinColumn: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API int GetPinnedSegments(int pinHandle, ExcelColumnSegment* segments, int segmentCapacity) {
+    try {
+        // Listed afresh, so chunks the column gained since it was pinned show up
+        std::shared_ptr<ColumnPin> pin = GetColumnPin(pinHandle);
+        WorkbookReader access(pin->context);
+        std::vector<ExcelColumnSegment> current =
+            GetColumnSegments(access.context->workbook->getWorksheet(pin->worksheetIndex).values, pin->column);
+        int count = static_cast<int>(current.size());
+        if (segments != nullptr && segmentCapacity > 0) {
+            std::copy_n(current.begin(), std::min(count, segmentCapacity), segments);
+        }
+        return count;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in GetPinnedSegments: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API bool GetColumnGeneration(int pinHandle, uint64_t* generation) {
+    try {
+        if (generation == nullptr) {
+            throw std::invalid_argument("Generation must not be null");
+        }
+        std::shared_ptr<ColumnPin> pin = GetColumnPin(pinHandle);
+        WorkbookReader access(pin->context);
+        *generation = access.context->workbook->getWorksheet(pin->worksheetIndex).values.getGeneration(pin->column);
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in GetColumnGeneration: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool ReleaseColumn(int pinHandle) {
+    try {
+        std::shared_ptr<ColumnPin> pin = g_columnPins.remove(pinHandle);
+        if (!pin) {
+            throw std::runtime_error("Invalid pin handle");
+        }
+        // Works after CloseWorkbook too: the pin still owns its workbook
+        WorkbookWriter access(pin->context);
+        access.context->workbook->getWorksheet(pin->worksheetIndex).values.unpin(pin->column);
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in ReleaseColumn: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 EXCELCORE_API bool CalculateWorkbook(int workbookHandle) {
     try {
-        // Retrieve the Workbook object using the workbookHandle from g_workbooks
-        Workbook* workbook = GetWorkbook(workbookHandle);
+        // Edits wait for the whole recalculation; readers only for its preparation
+        std::shared_ptr<WorkbookContext> context = GetWorkbookContext(workbookHandle);
+        std::lock_guard<std::mutex> writerLock(context->writer);
+        {
+            std::unique_lock<std::shared_mutex> lock(context->access);
+            context->engine->prepareRecalculation();
+        }
         
-        // Create a CalculationEngine object
-        CalculationEngine calcEngine;
+        // Recalculate only the cells dirtied since the previous calculation
+        std::shared_lock<std::shared_mutex> lock(context->access);
+        context->engine->runPreparedRecalculation();
         
-        // Call the calculate method of the CalculationEngine, passing the Workbook object
-        bool success = calcEngine.calculate(*workbook);
-        
-        return success;
+        return true;
     } catch (const std::exception& e) {
         // Log the error (implement proper logging)
         std::cerr << "Error in CalculateWorkbook: " << e.what() << std::endl;
@@ -155,11 +697,235 @@ EXCELCORE_API bool CalculateWorkbook(int workbookHandle) {
     }
 }
 
+EXCELCORE_API int CalculateWorkbookAsync(int workbookHandle, ExcelCalculationCallback callback, void* userData) {
+    try {
+        auto job = std::make_shared<CalculationJob>();
+        job->context = GetWorkbookContext(workbookHandle);
+        job->callback = callback;
+        job->userData = userData;
+
+        // A newer calculation makes an older one pointless
+        {
+            std::lock_guard<std::mutex> lock(job->context->jobMutex);
+            if (std::shared_ptr<CalculationJob> previous = job->context->activeJob.lock()) {
+                previous->progress.cancel();
+            }
+            job->context->activeJob = job;
+        }
+
+        int jobId = g_calculationJobs.add(job);
+        GetCalculationJobPool().submit([jobId, job] { RunCalculationJob(jobId, job); });
+        return jobId;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in CalculateWorkbookAsync: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API bool GetCalculationProgress(int jobId, int64_t* completedCells, int64_t* totalCells) {
+    try {
+        std::shared_ptr<CalculationJob> job = g_calculationJobs.find(jobId);
+        if (!job) {
+            throw std::runtime_error("Invalid or finished calculation job");
+        }
+        if (completedCells != nullptr) {
+            *completedCells = static_cast<int64_t>(job->progress.getCompleted());
+        }
+        if (totalCells != nullptr) {
+            *totalCells = static_cast<int64_t>(job->progress.getTotal());
+        }
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in GetCalculationProgress: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool CancelCalculation(int jobId) {
+    try {
+        std::shared_ptr<CalculationJob> job = g_calculationJobs.find(jobId);
+        if (!job) {
+            throw std::runtime_error("Invalid or finished calculation job");
+        }
+        job->progress.cancel();
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in CancelCalculation: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool SetCalculationThreads(int workbookHandle, int threadCount) {
+    try {
+        if (threadCount < 0) {
+            throw std::invalid_argument("Thread count must not be negative");
+        }
+
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle);
+        WorkbookContext& context = *access.context;
+        
+        // The setting applies to every subsequent CalculateWorkbook call
+        context.engine->setCalculationThreads(static_cast<size_t>(threadCount));
+        
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SetCalculationThreads: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Function to switch SUM/AVERAGE to Kahan-compensated summation
+EXCELCORE_API bool SetCompensatedSummation(int workbookHandle, bool enabled) {
+    try {
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle);
+        WorkbookContext& context = *access.context;
+
+        // Applies to cells evaluated by subsequent calculations
+        context.engine->setSummationMode(enabled ? SummationMode::Compensated : SummationMode::Fast);
+
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SetCompensatedSummation: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool SetIterationLimits(int workbookHandle, int maxIterations, double tolerance) {
+    try {
+        if (maxIterations <= 0) {
+            throw std::invalid_argument("Iteration count must be positive");
+        }
+        // Retrieve the workbook context using the workbookHandle, locked for writing
+        WorkbookWriter access(workbookHandle);
+
+        // Applies to cycles evaluated by subsequent calculations
+        access.context->engine->setIterationLimits(static_cast<size_t>(maxIterations), tolerance);
+
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SetIterationLimits: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API int CreateChart(int workbookHandle, int worksheetIndex, const char* range, int chartType, const char* title) {
+    try {
+        if (chartType < ExcelChartBar || chartType > ExcelChartPie) {
+            throw std::invalid_argument("Unknown chart type");
+        }
+        CellAddress first;
+        CellAddress last;
+        ParseRange(range, first, last);
+
+        // Subscribing to recalculations needs the engine to itself
+        WorkbookWriter access(workbookHandle);
+        WorkbookContext& context = *access.context;
+        const Worksheet& worksheet = context.workbook->getWorksheet(worksheetIndex);
+        int chartHandle = context.charts.createChart(worksheet, first, last, static_cast<ChartType>(chartType),
+                                                     title != nullptr ? title : "");
+        context.charts.subscribeChart(*context.charts.getChart(chartHandle), *context.engine,
+                                      static_cast<size_t>(worksheetIndex));
+        return chartHandle;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in CreateChart: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+EXCELCORE_API bool DeleteChart(int workbookHandle, int chartHandle) {
+    try {
+        std::shared_ptr<WorkbookContext> context = GetWorkbookContext(workbookHandle);
+        std::lock_guard<std::mutex> writerLock(context->writer);
+        if (!context->charts.deleteChart(chartHandle)) {
+            throw std::runtime_error("Invalid chart handle");
+        }
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in DeleteChart: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool SetChartSize(int workbookHandle, int chartHandle, int width, int height) {
+    try {
+        if (width <= 0 || height <= 0) {
+            throw std::invalid_argument("Chart size must be positive");
+        }
+        std::shared_ptr<WorkbookContext> context = GetWorkbookContext(workbookHandle);
+        std::lock_guard<std::mutex> writerLock(context->writer);
+        std::shared_ptr<Chart> chart = context->charts.getChart(chartHandle);
+        if (!chart) {
+            throw std::runtime_error("Invalid chart handle");
+        }
+        chart->setSize(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in SetChartSize: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+EXCELCORE_API bool RenderCharts(int workbookHandle, const int* chartHandles, int count, int format, int threadCount,
+                                ExcelChartOutputCallback callback, void* userData) {
+    try {
+        if (count < 0 || (count > 0 && chartHandles == nullptr) || callback == nullptr) {
+            throw std::invalid_argument("Invalid chart batch");
+        }
+        if (format != ExcelRenderPng && format != ExcelRenderSvg) {
+            throw std::invalid_argument("Unknown render format");
+        }
+        if (threadCount < 0) {
+            throw std::invalid_argument("Thread count must not be negative");
+        }
+
+        // Recalculation patches charts, so it waits for rendering; reads do not
+        std::shared_ptr<WorkbookContext> context = GetWorkbookContext(workbookHandle);
+        std::vector<std::vector<uint8_t>> outputs;
+        {
+            std::lock_guard<std::mutex> writerLock(context->writer);
+            std::vector<std::shared_ptr<Chart>> charts;
+            std::vector<Chart*> batch;
+            std::unordered_set<int> seen;
+            charts.reserve(static_cast<size_t>(count));
+            batch.reserve(static_cast<size_t>(count));
+            for (int i = 0; i < count; ++i) {
+                if (!seen.insert(chartHandles[i]).second) {
+                    throw std::invalid_argument("Chart appears twice in the batch");
+                }
+                charts.push_back(context->charts.getChart(chartHandles[i]));
+                if (!charts.back()) {
+                    throw std::runtime_error("Invalid chart handle");
+                }
+                batch.push_back(charts.back().get());
+            }
+            outputs = context->charts.renderCharts(batch, static_cast<RenderFormat>(format), static_cast<size_t>(threadCount));
+        }
+
+        // The host may call back into the library from the callback
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            callback(static_cast<int>(i), outputs[i].data(), static_cast<int64_t>(outputs[i].size()), userData);
+        }
+        return true;
+    } catch (const std::exception& e) {
+        // Log the error (implement proper logging)
+        std::cerr << "Error in RenderCharts: " << e.what() << std::endl;
+        return false;
+    }
+}
+
 } // extern "C"
 
 // TODO: Implement proper error handling and logging for all functions
-// TODO: Add support for multi-threading in the CalculateWorkbook function
-// TODO: Implement memory management and resource cleanup functions
-// TODO: Add functions for chart creation and manipulation
-// TODO: Implement functions for importing and exporting Excel file formats
+// TODO: Support the legacy binary XLS format
 // TODO: Optimize performance for large workbooks and complex calculations
\ No newline at end of file
@@ -3,6 +3,7 @@
 #ifndef EXCELCORE_DLL_H
 #define EXCELCORE_DLL_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -22,6 +23,34 @@ extern "C" {
 // Function to create a new workbook
 EXCELCORE_API int CreateWorkbook(const char* name);
 
+// Function to close a workbook and release its memory. Its handle is invalid
+// afterwards; a handle is never reused for another workbook.
+EXCELCORE_API bool CloseWorkbook(int workbookHandle);
+
+// Function to open an XLSX file as a new workbook. Returns a workbook handle,
+// or -1 on failure. Formula results saved in the file are kept as they are.
+EXCELCORE_API int OpenWorkbookFile(const char* path);
+
+// Function to save a workbook as an XLSX file, replacing any existing file
+EXCELCORE_API bool SaveWorkbookFile(int workbookHandle, const char* path);
+
+// Function to save a workbook as a native snapshot, which reopens far faster
+// than XLSX. Waits for a running calculation so the stored results are consistent.
+EXCELCORE_API bool SaveSnapshot(int workbookHandle, const char* path);
+
+// Function to open a snapshot written by SaveSnapshot as a new workbook. Returns
+// a workbook handle, or -1 on failure. Values are read from the file on demand.
+EXCELCORE_API int OpenSnapshot(const char* path);
+
+// Function to import a CSV file into a new worksheet named worksheetName. Use ','
+// or '\t' (TSV) as the delimiter; the file is UTF-8. Returns the index of the
+// worksheet, or -1 on failure. Large files are parsed on several threads.
+EXCELCORE_API int ImportCsvFile(int workbookHandle, const char* path, const char* worksheetName, char delimiter);
+
+// Function to import CSV text held in memory (size bytes), as ImportCsvFile
+EXCELCORE_API int ImportCsvBuffer(int workbookHandle, const char* data, int64_t size, const char* worksheetName,
+                                  char delimiter);
+
 // Function to add a new worksheet to a workbook
 EXCELCORE_API int AddWorksheet(int workbookHandle, const char* name);
 
@@ -34,15 +63,124 @@ EXCELCORE_API bool GetCellValue(int workbookHandle, int worksheetIndex, const ch
 // Function to set a formula for a cell
 EXCELCORE_API bool SetCellFormula(int workbookHandle, int worksheetIndex, const char* cellAddress, const char* formula);
 
+// Bulk cell I/O. A range ("A1:C100" or a single cell) is transferred as
+// row-major arrays holding one element per cell:
+//   types   - CellType tags: 0 String, 1 Number, 2 Boolean, 3 Date, 4 Error, 5 Empty
+//   numbers - the number; 1/0 for booleans, seconds for dates, the ErrorCode for errors
+//   text    - the UTF-8 bytes of all strings back to back; the string of cell i is
+//             text[offsets[i], offsets[i + 1]), so offsets holds cellCount + 1 entries
+
+// Function to set a block of cells in one call. types may be null when every
+// cell is a number; text and offsets may be null when no cell is a string.
+EXCELCORE_API bool SetRangeValues(int workbookHandle, int worksheetIndex, const char* range,
+                                  const uint8_t* types, const double* numbers, const char* text, const int32_t* offsets);
+
+// Function to get a block of cells in one call. Returns the number of text bytes
+// the range's strings need, or -1 on failure. Strings are copied only when
+// textCapacity is large enough; offsets are filled either way.
+EXCELCORE_API int GetRangeValues(int workbookHandle, int worksheetIndex, const char* range,
+                                 uint8_t* types, double* numbers, char* text, int textCapacity, int32_t* offsets);
+
+// Zero-copy column access. A pinned column is exposed as the blocks of rows it
+// stores; rows outside every segment are empty. The arrays stay valid until the
+// pin is released, but the engine keeps updating values in place: compare the
+// column generation before and after a scan to detect concurrent writes. Writes
+// past the existing blocks add segments, so after a generation change call
+// GetPinnedSegments again; segments already returned stay valid.
+typedef struct ExcelColumnSegment {
+    uint32_t firstRow;      // zero-based row of the first element
+    uint32_t rowCount;
+    const double* numbers;  // numbers, date seconds and error codes; 0 for other cells
+    const uint8_t* types;   // CellType tag of each row (see the range I/O tags above)
+    int32_t stride;         // bytes between consecutive numbers
+} ExcelColumnSegment;
+
+// Function to pin a column (zero-based index) for direct reads. Returns a pin
+// handle, or -1 on failure; generation receives the column's current generation.
+EXCELCORE_API int PinColumn(int workbookHandle, int worksheetIndex, int column, uint64_t* generation);
+
+// Function to copy a pinned column's current segment descriptors. Returns the
+// number of segments (copying at most segmentCapacity of them), or -1 on failure.
+EXCELCORE_API int GetPinnedSegments(int pinHandle, ExcelColumnSegment* segments, int segmentCapacity);
+
+// Function to read a pinned column's generation, which changes on every write
+EXCELCORE_API bool GetColumnGeneration(int pinHandle, uint64_t* generation);
+
+// Function to release a pin; the segment pointers must not be used afterwards.
+// A pin keeps its workbook's memory alive even after CloseWorkbook.
+EXCELCORE_API bool ReleaseColumn(int pinHandle);
+
 // Function to recalculate all formulas in a workbook
 EXCELCORE_API bool CalculateWorkbook(int workbookHandle);
 
+// Outcome reported to a calculation callback
+typedef enum ExcelCalculationStatus {
+    ExcelCalculationCompleted = 0,
+    ExcelCalculationCancelled = 1,  // cancelled cells stay dirty for the next calculation
+    ExcelCalculationFailed = 2
+} ExcelCalculationStatus;
+
+// Called once on a background thread when an asynchronous calculation ends
+typedef void (*ExcelCalculationCallback)(int jobId, int status, void* userData);
+
+// Function to recalculate a workbook in the background. Returns a job ID at
+// once (or -1 on failure); callback may be null. Reads of the workbook proceed
+// while the job evaluates; an edit made meanwhile cancels the job.
+EXCELCORE_API int CalculateWorkbookAsync(int workbookHandle, ExcelCalculationCallback callback, void* userData);
+
+// Function to read a running job's progress in cells; fails once the job has ended
+EXCELCORE_API bool GetCalculationProgress(int jobId, int64_t* completedCells, int64_t* totalCells);
+
+// Function to request cancellation of a running job; the callback still fires
+EXCELCORE_API bool CancelCalculation(int jobId);
+
+// Function to set the number of threads CalculateWorkbook uses (1 = serial, 0 = one per core)
+EXCELCORE_API bool SetCalculationThreads(int workbookHandle, int threadCount);
+
+// Function to switch SUM/AVERAGE to Kahan-compensated summation
+EXCELCORE_API bool SetCompensatedSummation(int workbookHandle, bool enabled);
+
+// Function to set how circular references are iterated: at most maxIterations
+// passes per cycle, stopping once no result changes by more than tolerance
+EXCELCORE_API bool SetIterationLimits(int workbookHandle, int maxIterations, double tolerance);
+
+// Charts belong to their workbook and are addressed by chart handles, which
+// stay valid until DeleteChart or CloseWorkbook; a deleted chart's handle
+// never refers to a later chart.
+typedef enum ExcelChartType {
+    ExcelChartBar = 0,
+    ExcelChartLine = 1,
+    ExcelChartPie = 2
+} ExcelChartType;
+
+typedef enum ExcelRenderFormat {
+    ExcelRenderPng = 0,
+    ExcelRenderSvg = 1
+} ExcelRenderFormat;
+
+// Function to create a chart of a range ("A1:C100"), one series per column.
+// Returns a chart handle, or -1 on failure. The chart follows recalculations
+// of the range; title may be null.
+EXCELCORE_API int CreateChart(int workbookHandle, int worksheetIndex, const char* range, int chartType, const char* title);
+
+// Function to delete a chart; its handle is invalid afterwards
+EXCELCORE_API bool DeleteChart(int workbookHandle, int chartHandle);
+
+// Function to set the size in pixels a chart is rendered at (640 x 480 by default)
+EXCELCORE_API bool SetChartSize(int workbookHandle, int chartHandle, int width, int height);
+
+// Receives one rendered chart; the data is only valid during the call
+typedef void (*ExcelChartOutputCallback)(int index, const uint8_t* data, int64_t size, void* userData);
+
+// Function to render count charts as PNG or SVG on up to threadCount threads
+// (0 = one per core). Once every chart has rendered, callback is called on the
+// calling thread with each output in order. A chart may appear only once.
+EXCELCORE_API bool RenderCharts(int workbookHandle, const int* chartHandles, int count, int format, int threadCount,
+                                ExcelChartOutputCallback callback, void* userData);
+
 } // extern "C"
 
 // TODO: Implement error handling and logging mechanism for the DLL interface
-// TODO: Add functions for chart creation and manipulation
-// TODO: Implement memory management and resource cleanup functions
-// TODO: Add support for multi-threading in calculation engine
-// TODO: Implement functions for importing and exporting Excel file formats
+// TODO: Support the legacy binary XLS format
 
 #endif // EXCELCORE_DLL_H
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CompiledFormula.h"
+#include <cstdint>
+#include <vector>
+
+namespace ExcelCore {
+
+// A node of a parsed formula. Leaves are the push operations, inner nodes the
+// operators and function calls; operands index into the constant pools of the
+// CompiledFormula being built, as the instruction operands do.
+struct AstNode {
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    OpCode opcode;
+    uint16_t childCount;        // operands of an operator, arguments of a call
+    uint32_t operand;
+    uint32_t firstChild = kNone;
+    uint32_t nextSibling = kNone;
+};
+
+// A formula's syntax tree in one contiguous array, linked by index. Every node
+// is appended after its children, so the array is in post-order: walking it
+// front to back yields the postfix program, and the root is the last node.
+// Parentheses and unary plus leave no node.
+struct FormulaAst {
+    std::vector<AstNode> nodes;
+
+    uint32_t root() const {
+        return nodes.empty() ? AstNode::kNone : static_cast<uint32_t>(nodes.size() - 1);
+    }
+};
+
+} // namespace ExcelCore
@@ -1,65 +1,859 @@
 #include "FormulaParser.h"
 #include "DataStructures.h"
-#include <stack>
-#include <sstream>
+#include "CompiledFormula.h"
+#include "FormulaAst.h"
+#include "AggregateKernels.h"
+#include "EvaluationArena.h"
 #include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <iterator>
+#include <chrono>
+#include <ctime>
+#include <random>
 
-FormulaParser::FormulaParser(std::shared_ptr<Workbook> workbook) : workbook(workbook) {
+using ExcelCore::FormulaCell;
+using ExcelCore::Worksheet;
+using ExcelCore::OpCode;
+using ExcelCore::Instruction;
+using ExcelCore::AstNode;
+using ExcelCore::FormulaAst;
+using ExcelCore::CellType;
+using ExcelCore::ErrorCode;
+using ExcelCore::AggregateResult;
+using ExcelCore::EvaluationArena;
+using ExcelCore::StringPool;
+using ExcelCore::ScratchVector;
+using ExcelCore::kMaxRows;
+using ExcelCore::kMaxColumns;
+namespace Aggregates = ExcelCore::Aggregates;
+
+namespace {
+
+constexpr double kSecondsPerDay = 86400.0;
+
+// The local wall-clock time as seconds since 1970: dates are stored without a
+// time zone, as Excel serials are, and NOW/TODAY use local time as in Excel
+double localNowSeconds() {
+    auto now = std::chrono::system_clock::now();
+    std::time_t time = std::chrono::system_clock::to_time_t(now);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    double fraction = std::chrono::duration<double>(now - std::chrono::system_clock::from_time_t(time)).count();
+    return static_cast<double>(ExcelCore::daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday)) * kSecondsPerDay +
+           local.tm_hour * 3600.0 + local.tm_min * 60.0 + local.tm_sec + fraction;
+}
+enum class RangeEndpoint {
+    None,
+    Cell,   // A1, $A$1
+    Column, // A, $A
+    Row     // 1, $1
+};
+
+// Arithmetic operand conversion as in Excel: empty cells are 0, booleans 1/0,
+// dates their serial day number, and text counts only if it is entirely a number
+bool coerceToNumber(const CellValue& value, double& number) {
+    switch (value.getType()) {
+        case CellType::Number:
+        case CellType::Boolean:
+        case CellType::Empty:
+            number = value.getNumber();
+            return true;
+        case CellType::Date:
+            number = ExcelCore::dateSecondsToSerial(value.getDateSeconds());
+            return true;
+        case CellType::String: {
+            const std::string& text = value.getString();
+            char* end = nullptr;
+            number = std::strtod(text.c_str(), &end);
+            return !text.empty() && end == text.c_str() + text.size();
+        }
+        default:
+            return false;
+    }
+}
+
+// Comparison as in Excel: numbers sort before text and text before booleans,
+// text compares without regard to case, and an empty operand stands for 0, ""
+// or FALSE to match the other side. Returns <0, 0 or >0.
+int compareValues(const CellValue& left, const CellValue& right) {
+    auto rank = [](const CellValue& value) {
+        switch (value.getType()) {
+            case CellType::Empty:   return -1;
+            case CellType::String:  return 1;
+            case CellType::Boolean: return 2;
+            default:                return 0;
+        }
+    };
+    int leftRank = rank(left);
+    int rightRank = rank(right);
+    if (leftRank < 0) {
+        leftRank = std::max(rightRank, 0);
+    }
+    if (rightRank < 0) {
+        rightRank = leftRank;
+    }
+    if (leftRank != rightRank) {
+        return leftRank < rightRank ? -1 : 1;
+    }
+    if (leftRank == 1) {
+        const std::string& a = left.getString();
+        const std::string& b = right.getString();
+        size_t length = std::min(a.size(), b.size());
+        for (size_t i = 0; i < length; ++i) {
+            int difference = std::tolower(static_cast<unsigned char>(a[i])) - std::tolower(static_cast<unsigned char>(b[i]));
+            if (difference != 0) {
+                return difference;
+            }
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+    double a = 0;
+    double b = 0;
+    coerceToNumber(left, a);
+    coerceToNumber(right, b);
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+// Numbers join with up to 15 significant digits, as Excel shows them in a
+// General cell; other values as their text
+std::string concatenationText(const CellValue& value) {
+    if (value.getType() != CellType::Number) {
+        return value.toString();
+    }
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value.getNumber(), std::chars_format::general, 15);
+    std::string text(digits, result.ptr);
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    return text;
+}
+
+// Aggregates range arguments straight from column storage and the remaining
+// scalar arguments as one span
+AggregateResult aggregateArguments(ArgumentList<FunctionArgument> args, SummationMode mode) {
+    AggregateResult result;
+    EvaluationArena& arena = EvaluationArena::forThread();
+    EvaluationArena::Scope scope(arena);
+    ScratchVector<CellValue> values(&arena);
+    for (const auto& arg : args) {
+        if (arg.isRange()) {
+            result.merge(arg.getRange().aggregate(mode), mode);
+        } else {
+            values.push_back(arg.getValue());
+        }
+    }
+    if (!values.empty()) {
+        result.merge(Aggregates::aggregateValues(values.data(), values.size(), mode), mode);
+    }
+    return result;
+}
+
+// Classifies one side of a ":" range
+RangeEndpoint rangeEndpointKind(const std::string& token) {
+    size_t i = 0;
+    if (i < token.size() && token[i] == '$') ++i;
+    size_t letterStart = i;
+    while (i < token.size() && std::isalpha(static_cast<unsigned char>(token[i]))) ++i;
+    size_t letters = i - letterStart;
+    if (letters > 3) return RangeEndpoint::None;
+    if (letters > 0 && i == token.size()) return RangeEndpoint::Column;
+    if (letters > 0 && i < token.size() && token[i] == '$') ++i;
+    size_t digitStart = i;
+    while (i < token.size() && std::isdigit(static_cast<unsigned char>(token[i]))) ++i;
+    if (i == digitStart || i != token.size()) return RangeEndpoint::None;
+    if (letters == 0) {
+        // Row numbers start at 1
+        return token.find_first_not_of('0', digitStart) != std::string::npos ? RangeEndpoint::Row : RangeEndpoint::None;
+    }
+    return RangeEndpoint::Cell;
+}
+
+// Whether a token so far is a number mantissa waiting for its exponent
+// ("1E", "1.5e"), so that a following sign is part of the number
+bool isExponentPrefix(const std::string& token) {
+    if (token.size() < 2 || (token.back() != 'E' && token.back() != 'e')) {
+        return false;
+    }
+    bool digits = false;
+    for (size_t i = 0; i + 1 < token.size(); ++i) {
+        if (std::isdigit(static_cast<unsigned char>(token[i]))) {
+            digits = true;
+        } else if (token[i] != '.') {
+            return false;
+        }
+    }
+    return digits;
+}
+
+// Length of the error literal (#DIV/0!, #N/A) starting at position, or 0
+size_t errorLiteralLength(const std::string& formula, size_t position) {
+    for (uint8_t code = static_cast<uint8_t>(ErrorCode::Null); code <= static_cast<uint8_t>(ErrorCode::NA); ++code) {
+        const char* text = ExcelCore::errorCodeText(static_cast<ErrorCode>(code));
+        size_t length = std::strlen(text);
+        if (formula.size() - position >= length &&
+            std::equal(text, text + length, formula.begin() + position, [](char a, char b) {
+                return a == std::toupper(static_cast<unsigned char>(b));
+            })) {
+            return length;
+        }
+    }
+    return 0;
+}
+
+// Tracks how deep recursive evaluation is, so only top-level calls check
+// whether the workbook changed
+class EvaluationDepthGuard {
+public:
+    explicit EvaluationDepthGuard(uint32_t& depth) : depth(depth) {
+        ++depth;
+    }
+    ~EvaluationDepthGuard() {
+        --depth;
+    }
+
+private:
+    uint32_t& depth;
+};
+}
+
+FormulaParser::FormulaParser(std::shared_ptr<Workbook> workbook, std::shared_ptr<FunctionRegistry> functions)
+    : workbook(workbook), functions(std::move(functions)) {
     // Initialize the workbook member variable with the provided workbook
     this->workbook = workbook;
 
-    // Populate the functionMap with built-in Excel functions
-    initializeFunctionMap();
+    // Without a shared registry, use one with the built-in Excel functions
+    if (!this->functions) {
+        this->functions = createFunctionRegistry();
+    }
+}
+
+std::shared_ptr<FunctionRegistry> FormulaParser::createFunctionRegistry() {
+    auto registry = std::make_shared<FunctionRegistry>();
+    registerBuiltInFunctions(*registry);
+    return registry;
+}
+
+CellValue FormulaParser::parseFormula(const std::string& formula, const CellAddress& currentCell, size_t sheetIndex) {
+    // One-off evaluation: compile the formula and run it without caching the program
+    std::shared_ptr<const CompiledFormula> program = compileFormula(formula, currentCell);
+    if (!recursiveEvaluation) {
+        return execute(*program, currentCell, sheetIndex);
+    }
+    if (evaluationDepth == 0) {
+        synchronizeCalculationEpoch();
+    }
+    EvaluationDepthGuard guard(evaluationDepth);
+    return execute(*program, currentCell, sheetIndex);
+}
+
+void FormulaParser::invalidateResults() {
+    ++calculationEpoch;
+}
 
-    // Implement basic arithmetic operations (+, -, *, /, ^)
-    initializeArithmeticOperations();
+// Starts a new epoch if any cell was edited since the last top-level evaluation
+void FormulaParser::synchronizeCalculationEpoch() {
+    uint64_t editVersion = workbook->getEditVersion();
+    if (editVersion != observedEditVersion) {
+        observedEditVersion = editVersion;
+        ++calculationEpoch;
+    }
 }
 
-CellValue FormulaParser::parseFormula(const std::string& formula, const CellAddress& currentCell) {
-    // Remove leading '=' if present
-    std::string cleanFormula = formula;
-    if (!cleanFormula.empty() && cleanFormula[0] == '=') {
-        cleanFormula = cleanFormula.substr(1);
+std::string FormulaParser::stripFormulaPrefix(const std::string& formula) {
+    if (!formula.empty() && formula[0] == '=') {
+        return formula.substr(1);
     }
+    return formula;
+}
 
-    // Tokenize the formula string
-    std::vector<std::string> tokens = tokenizeFormula(cleanFormula);
+void FormulaParser::setRecursiveEvaluation(bool enabled) {
+    recursiveEvaluation = enabled;
+}
 
-    // Convert infix notation to postfix notation using the Shunting Yard algorithm
-    std::vector<std::string> postfixTokens = infixToPostfix(tokens);
+void FormulaParser::setSummationMode(SummationMode mode) {
+    functions->setSummationMode(mode);
+}
 
-    // Evaluate the postfix expression
-    return evaluatePostfix(postfixTokens, currentCell);
+void FormulaParser::registerFunction(const std::string& functionName, std::function<CellValue(ArgumentList<CellValue>)> function,
+                                     const FunctionTraits& traits) {
+    functions->define(functionName, std::move(function), traits);
+    // Results computed with an earlier definition are stale
+    invalidateResults();
 }
 
-void FormulaParser::registerFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function) {
-    // Convert functionName to uppercase for case-insensitive matching
-    std::string upperFunctionName = functionName;
-    std::transform(upperFunctionName.begin(), upperFunctionName.end(), upperFunctionName.begin(), ::toupper);
+void FormulaParser::registerRangeFunction(const std::string& functionName, std::function<CellValue(ArgumentList<FunctionArgument>)> function,
+                                          const FunctionTraits& traits) {
+    functions->define(functionName, std::move(function), traits);
+    invalidateResults();
+}
 
-    // Add the function to the functionMap with the given name
-    functionMap[upperFunctionName] = function;
+bool FormulaParser::isVolatile(const CompiledFormula& program) const {
+    return std::any_of(program.code.begin(), program.code.end(), [this](const Instruction& instruction) {
+        return instruction.opcode == OpCode::CallFunction && instruction.operand < functions->size() &&
+               (*functions)[instruction.operand].traits.isVolatile;
+    });
 }
 
-CellValue FormulaParser::evaluateCell(const CellAddress& cellAddress) {
-    // Retrieve the cell from the workbook
-    Cell* cell = workbook->getCell(cellAddress);
+CellValue FormulaParser::evaluateCell(const CellAddress& cellAddress, size_t sheetIndex) {
+    Worksheet& worksheet = workbook->getWorksheet(sheetIndex);
 
-    if (cell == nullptr) {
-        return CellValue(); // Return an empty CellValue if the cell doesn't exist
+    // If the cell has a formula, evaluate it. When the calculation engine
+    // drives evaluation in dependency order, precedents already hold their
+    // current values and must only be read (workers share the workbook).
+    if (recursiveEvaluation) {
+        FormulaCell* formulaCell = worksheet.findFormulaCell(cellAddress);
+        if (formulaCell != nullptr && formulaCell->hasFormula()) {
+            if (evaluationDepth == 0) {
+                synchronizeCalculationEpoch();
+            }
+            // Shared precedents are computed once per epoch and read afterwards.
+            // Stamping before evaluating also stops a circular reference: the
+            // second visit reads the previous result instead of recursing.
+            if (!formulaCell->hasCurrentResult(calculationEpoch)) {
+                formulaCell->stampResult(calculationEpoch);
+                EvaluationDepthGuard guard(evaluationDepth);
+                CellValue result = execute(getCompiledFormula(*formulaCell, cellAddress), cellAddress, sheetIndex);
+                worksheet.setFormulaResult(cellAddress, result);
+                return result;
+            }
+        }
     }
 
-    // If the cell has a formula, parse and evaluate it
-    if (cell->hasFormula()) {
-        CellValue result = parseFormula(cell->getFormula(), cellAddress);
-        cell->setValue(result);
-        return result;
+    // Otherwise return the stored value (empty if the cell doesn't exist)
+    return worksheet.getCellValue(cellAddress);
+}
+
+const CompiledFormula& FormulaParser::getCompiledFormula(FormulaCell& cell, const CellAddress& address) {
+    if (!cell.compiledFormula) {
+        cell.compiledFormula = internFormula(cell.formula, address);
+        // The shared template renders the text on demand; drop the per-cell copy
+        std::string().swap(cell.formula);
     }
+    return *cell.compiledFormula;
+}
 
-    // If the cell doesn't have a formula, return its current value
-    return cell->getValue();
+std::shared_ptr<const CompiledFormula> FormulaParser::compileFormula(const std::string& formula, const CellAddress& currentCell) const {
+    return compileTokens(tokenizeFormula(stripFormulaPrefix(formula)), currentCell);
+}
+
+std::shared_ptr<const CompiledFormula> FormulaParser::internFormula(const std::string& formula, const CellAddress& currentCell) {
+    std::vector<std::string> tokens = tokenizeFormula(stripFormulaPrefix(formula));
+    return formulaTable.intern(buildTemplateKey(tokens, currentCell), [&]() -> std::shared_ptr<const CompiledFormula> {
+        return compileTokens(tokens, currentCell);
+    });
+}
+
+void FormulaParser::purgeUnusedFormulas() {
+    if (formulaTable.size() < formulaPurgeThreshold) {
+        return;
+    }
+    formulaTable.purgeUnused();
+    formulaPurgeThreshold = std::max(kMinFormulaPurgeSize, 2 * formulaTable.size());
+}
+
+// Rebuilds the template key from the program's own tokens; it matches the key
+// buildTemplateKey produces from the source text
+std::shared_ptr<const CompiledFormula> FormulaParser::adoptFormula(std::shared_ptr<const CompiledFormula> program) {
+    std::string key;
+    for (size_t i = 0; i < program->tokens.size(); ++i) {
+        const std::string& token = program->tokens[i];
+        if (program->tokenReferences[i] >= 0) {
+            key += FormulaTable::toR1C1(program->references[program->tokenReferences[i]]);
+        } else if (program->tokenRanges[i] >= 0) {
+            key += FormulaTable::toR1C1(program->ranges[program->tokenRanges[i]]);
+        } else if (!token.empty() && token.front() == '"') {
+            key += token;
+        } else {
+            std::string upperToken = token;
+            std::transform(upperToken.begin(), upperToken.end(), upperToken.begin(), ::toupper);
+            key += upperToken;
+        }
+        key += '\x1f';
+    }
+    return formulaTable.intern(key, [&]() { return program; });
+}
+
+// A name directly followed by "(" is a function call even if it looks like a
+// cell reference (LOG10, ATAN2)
+bool FormulaParser::isReferenceToken(const std::vector<std::string>& tokens, size_t index) {
+    bool isCall = index + 1 < tokens.size() && tokens[index + 1] == "(";
+    return !isCall && isCellReference(tokens[index]);
+}
+
+// Normalizes a formula to its R1C1 template: references become offsets from
+// the current cell and names are uppercased, so filled-down copies of one
+// formula produce identical keys
+std::string FormulaParser::buildTemplateKey(const std::vector<std::string>& tokens, const CellAddress& currentCell) {
+    std::string key;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const std::string& token = tokens[i];
+        if (isReferenceToken(tokens, i)) {
+            key += FormulaTable::toR1C1(resolveCellReference(token, currentCell));
+        } else if (isRangeToken(token)) {
+            key += FormulaTable::toR1C1(resolveRange(token, currentCell));
+        } else if (!token.empty() && token.front() == '"') {
+            key += token;
+        } else {
+            std::string upperToken = token;
+            std::transform(upperToken.begin(), upperToken.end(), upperToken.begin(), ::toupper);
+            key += upperToken;
+        }
+        key += '\x1f';
+    }
+    return key;
+}
+
+// Top-down operator precedence (Pratt) parser. Each operator has a binding
+// power; an operand is parsed, then operators are taken for as long as they
+// bind at least as tightly as the caller requires. Powers follow Excel:
+// comparisons, &, + -, * /, ^, then negation and %, so -2^2 is 4. Operators of
+// equal power group to the left (2^3^2 is 64). Errors are thrown as
+// std::invalid_argument carrying the message the formula evaluates to.
+class FormulaParser::ExpressionParser {
+public:
+    ExpressionParser(const FormulaParser& owner, const std::vector<std::string>& tokens, CompiledFormula& program)
+        : owner(owner), tokens(tokens), program(program) {}
+
+    FormulaAst parse() {
+        parseExpression(0);
+        if (position < tokens.size()) {
+            throw std::invalid_argument(tokens[position] == ")" ? "Mismatched parentheses"
+                                        : tokens[position] == "," ? "Unexpected argument separator"
+                                        : "Malformed formula");
+        }
+        return std::move(ast);
+    }
+
+private:
+    static constexpr int kPrefixPower = 6;
+    static constexpr int kPostfixPower = 7;
+    // Far deeper than real formulas nest, and shallow enough for the call stack
+    static constexpr uint32_t kMaxNesting = 256;
+
+    const FormulaParser& owner;
+    const std::vector<std::string>& tokens;
+    CompiledFormula& program;
+    FormulaAst ast;
+    size_t position = 0;
+    uint32_t nesting = 0;
+    // References and ranges are numbered in token order, as compileTokens recorded them
+    uint32_t nextReference = 0;
+    uint32_t nextRange = 0;
+
+    static bool findInfixOperator(const std::string& token, int& power, OpCode& opcode) {
+        static const struct {
+            const char* text;
+            int power;
+            OpCode opcode;
+        } kOperators[] = {
+            {"=", 1, OpCode::Equal},     {"<>", 1, OpCode::NotEqual}, {"<", 1, OpCode::Less},
+            {"<=", 1, OpCode::LessEqual}, {">", 1, OpCode::Greater},  {">=", 1, OpCode::GreaterEqual},
+            {"&", 2, OpCode::Concatenate},
+            {"+", 3, OpCode::Add},       {"-", 3, OpCode::Subtract},
+            {"*", 4, OpCode::Multiply},  {"/", 4, OpCode::Divide},
+            {"^", 5, OpCode::Power},
+        };
+        for (const auto& op : kOperators) {
+            if (token == op.text) {
+                power = op.power;
+                opcode = op.opcode;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool peek(const char* text) const {
+        return position < tokens.size() && tokens[position] == text;
+    }
+
+    uint32_t addNode(OpCode opcode, uint32_t operand, uint16_t childCount = 0, uint32_t firstChild = AstNode::kNone) {
+        ast.nodes.push_back(AstNode{opcode, childCount, operand, firstChild, AstNode::kNone});
+        return static_cast<uint32_t>(ast.nodes.size() - 1);
+    }
+
+    uint32_t parseExpression(int minimumPower) {
+        if (++nesting > kMaxNesting) {
+            throw std::invalid_argument("Formula is nested too deeply");
+        }
+        uint32_t left = parsePrefix();
+        while (position < tokens.size()) {
+            if (tokens[position] == "%") {
+                if (kPostfixPower < minimumPower) {
+                    break;
+                }
+                ++position;
+                left = addNode(OpCode::Percent, 0, 1, left);
+                continue;
+            }
+            int power = 0;
+            OpCode opcode = OpCode::Add;
+            if (!findInfixOperator(tokens[position], power, opcode) || power < minimumPower) {
+                break;
+            }
+            ++position;
+            uint32_t right = parseExpression(power + 1);
+            ast.nodes[left].nextSibling = right;
+            left = addNode(opcode, 0, 2, left);
+        }
+        --nesting;
+        return left;
+    }
+
+    uint32_t parsePrefix() {
+        if (position >= tokens.size()) {
+            throw std::invalid_argument("Malformed formula");
+        }
+        const std::string& token = tokens[position];
+        if (token == "-" || token == "+") {
+            ++position;
+            uint32_t operand = parseExpression(kPrefixPower);
+            // Unary plus changes nothing, not even text
+            return token == "-" ? addNode(OpCode::Negate, 0, 1, operand) : operand;
+        }
+        if (token == "(") {
+            ++position;
+            uint32_t inner = parseExpression(0);
+            if (!peek(")")) {
+                throw std::invalid_argument(peek(",") ? "Unexpected argument separator" : "Mismatched parentheses");
+            }
+            ++position;
+            return inner;
+        }
+        if (position + 1 < tokens.size() && tokens[position + 1] == "(" && std::isalpha(static_cast<unsigned char>(token[0]))) {
+            return parseCall();
+        }
+        return parseOperand();
+    }
+
+    uint32_t parseCall() {
+        // A name not registered yet gets an undefined entry: the call yields
+        // #NAME? until the function is registered, without recompiling
+        uint32_t functionId = owner.functions->getId(tokens[position]);
+        position += 2; // the name and the opening parenthesis
+
+        uint32_t firstArgument = AstNode::kNone;
+        uint32_t lastArgument = AstNode::kNone;
+        size_t argumentCount = 0;
+        if (!peek(")")) {
+            while (true) {
+                uint32_t argument = parseExpression(0);
+                if (firstArgument == AstNode::kNone) {
+                    firstArgument = argument;
+                } else {
+                    ast.nodes[lastArgument].nextSibling = argument;
+                }
+                lastArgument = argument;
+                ++argumentCount;
+                if (!peek(",")) {
+                    break;
+                }
+                ++position;
+            }
+        }
+        if (!peek(")")) {
+            throw std::invalid_argument("Mismatched parentheses");
+        }
+        ++position;
+
+        // Built-ins cannot be redefined, so their arity is checked here; custom
+        // functions are checked on every call
+        const FunctionRegistry::Entry& function = (*owner.functions)[functionId];
+        if (argumentCount > UINT16_MAX || (function.builtIn && !function.acceptsArgumentCount(argumentCount))) {
+            throw std::invalid_argument("Wrong number of arguments to " + function.name);
+        }
+        return addNode(OpCode::CallFunction, functionId, static_cast<uint16_t>(argumentCount), firstArgument);
+    }
+
+    uint32_t parseOperand() {
+        size_t index = position++;
+        const std::string& token = tokens[index];
+        if (token == ")") {
+            throw std::invalid_argument("Mismatched parentheses");
+        }
+        if (token == ",") {
+            throw std::invalid_argument("Unexpected argument separator");
+        }
+        if (token.front() == '"') {
+            // Doubled quotes inside a literal stand for one
+            std::string text;
+            size_t end = token.size() >= 2 && token.back() == '"' ? token.size() - 1 : token.size();
+            for (size_t i = 1; i < end; ++i) {
+                text += token[i];
+                if (token[i] == '"' && i + 1 < end && token[i + 1] == '"') {
+                    ++i;
+                }
+            }
+            program.strings.emplace_back(*owner.workbook->stringPool, text);
+            return addNode(OpCode::PushString, static_cast<uint32_t>(program.strings.size() - 1));
+        }
+        double number = 0;
+        if (parseNumber(token, number)) {
+            // A literal beyond the double range (1E400) is #NUM!, as in Excel
+            if (!std::isfinite(number)) {
+                return addNode(OpCode::PushError, static_cast<uint32_t>(ErrorCode::Num));
+            }
+            program.numbers.push_back(number);
+            return addNode(OpCode::PushNumber, static_cast<uint32_t>(program.numbers.size() - 1));
+        }
+        if (token.front() == '#') {
+            ErrorCode code = ExcelCore::parseErrorCode(token);
+            if (code == ErrorCode::None) {
+                throw std::invalid_argument("Malformed formula");
+            }
+            return addNode(OpCode::PushError, static_cast<uint32_t>(code));
+        }
+        if (isReferenceToken(tokens, index)) {
+            return addNode(OpCode::PushCell, nextReference++);
+        }
+        if (isRangeToken(token)) {
+            return addNode(OpCode::PushRange, nextRange++);
+        }
+        unsigned char first = static_cast<unsigned char>(token.front());
+        if (!std::isalpha(first) && first != '_') {
+            throw std::invalid_argument("Malformed formula");
+        }
+        std::string upperToken = token;
+        std::transform(upperToken.begin(), upperToken.end(), upperToken.begin(), ::toupper);
+        if (upperToken != "TRUE" && upperToken != "FALSE") {
+            throw std::invalid_argument("#NAME?");
+        }
+        return addNode(OpCode::PushBoolean, upperToken == "TRUE" ? 1 : 0);
+    }
+};
+
+// Compiles tokens to postfix bytecode: the Pratt parser builds the formula's
+// flat AST, whose post-order node array is emitted as it stands. Function
+// calls carry their argument count, so the interpreter never has to search
+// the stack for argument boundaries.
+std::shared_ptr<CompiledFormula> FormulaParser::compileTokens(const std::vector<std::string>& tokens, const CellAddress& currentCell) const {
+    auto program = std::make_shared<CompiledFormula>();
+
+    // Record the template first so that even a program that fails to compile
+    // can render its text for every cell sharing it
+    program->tokens.reserve(tokens.size());
+    program->tokenReferences.reserve(tokens.size());
+    program->tokenRanges.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (isReferenceToken(tokens, i)) {
+            program->tokenReferences.push_back(static_cast<int32_t>(program->references.size()));
+            program->tokenRanges.push_back(-1);
+            program->references.push_back(resolveCellReference(tokens[i], currentCell));
+            program->tokens.emplace_back();
+        } else if (isRangeToken(tokens[i])) {
+            program->tokenReferences.push_back(-1);
+            program->tokenRanges.push_back(static_cast<int32_t>(program->ranges.size()));
+            program->ranges.push_back(resolveRange(tokens[i], currentCell));
+            program->tokens.emplace_back();
+        } else {
+            program->tokenReferences.push_back(-1);
+            program->tokenRanges.push_back(-1);
+            program->tokens.push_back(tokens[i]);
+        }
+    }
+
+    try {
+        FormulaAst ast = ExpressionParser(*this, tokens, *program).parse();
+
+        // Children precede their parents, so the node array is the postfix program
+        int64_t depth = 0;
+        program->code.reserve(ast.nodes.size());
+        for (const AstNode& node : ast.nodes) {
+            uint16_t argumentCount = node.opcode == OpCode::CallFunction ? node.childCount : 0;
+            program->code.push_back(Instruction{node.opcode, argumentCount, node.operand});
+            depth += 1 - static_cast<int64_t>(node.childCount);
+            program->maxStackDepth = std::max<uint32_t>(program->maxStackDepth, static_cast<uint32_t>(depth));
+        }
+    } catch (const std::exception& e) {
+        program->code.clear();
+        program->errorMessage = e.what();
+    }
+
+    return program;
+}
+
+// The interpreter: a single pass over the instructions with a value stack
+// sized from the compile-time maximum depth. The stack and any argument lists
+// live in the thread's evaluation arena and are released together on return.
+CellValue FormulaParser::execute(const CompiledFormula& program, const CellAddress& currentCell, size_t sheetIndex) {
+    if (!program.isValid()) {
+        return CellValue(CellValue::Type::Error, program.errorMessage);
+    }
+
+    EvaluationArena& arena = EvaluationArena::forThread();
+    EvaluationArena::Scope scope(arena);
+    // Text built while evaluating (here or in custom functions) is a result,
+    // freed once no cell holds it, rather than interned for good
+    StringPool& strings = *workbook->stringPool;
+    StringPool::ResultScope results(strings);
+
+    // Ranges stay lazy views on the stack until a function consumes them
+    ScratchVector<FunctionArgument> stack(&arena);
+    stack.reserve(program.maxStackDepth);
+
+    for (const Instruction& instruction : program.code) {
+        switch (instruction.opcode) {
+            case OpCode::PushNumber:
+                stack.emplace_back(CellValue(program.numbers[instruction.operand]));
+                break;
+            case OpCode::PushString:
+                stack.emplace_back(program.strings[instruction.operand]);
+                break;
+            case OpCode::PushBoolean:
+                stack.emplace_back(CellValue(instruction.operand != 0));
+                break;
+            case OpCode::PushError:
+                stack.emplace_back(CellValue::error(static_cast<ErrorCode>(instruction.operand)));
+                break;
+            case OpCode::PushCell: {
+                CellAddress referencedCell;
+                if (program.references[instruction.operand].resolve(currentCell, referencedCell)) {
+                    stack.emplace_back(evaluateCell(referencedCell, sheetIndex));
+                } else {
+                    stack.emplace_back(CellValue::error(ErrorCode::Ref));
+                }
+                break;
+            }
+            case OpCode::PushRange: {
+                // Cells inside a range are read as stored, never re-evaluated
+                CellAddress first;
+                CellAddress last;
+                if (program.ranges[instruction.operand].resolve(currentCell, first, last)) {
+                    stack.emplace_back(RangeView(workbook->getWorksheet(sheetIndex), first, last));
+                } else {
+                    stack.emplace_back(CellValue::error(ErrorCode::Ref));
+                }
+                break;
+            }
+            case OpCode::CallFunction: {
+                auto first = stack.end() - instruction.argumentCount;
+                const FunctionRegistry::Entry& function = (*functions)[instruction.operand];
+                CellValue result;
+                std::unique_lock<std::mutex> serialCall(serialCallMutex, std::defer_lock);
+                if (!function.traits.threadSafe) {
+                    serialCall.lock();
+                }
+                if (!function.isDefined()) {
+                    // Not registered (yet)
+                    result = CellValue::error(ErrorCode::Name);
+                } else if (!function.acceptsArgumentCount(instruction.argumentCount)) {
+                    result = CellValue::error(ErrorCode::Value);
+                } else if (function.range) {
+                    // Range functions read their arguments in place on the stack
+                    result = function.range(ArgumentList<FunctionArgument>(stack.data() + (first - stack.begin()), instruction.argumentCount));
+                } else {
+                    // Plain functions get the non-empty cells of ranges spliced into their arguments
+                    EvaluationArena::Scope argumentScope(arena);
+                    ScratchVector<CellValue> args(&arena);
+                    args.reserve(instruction.argumentCount);
+                    for (auto it = first; it != stack.end(); ++it) {
+                        if (it->isRange()) {
+                            it->getRange().forEachValue([&](const CellAddress&, const CellValue& value) {
+                                args.push_back(value);
+                            });
+                        } else {
+                            args.push_back(it->getValue());
+                        }
+                    }
+                    result = function.scalar(args);
+                }
+                stack.erase(first, stack.end());
+                stack.emplace_back(std::move(result));
+                break;
+            }
+            case OpCode::Negate:
+            case OpCode::Percent: {
+                CellValue operand = stack.back().toValue();
+                double number = 0;
+                if (operand.isError()) {
+                    stack.back() = operand;
+                } else if (!coerceToNumber(operand, number)) {
+                    stack.back() = CellValue::error(ErrorCode::Value);
+                } else {
+                    stack.back() = CellValue(instruction.opcode == OpCode::Negate ? -number : number / 100);
+                }
+                break;
+            }
+            default: {
+                CellValue right = stack.back().toValue();
+                stack.pop_back();
+                CellValue left = stack.back().toValue();
+                // Errors propagate; the left operand's error wins
+                if (left.isError() || right.isError()) {
+                    stack.back() = left.isError() ? left : right;
+                    break;
+                }
+                if (instruction.opcode == OpCode::Concatenate) {
+                    stack.back() = CellValue::fromStringId(
+                        strings, strings.internResult(concatenationText(left) + concatenationText(right)));
+                    break;
+                }
+                if (instruction.opcode >= OpCode::Equal) {
+                    int order = compareValues(left, right);
+                    bool result = false;
+                    switch (instruction.opcode) {
+                        case OpCode::Equal:     result = order == 0; break;
+                        case OpCode::NotEqual:  result = order != 0; break;
+                        case OpCode::Less:      result = order < 0; break;
+                        case OpCode::LessEqual: result = order <= 0; break;
+                        case OpCode::Greater:   result = order > 0; break;
+                        default:                result = order >= 0; break;
+                    }
+                    stack.back() = CellValue(result);
+                    break;
+                }
+                double a = 0;
+                double b = 0;
+                if (!coerceToNumber(left, a) || !coerceToNumber(right, b)) {
+                    stack.back() = CellValue::error(ErrorCode::Value);
+                    break;
+                }
+                // A date plus or minus days stays a date, and the difference of
+                // two dates is in days; both are computed on the stored seconds
+                bool leftDate = left.getType() == CellType::Date;
+                bool rightDate = right.getType() == CellType::Date;
+                if (instruction.opcode == OpCode::Subtract && leftDate && rightDate) {
+                    stack.back() = CellValue((left.getDateSeconds() - right.getDateSeconds()) / kSecondsPerDay);
+                    break;
+                }
+                if ((instruction.opcode == OpCode::Add && leftDate != rightDate) ||
+                    (instruction.opcode == OpCode::Subtract && leftDate)) {
+                    double days = leftDate ? b : a;
+                    double seconds = (leftDate ? left : right).getDateSeconds() +
+                                     (instruction.opcode == OpCode::Add ? days : -days) * kSecondsPerDay;
+                    stack.back() = std::isfinite(seconds) ? CellValue::fromDateSeconds(seconds) : CellValue::error(ErrorCode::Num);
+                    break;
+                }
+                double result = 0;
+                switch (instruction.opcode) {
+                    case OpCode::Add:      result = a + b; break;
+                    case OpCode::Subtract: result = a - b; break;
+                    case OpCode::Multiply: result = a * b; break;
+                    case OpCode::Divide:
+                        if (b == 0) {
+                            stack.back() = CellValue::error(ErrorCode::Div0);
+                            continue;
+                        }
+                        result = a / b;
+                        break;
+                    default:               result = std::pow(a, b); break;
+                }
+                stack.back() = std::isfinite(result) ? CellValue(result) : CellValue::error(ErrorCode::Num);
+                break;
+            }
+        }
+    }
+
+    return stack.empty() ? CellValue() : stack.back().toValue();
 }
 
 std::vector<std::string> FormulaParser::tokenizeFormula(const std::string& formula) {
@@ -67,19 +861,29 @@ std::vector<std::string> FormulaParser::tokenizeFormula(const std::string& formu
     std::string currentToken;
     bool inString = false;
 
-    for (char c : formula) {
+    for (size_t i = 0; i < formula.size(); ++i) {
+        char c = formula[i];
         if (c == '"') {
             inString = !inString;
             currentToken += c;
         } else if (inString) {
             currentToken += c;
-        } else if (std::isspace(c)) {
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
             if (!currentToken.empty()) {
                 tokens.push_back(currentToken);
                 currentToken.clear();
             }
-        } else if (std::isalnum(c) || c == '_' || c == '.') {
+        } else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$') {
             currentToken += c;
+        } else if ((c == '+' || c == '-') && isExponentPrefix(currentToken)) {
+            // The sign of an exponent (1E+3, 1.5e-05) belongs to the number
+            currentToken += c;
+        } else if (size_t length = c == '#' && currentToken.empty() ? errorLiteralLength(formula, i) : 0) {
+            // Error literals (#DIV/0!, #N/A) contain operator characters
+            std::string literal = formula.substr(i, length);
+            std::transform(literal.begin(), literal.end(), literal.begin(), ::toupper);
+            tokens.push_back(literal);
+            i += length - 1;
         } else {
             if (!currentToken.empty()) {
                 tokens.push_back(currentToken);
@@ -93,177 +897,196 @@ std::vector<std::string> FormulaParser::tokenizeFormula(const std::string& formu
         tokens.push_back(currentToken);
     }
 
-    return tokens;
-}
-
-std::vector<std::string> FormulaParser::infixToPostfix(const std::vector<std::string>& tokens) {
-    std::vector<std::string> output;
-    std::stack<std::string> operatorStack;
-
-    for (const std::string& token : tokens) {
-        if (isOperator(token)) {
-            while (!operatorStack.empty() && isOperator(operatorStack.top()) &&
-                   precedence(operatorStack.top()) >= precedence(token)) {
-                output.push_back(operatorStack.top());
-                operatorStack.pop();
-            }
-            operatorStack.push(token);
-        } else if (token == "(") {
-            operatorStack.push(token);
-        } else if (token == ")") {
-            while (!operatorStack.empty() && operatorStack.top() != "(") {
-                output.push_back(operatorStack.top());
-                operatorStack.pop();
-            }
-            if (!operatorStack.empty() && operatorStack.top() == "(") {
-                operatorStack.pop();
+    // Join "A1", ":", "B10" (and A:C, 1:3) into a single range token, and
+    // "<", "=" (and <>, >=) into one comparison operator
+    std::vector<std::string> merged;
+    merged.reserve(tokens.size());
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (i + 1 < tokens.size() && ((tokens[i] == "<" && (tokens[i + 1] == "=" || tokens[i + 1] == ">")) ||
+                                      (tokens[i] == ">" && tokens[i + 1] == "="))) {
+            merged.push_back(tokens[i] + tokens[i + 1]);
+            ++i;
+            continue;
+        }
+        if (i + 2 < tokens.size() && tokens[i + 1] == ":") {
+            RangeEndpoint kind = rangeEndpointKind(tokens[i]);
+            if (kind != RangeEndpoint::None && kind == rangeEndpointKind(tokens[i + 2])) {
+                merged.push_back(tokens[i] + ":" + tokens[i + 2]);
+                i += 2;
+                continue;
             }
-        } else {
-            output.push_back(token);
         }
+        merged.push_back(tokens[i]);
     }
-
-    while (!operatorStack.empty()) {
-        output.push_back(operatorStack.top());
-        operatorStack.pop();
-    }
-
-    return output;
+    return merged;
 }
 
-CellValue FormulaParser::evaluatePostfix(const std::vector<std::string>& postfixTokens, const CellAddress& currentCell) {
-    std::stack<CellValue> operandStack;
+void FormulaParser::registerBuiltInFunctions(FunctionRegistry& registry) {
+    // Implement common Excel functions (SUM, AVERAGE, MIN, MAX, COUNT, IF, VLOOKUP, etc.)
+    // The aggregates run on the vectorized kernels in AggregateKernels
+    // An error among the arguments is the result of SUM, AVERAGE, MIN and MAX
+    FunctionTraits aggregateTraits;
+    aggregateTraits.minArguments = 1;
+
+    registry.define("SUM", FunctionRegistry::RangeFunction([&registry](ArgumentList<FunctionArgument> args) {
+        AggregateResult result = aggregateArguments(args, registry.getSummationMode());
+        return result.error != ErrorCode::None ? CellValue::error(result.error) : CellValue(result.total());
+    }), aggregateTraits, true);
 
-    for (const std::string& token : postfixTokens) {
-        if (isOperator(token)) {
-            CellValue right = operandStack.top();
-            operandStack.pop();
-            CellValue left = operandStack.top();
-            operandStack.pop();
-            operandStack.push(applyOperator(token, left, right));
-        } else if (isFunction(token)) {
-            std::vector<CellValue> args;
-            while (!operandStack.empty() && operandStack.top().getType() != CellValue::Type::Function) {
-                args.insert(args.begin(), operandStack.top());
-                operandStack.pop();
-            }
-            operandStack.push(applyFunction(token, args));
-        } else if (isCellReference(token)) {
-            CellAddress referencedCell = resolveCellReference(token, currentCell);
-            operandStack.push(evaluateCell(referencedCell));
-        } else {
-            operandStack.push(parseLiteral(token));
+    registry.define("AVERAGE", FunctionRegistry::RangeFunction([&registry](ArgumentList<FunctionArgument> args) {
+        AggregateResult result = aggregateArguments(args, registry.getSummationMode());
+        if (result.error != ErrorCode::None) {
+            return CellValue::error(result.error);
         }
-    }
-
-    return operandStack.top();
-}
+        return result.count > 0 ? CellValue(result.average()) : CellValue::error(ErrorCode::Div0);
+    }), aggregateTraits, true);
 
-void FormulaParser::initializeFunctionMap() {
-    // Implement common Excel functions (SUM, AVERAGE, MIN, MAX, COUNT, IF, VLOOKUP, etc.)
-    registerFunction("SUM", [](const std::vector<CellValue>& args) {
-        double sum = 0;
-        for (const auto& arg : args) {
-            if (arg.getType() == CellValue::Type::Number) {
-                sum += arg.getNumber();
-            }
+    registry.define("MIN", FunctionRegistry::RangeFunction([](ArgumentList<FunctionArgument> args) {
+        AggregateResult result = aggregateArguments(args, SummationMode::Fast);
+        if (result.error != ErrorCode::None) {
+            return CellValue::error(result.error);
         }
-        return CellValue(sum);
-    });
+        return CellValue(result.count > 0 ? result.min : 0.0);
+    }), aggregateTraits, true);
 
-    registerFunction("AVERAGE", [](const std::vector<CellValue>& args) {
-        double sum = 0;
-        int count = 0;
-        for (const auto& arg : args) {
-            if (arg.getType() == CellValue::Type::Number) {
-                sum += arg.getNumber();
-                count++;
-            }
+    registry.define("MAX", FunctionRegistry::RangeFunction([](ArgumentList<FunctionArgument> args) {
+        AggregateResult result = aggregateArguments(args, SummationMode::Fast);
+        if (result.error != ErrorCode::None) {
+            return CellValue::error(result.error);
         }
-        return count > 0 ? CellValue(sum / count) : CellValue();
-    });
+        return CellValue(result.count > 0 ? result.max : 0.0);
+    }), aggregateTraits, true);
 
-    // Add more functions here...
-}
+    // COUNT counts numbers only and skips errors
+    registry.define("COUNT", FunctionRegistry::RangeFunction([](ArgumentList<FunctionArgument> args) {
+        return CellValue(static_cast<double>(aggregateArguments(args, SummationMode::Fast).count));
+    }), aggregateTraits, true);
 
-void FormulaParser::initializeArithmeticOperations() {
-    // Implement basic arithmetic operations (+, -, *, /, ^)
-    operatorMap["+"] = [](double a, double b) { return a + b; };
-    operatorMap["-"] = [](double a, double b) { return a - b; };
-    operatorMap["*"] = [](double a, double b) { return a * b; };
-    operatorMap["/"] = [](double a, double b) { return b != 0 ? a / b : std::numeric_limits<double>::quiet_NaN(); };
-    operatorMap["^"] = [](double a, double b) { return std::pow(a, b); };
-}
+    // Volatile functions: the engine recalculates their cells on every pass
+    FunctionTraits volatileTraits;
+    volatileTraits.maxArguments = 0;
+    volatileTraits.isVolatile = true;
+    volatileTraits.pure = false;
 
-bool FormulaParser::isOperator(const std::string& token) {
-    return operatorMap.find(token) != operatorMap.end();
-}
+    // Local time, as in Excel
+    registry.define("NOW", FunctionRegistry::ScalarFunction([](ArgumentList<CellValue>) {
+        return CellValue::fromDateSeconds(localNowSeconds());
+    }), volatileTraits, true);
 
-bool FormulaParser::isFunction(const std::string& token) {
-    std::string upperToken = token;
-    std::transform(upperToken.begin(), upperToken.end(), upperToken.begin(), ::toupper);
-    return functionMap.find(upperToken) != functionMap.end();
-}
+    // Local midnight of the current day
+    registry.define("TODAY", FunctionRegistry::ScalarFunction([](ArgumentList<CellValue>) {
+        return CellValue::fromDateSeconds(std::floor(localNowSeconds() / kSecondsPerDay) * kSecondsPerDay);
+    }), volatileTraits, true);
 
-bool FormulaParser::isCellReference(const std::string& token) {
-    // Implement cell reference validation logic
-    // This is a simplified check and should be expanded for full Excel cell reference support
-    return std::regex_match(token, std::regex("^[A-Za-z]+[0-9]+$"));
+    // Uniform in [0, 1); each thread draws from its own generator
+    registry.define("RAND", FunctionRegistry::ScalarFunction([](ArgumentList<CellValue>) {
+        thread_local std::mt19937_64 generator{std::random_device{}()};
+        return CellValue(std::generate_canonical<double, 53>(generator));
+    }), volatileTraits, true);
+
+    // Add more functions here...
 }
 
-CellValue FormulaParser::parseLiteral(const std::string& token) {
-    // Implement literal parsing logic
-    try {
-        return CellValue(std::stod(token));
-    } catch (const std::invalid_argument&) {
-        return CellValue(token);
+// A range as the tokenizer joins them: endpoints of the same kind around the
+// colon, so a stray ":" is left to fail as a syntax error
+bool FormulaParser::isRangeToken(const std::string& token) {
+    size_t colon = token.find(':');
+    if (colon == std::string::npos || token.front() == '"') {
+        return false;
     }
+    RangeEndpoint kind = rangeEndpointKind(token.substr(0, colon));
+    return kind != RangeEndpoint::None && kind == rangeEndpointKind(token.substr(colon + 1));
 }
 
-CellValue FormulaParser::applyOperator(const std::string& op, const CellValue& left, const CellValue& right) {
-    if (left.getType() == CellValue::Type::Number && right.getType() == CellValue::Type::Number) {
-        auto it = operatorMap.find(op);
-        if (it != operatorMap.end()) {
-            return CellValue(it->second(left.getNumber(), right.getNumber()));
-        }
-    }
-    return CellValue(); // Return empty CellValue for type mismatch or unknown operator
+// Matches $?LETTERS$?DIGITS without a regex; only called while compiling
+bool FormulaParser::isCellReference(const std::string& token) {
+    size_t i = 0;
+    if (i < token.size() && token[i] == '$') ++i;
+    size_t letterStart = i;
+    while (i < token.size() && std::isalpha(static_cast<unsigned char>(token[i]))) ++i;
+    if (i == letterStart || i - letterStart > 3) return false;
+    if (i < token.size() && token[i] == '$') ++i;
+    size_t digitStart = i;
+    while (i < token.size() && std::isdigit(static_cast<unsigned char>(token[i]))) ++i;
+    return i > digitStart && i == token.size();
 }
 
-CellValue FormulaParser::applyFunction(const std::string& func, const std::vector<CellValue>& args) {
-    std::string upperFunc = func;
-    std::transform(upperFunc.begin(), upperFunc.end(), upperFunc.begin(), ::toupper);
-    auto it = functionMap.find(upperFunc);
-    if (it != functionMap.end()) {
-        return it->second(args);
+bool FormulaParser::parseNumber(const std::string& token, double& number) {
+    if (token.empty() || !(std::isdigit(static_cast<unsigned char>(token[0])) || token[0] == '.')) {
+        return false;
     }
-    return CellValue(); // Return empty CellValue for unknown function
+    char* end = nullptr;
+    number = std::strtod(token.c_str(), &end);
+    return end == token.c_str() + token.size();
 }
 
-CellAddress FormulaParser::resolveCellReference(const std::string& ref, const CellAddress& currentCell) {
-    // Implement cell reference resolution logic
-    // This is a simplified implementation and should be expanded for full Excel cell reference support
-    std::string colStr;
-    int row = 0;
-    for (char c : ref) {
-        if (std::isalpha(c)) {
-            colStr += c;
-        } else if (std::isdigit(c)) {
-            row = row * 10 + (c - '0');
-        }
+// Converts an A1 reference into offsets from the current cell; $-anchored
+// parts stay absolute
+FormulaReference FormulaParser::resolveCellReference(const std::string& ref, const CellAddress& currentCell) {
+    FormulaReference reference;
+    int64_t col = 0;
+    int64_t row = 0;
+    size_t i = 0;
+    if (i < ref.size() && ref[i] == '$') {
+        reference.columnAbsolute = true;
+        ++i;
+    }
+    // Both parts saturate just past the worksheet, so long ones cannot overflow
+    while (i < ref.size() && std::isalpha(static_cast<unsigned char>(ref[i]))) {
+        col = std::min<int64_t>(col * 26 + (std::toupper(static_cast<unsigned char>(ref[i])) - 'A' + 1), kMaxColumns + 1);
+        ++i;
     }
-    int col = 0;
-    for (char c : colStr) {
-        col = col * 26 + (std::toupper(c) - 'A' + 1);
+    if (i < ref.size() && ref[i] == '$') {
+        reference.rowAbsolute = true;
+        ++i;
     }
-    return CellAddress(col - 1, row - 1);
+    while (i < ref.size() && std::isdigit(static_cast<unsigned char>(ref[i]))) {
+        row = std::min<int64_t>(row * 10 + (ref[i] - '0'), kMaxRows + 1);
+        ++i;
+    }
+    // A part outside the worksheet (A0, A1048577, XFE1) becomes absolute and
+    // past the edge, so it yields #REF! from whichever cell shares the program
+    if (row < 1 || row > kMaxRows) {
+        reference.rowAbsolute = true;
+        row = kMaxRows + 1;
+    }
+    if (col < 1 || col > kMaxColumns) {
+        reference.columnAbsolute = true;
+        col = kMaxColumns + 1;
+    }
+    reference.row = static_cast<int32_t>(reference.rowAbsolute ? row - 1 : row - 1 - static_cast<int64_t>(currentCell.row));
+    reference.column = static_cast<int32_t>(reference.columnAbsolute ? col - 1 : col - 1 - static_cast<int64_t>(currentCell.column));
+    return reference;
 }
 
-int FormulaParser::precedence(const std::string& op) {
-    if (op == "^") return 3;
-    if (op == "*" || op == "/") return 2;
-    if (op == "+" || op == "-") return 1;
-    return 0;
+// Converts A1:B10, A:C or 1:3 into a pair of relative/absolute corner references
+FormulaRange FormulaParser::resolveRange(const std::string& text, const CellAddress& currentCell) {
+    FormulaRange range;
+    size_t colon = text.find(':');
+    std::string start = text.substr(0, colon);
+    std::string end = text.substr(colon + 1);
+
+    switch (rangeEndpointKind(start)) {
+        case RangeEndpoint::Column:
+            range.kind = FormulaRange::Kind::Columns;
+            range.first = resolveCellReference(start + "1", currentCell);
+            range.last = resolveCellReference(end + "1", currentCell);
+            range.first.row = range.last.row = 0;
+            range.first.rowAbsolute = range.last.rowAbsolute = true;
+            break;
+        case RangeEndpoint::Row:
+            range.kind = FormulaRange::Kind::Rows;
+            range.first = resolveCellReference("A" + start, currentCell);
+            range.last = resolveCellReference("A" + end, currentCell);
+            range.first.column = range.last.column = 0;
+            range.first.columnAbsolute = range.last.columnAbsolute = true;
+            break;
+        default:
+            range.first = resolveCellReference(start, currentCell);
+            range.last = resolveCellReference(end, currentCell);
+            break;
+    }
+    return range;
 }
 
 // Human tasks (commented):
@@ -271,9 +1094,8 @@ int FormulaParser::precedence(const std::string& op) {
 TODO: Implement circular reference detection and handling
 TODO: Add support for array formulas
 TODO: Implement comprehensive error handling for formula parsing and evaluation
-TODO: Optimize formula evaluation for large spreadsheets
 TODO: Add support for external data sources in formulas
 TODO: Implement caching mechanism for frequently used cell values and intermediate results
 TODO: Add support for more advanced Excel functions (e.g., financial, statistical, and database functions)
 TODO: Implement proper handling of date and time values in formulas
-*/
\ No newline at end of file
+*/
@@ -4,37 +4,140 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 #include <functional>
+#include <cstdint>
 
-// Forward declarations
+#include "FormulaTable.h"
+#include "AggregateKernels.h"
+#include "RangeView.h"
+#include "FunctionRegistry.h"
+
+namespace ExcelCore {
 class Workbook;
-class CellAddress;
-class CellValue;
+}
+using ExcelCore::Workbook;
+using ExcelCore::FormulaCell;
+using ExcelCore::CellAddress;
+using ExcelCore::CellValue;
+using ExcelCore::CompiledFormula;
+using ExcelCore::FormulaReference;
+using ExcelCore::FormulaRange;
+using ExcelCore::FunctionArgument;
+using ExcelCore::ArgumentList;
+using ExcelCore::FunctionTraits;
+using ExcelCore::FunctionRegistry;
+using ExcelCore::RangeView;
+using ExcelCore::FormulaTable;
+using ExcelCore::SummationMode;
 
 class FormulaParser {
 public:
-    // Constructor
-    FormulaParser(std::shared_ptr<Workbook> workbook);
+    // Constructor; without a registry the parser creates its own with the built-in functions
+    FormulaParser(std::shared_ptr<Workbook> workbook, std::shared_ptr<FunctionRegistry> functions = nullptr);
+
+    // A registry holding the built-in functions, to be shared by parsers
+    static std::shared_ptr<FunctionRegistry> createFunctionRegistry();
 
     // Public methods
-    CellValue parseFormula(const std::string& formula, const CellAddress& currentCell);
-    void registerFunction(const std::string& functionName, std::function<CellValue(const std::vector<CellValue>&)> function);
-    CellValue evaluateCell(const CellAddress& cellAddress);
+    CellValue parseFormula(const std::string& formula, const CellAddress& currentCell, size_t sheetIndex = 0);
+    void registerFunction(const std::string& functionName, std::function<CellValue(ArgumentList<CellValue>)> function,
+                          const FunctionTraits& traits = FunctionTraits());
+
+    // Registers a function that receives range arguments as lazy views instead
+    // of copies of their cells (functions registered with registerFunction get
+    // the non-empty values of a range expanded into their argument list).
+    // Arguments are views into evaluation scratch and must not be kept.
+    void registerRangeFunction(const std::string& functionName, std::function<CellValue(ArgumentList<FunctionArgument>)> function,
+                               const FunctionTraits& traits = FunctionTraits());
+    CellValue evaluateCell(const CellAddress& cellAddress, size_t sheetIndex = 0);
+
+    // When disabled, referenced formula cells are read instead of re-evaluated.
+    // The calculation engine disables it because it evaluates in dependency order.
+    void setRecursiveEvaluation(bool enabled);
+
+    // Discards every cached formula result: the next evaluation starts a new
+    // calculation epoch. Edits to the workbook start a new epoch on their own.
+    void invalidateResults();
+
+    uint64_t getCalculationEpoch() const {
+        return calculationEpoch;
+    }
+
+    // Selects plain or Kahan-compensated summation for SUM and AVERAGE
+    void setSummationMode(SummationMode mode);
+
+    // Compiles a formula into bytecode. Never throws: a formula that cannot be
+    // compiled yields a program whose evaluation returns the error.
+    std::shared_ptr<const CompiledFormula> compileFormula(const std::string& formula, const CellAddress& currentCell) const;
+
+    // Like compileFormula, but returns the program shared by every formula with
+    // the same relative (R1C1) template, compiling it only the first time
+    std::shared_ptr<const CompiledFormula> internFormula(const std::string& formula, const CellAddress& currentCell);
+
+    // Returns the cell's compiled program, interning it on first use
+    const CompiledFormula& getCompiledFormula(FormulaCell& cell, const CellAddress& address);
+
+    // Runs a compiled program for the given cell; reentrant, so workers may share one parser
+    CellValue execute(const CompiledFormula& program, const CellAddress& currentCell, size_t sheetIndex);
+
+    const FormulaTable& getFormulaTable() const {
+        return formulaTable;
+    }
+
+    // Drops shared programs no cell uses any more. Sweeps only once the table
+    // has doubled since the last sweep, so calling it often stays cheap.
+    void purgeUnusedFormulas();
+
+    // CallFunction operands are IDs in this registry
+    FunctionRegistry& getFunctionRegistry() const {
+        return *functions;
+    }
+
+    // Whether the program calls a volatile function
+    bool isVolatile(const CompiledFormula& program) const;
+
+    // Shares a program compiled elsewhere (e.g. loaded from a snapshot) under its
+    // R1C1 template; returns the program already interned for it, if any
+    std::shared_ptr<const CompiledFormula> adoptFormula(std::shared_ptr<const CompiledFormula> program);
 
 private:
     // Private member variables
     std::shared_ptr<Workbook> workbook;
-    std::unordered_map<std::string, std::function<CellValue(const std::vector<CellValue>&)>> functionMap;
+    std::shared_ptr<FunctionRegistry> functions;
+    // Held while calling a function that is not thread-safe
+    std::mutex serialCallMutex;
+    FormulaTable formulaTable;
+    // Table size at which purgeUnusedFormulas() next sweeps
+    static constexpr size_t kMinFormulaPurgeSize = 1024;
+    size_t formulaPurgeThreshold = kMinFormulaPurgeSize;
+    bool recursiveEvaluation = true;
+    // Recursive evaluation computes each formula cell at most once per epoch.
+    // The epoch advances when the workbook's edit version changes between
+    // top-level evaluations, or when the results are invalidated.
+    uint64_t calculationEpoch = 1;
+    uint64_t observedEditVersion = 0;
+    uint32_t evaluationDepth = 0;
+
+    // Pratt parser from tokens to a FormulaAst, defined in FormulaParser.cpp
+    class ExpressionParser;
 
     // Private helper methods
-    void populateFunctionMap();
-    std::vector<std::string> tokenizeFormula(const std::string& formula);
-    std::vector<std::string> convertToPostfix(const std::vector<std::string>& tokens);
-    CellValue evaluatePostfix(const std::vector<std::string>& postfixExpression, const CellAddress& currentCell);
+    static void registerBuiltInFunctions(FunctionRegistry& registry);
+    void synchronizeCalculationEpoch();
+    static std::string stripFormulaPrefix(const std::string& formula);
+    static std::vector<std::string> tokenizeFormula(const std::string& formula);
+    static bool isReferenceToken(const std::vector<std::string>& tokens, size_t index);
+    static bool isRangeToken(const std::string& token);
+    std::shared_ptr<CompiledFormula> compileTokens(const std::vector<std::string>& tokens, const CellAddress& currentCell) const;
+    static std::string buildTemplateKey(const std::vector<std::string>& tokens, const CellAddress& currentCell);
+    static bool isCellReference(const std::string& token);
+    static bool parseNumber(const std::string& token, double& number);
+    static FormulaReference resolveCellReference(const std::string& ref, const CellAddress& currentCell);
+    static FormulaRange resolveRange(const std::string& range, const CellAddress& currentCell);
 };
 
 // TODO: Implement circular reference detection and handling
 // TODO: Add support for array formulas
 // TODO: Implement error handling for formula parsing and evaluation
-// TODO: Optimize formula evaluation for large spreadsheets
-// TODO: Add support for external data sources in formulas
\ No newline at end of file
+// TODO: Add support for external data sources in formulas
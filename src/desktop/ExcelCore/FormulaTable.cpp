@@ -0,0 +1,145 @@
+#include "FormulaTable.h"
+
+namespace ExcelCore {
+
+namespace {
+// Column letters for a zero-based column index (0 -> A, 26 -> AA)
+std::string columnLetters(uint32_t column) {
+    std::string letters;
+    uint32_t col = column + 1;
+    while (col > 0) {
+        uint32_t remainder = (col - 1) % 26;
+        letters.insert(letters.begin(), static_cast<char>('A' + remainder));
+        col = (col - 1) / 26;
+    }
+    return letters;
+}
+
+std::string rowR1C1(const FormulaReference& reference) {
+    if (reference.rowAbsolute) {
+        return "R" + std::to_string(reference.row + 1);
+    }
+    return reference.row != 0 ? "R[" + std::to_string(reference.row) + "]" : "R";
+}
+
+std::string columnR1C1(const FormulaReference& reference) {
+    if (reference.columnAbsolute) {
+        return "C" + std::to_string(reference.column + 1);
+    }
+    return reference.column != 0 ? "C[" + std::to_string(reference.column) + "]" : "C";
+}
+}
+
+// Looks the template up first and compiles outside the lock; if another thread
+// interned the same template meanwhile, its program wins and ours is discarded.
+// A program that failed to compile is returned without being interned, so the
+// template is compiled afresh next time (a later edit may make it valid).
+std::shared_ptr<const CompiledFormula> FormulaTable::intern(const std::string& templateKey,
+                                                            const std::function<std::shared_ptr<const CompiledFormula>()>& compile) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = templates.find(templateKey);
+        if (it != templates.end()) {
+            return it->second;
+        }
+    }
+
+    std::shared_ptr<const CompiledFormula> program = compile();
+    if (!program->isValid()) {
+        return program;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return templates.emplace(templateKey, program).first->second;
+}
+
+size_t FormulaTable::purgeUnused() {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t removed = 0;
+    for (auto it = templates.begin(); it != templates.end();) {
+        if (it->second.use_count() == 1) {
+            it = templates.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+size_t FormulaTable::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return templates.size();
+}
+
+void FormulaTable::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    templates.clear();
+}
+
+std::string FormulaTable::toR1C1(const FormulaReference& reference) {
+    return rowR1C1(reference) + columnR1C1(reference);
+}
+
+std::string FormulaTable::toA1(const FormulaReference& reference, const CellAddress& origin) {
+    CellAddress resolved;
+    if (!reference.resolve(origin, resolved)) {
+        return "#REF!";
+    }
+    return (reference.columnAbsolute ? "$" : "") + columnLetters(resolved.column) +
+           (reference.rowAbsolute ? "$" : "") + std::to_string(resolved.row + 1);
+}
+
+std::string FormulaTable::toR1C1(const FormulaRange& range) {
+    switch (range.kind) {
+        case FormulaRange::Kind::Columns:
+            return columnR1C1(range.first) + ":" + columnR1C1(range.last);
+        case FormulaRange::Kind::Rows:
+            return rowR1C1(range.first) + ":" + rowR1C1(range.last);
+        default:
+            return toR1C1(range.first) + ":" + toR1C1(range.last);
+    }
+}
+
+std::string FormulaTable::toA1(const FormulaRange& range, const CellAddress& origin) {
+    CellAddress first;
+    CellAddress last;
+    if (!range.first.resolve(origin, first) || !range.last.resolve(origin, last)) {
+        return "#REF!";
+    }
+    switch (range.kind) {
+        case FormulaRange::Kind::Columns:
+            return (range.first.columnAbsolute ? "$" : "") + columnLetters(first.column) + ":" +
+                   (range.last.columnAbsolute ? "$" : "") + columnLetters(last.column);
+        case FormulaRange::Kind::Rows:
+            return (range.first.rowAbsolute ? "$" : "") + std::to_string(first.row + 1) + ":" +
+                   (range.last.rowAbsolute ? "$" : "") + std::to_string(last.row + 1);
+        default:
+            return toA1(range.first, origin) + ":" + toA1(range.last, origin);
+    }
+}
+
+// Rebuilds the A1-style formula text as seen from the given cell
+std::string CompiledFormula::render(const CellAddress& origin) const {
+    std::string text;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        if (tokenReferences[i] >= 0) {
+            text += FormulaTable::toA1(references[tokenReferences[i]], origin);
+        } else if (tokenRanges[i] >= 0) {
+            text += FormulaTable::toA1(ranges[tokenRanges[i]], origin);
+        } else {
+            text += tokens[i];
+        }
+    }
+    return text;
+}
+
+// Cells attached to a shared program no longer keep their own text
+std::string FormulaCell::getFormula(const CellAddress& address) const {
+    if (compiledFormula) {
+        return "=" + compiledFormula->render(address);
+    }
+    return formula;
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CompiledFormula.h"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace ExcelCore {
+
+// Per-workbook intern table of compiled formulas keyed by their relative
+// (R1C1) template. A column of a million "=A2*B2", "=A3*B3", ... formulas
+// normalizes to the single template "RC[-2]*RC[-1]" and shares one program.
+class FormulaTable {
+public:
+    // Returns the shared program for a template, calling compile on first use;
+    // programs that failed to compile are not kept
+    std::shared_ptr<const CompiledFormula> intern(const std::string& templateKey,
+                                                  const std::function<std::shared_ptr<const CompiledFormula>()>& compile);
+
+    // Drops templates no cell refers to any more; returns how many were removed
+    size_t purgeUnused();
+
+    size_t size() const;
+    void clear();
+
+    // Formats a reference in R1C1 notation (R[-1]C, R5C[2], RC3, ...)
+    static std::string toR1C1(const FormulaReference& reference);
+
+    // Formats a reference in A1 notation as seen from origin ($ for absolute parts)
+    static std::string toA1(const FormulaReference& reference, const CellAddress& origin);
+
+    // Range counterparts: R1C1 "R[-1]C:R[5]C", "C[1]:C[2]", "R3:R3"; A1 "A1:B10", "A:C", "$3:$3"
+    static std::string toR1C1(const FormulaRange& range);
+    static std::string toA1(const FormulaRange& range, const CellAddress& origin);
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const CompiledFormula>> templates;
+};
+
+} // namespace ExcelCore
@@ -0,0 +1,62 @@
+#include "FunctionRegistry.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace ExcelCore {
+
+std::string FunctionRegistry::normalizeName(std::string_view name) {
+    std::string upperName(name);
+    std::transform(upperName.begin(), upperName.end(), upperName.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return upperName;
+}
+
+uint32_t FunctionRegistry::getId(const std::string& name) {
+    std::string upperName = normalizeName(name);
+    auto it = ids.find(upperName);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(entries.size());
+    ids.emplace(upperName, id);
+    entries.emplace_back();
+    entries.back().name = std::move(upperName);
+    return id;
+}
+
+uint32_t FunctionRegistry::define(const std::string& name, ScalarFunction function, const FunctionTraits& traits, bool builtIn) {
+    uint32_t id = getId(name);
+    Entry& entry = entries[id];
+    entry.scalar = std::move(function);
+    entry.range = nullptr;
+    entry.traits = traits;
+    entry.builtIn = builtIn;
+    return id;
+}
+
+uint32_t FunctionRegistry::define(const std::string& name, RangeFunction function, const FunctionTraits& traits, bool builtIn) {
+    uint32_t id = getId(name);
+    Entry& entry = entries[id];
+    entry.scalar = nullptr;
+    entry.range = std::move(function);
+    entry.traits = traits;
+    entry.builtIn = builtIn;
+    return id;
+}
+
+uint32_t FunctionRegistry::find(std::string_view name) const {
+    auto it = ids.find(normalizeName(name));
+    return it != ids.end() && entries[it->second].isDefined() ? it->second : kUnknown;
+}
+
+std::vector<std::string> FunctionRegistry::getNames() const {
+    std::vector<std::string> names;
+    names.reserve(entries.size());
+    for (const auto& entry : entries) {
+        names.push_back(entry.name);
+    }
+    return names;
+}
+
+} // namespace ExcelCore
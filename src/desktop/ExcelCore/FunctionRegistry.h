@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "AggregateKernels.h"
+#include "RangeView.h"
+
+namespace ExcelCore {
+
+// Properties of a worksheet function, declared when it is registered
+struct FunctionTraits {
+    static constexpr uint16_t kVariadic = UINT16_MAX;
+
+    // Argument counts accepted; calls with any other count evaluate to #VALUE!
+    // (for built-ins, the formula fails to compile)
+    uint16_t minArguments = 0;
+    uint16_t maxArguments = kVariadic;
+    // The result can change while the arguments stay the same (NOW, RAND).
+    // Cells calling it are recalculated, with their dependents, on every recalculation.
+    bool isVolatile = false;
+    // Equal arguments give equal results, with no side effects
+    bool pure = true;
+    // Calls may run on several recalculation workers at once; calls to
+    // functions that are not thread-safe are serialized
+    bool threadSafe = true;
+};
+
+// The worksheet functions known to formulas, as a flat table indexed by dense
+// function IDs. Names are case-insensitive and resolved to IDs once, when a
+// formula is compiled; evaluation indexes the table directly. An ID stays the
+// same when its function is redefined, so compiled programs remain valid, and
+// a name called before it is registered gets an undefined entry (#NAME?) that
+// registering the function later fills in.
+class FunctionRegistry {
+public:
+    using ScalarFunction = std::function<CellValue(ArgumentList<CellValue>)>;
+    using RangeFunction = std::function<CellValue(ArgumentList<FunctionArgument>)>;
+
+    struct Entry {
+        std::string name;
+        // At most one is set. A scalar function gets the non-empty values of
+        // range arguments expanded into its argument list; a range function
+        // receives ranges as lazy views and can aggregate them in place.
+        ScalarFunction scalar;
+        RangeFunction range;
+        FunctionTraits traits;
+        bool builtIn = false;
+
+        bool isDefined() const {
+            return scalar || range;
+        }
+
+        bool takesRanges() const {
+            return static_cast<bool>(range);
+        }
+
+        bool acceptsArgumentCount(size_t count) const {
+            return count >= traits.minArguments && count <= traits.maxArguments;
+        }
+    };
+
+    static constexpr uint32_t kUnknown = UINT32_MAX;
+
+    uint32_t define(const std::string& name, ScalarFunction function, const FunctionTraits& traits = FunctionTraits(),
+                    bool builtIn = false);
+    uint32_t define(const std::string& name, RangeFunction function, const FunctionTraits& traits = FunctionTraits(),
+                    bool builtIn = false);
+
+    // Returns the ID for a name, adding an undefined entry on first use (e.g.
+    // for functions called by formulas or snapshots before they are registered)
+    uint32_t getId(const std::string& name);
+
+    // Returns kUnknown unless the name has a defined entry
+    uint32_t find(std::string_view name) const;
+
+    const Entry& operator[](uint32_t id) const {
+        return entries[id];
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    // Function names indexed by ID, so programs can be stored by name
+    std::vector<std::string> getNames() const;
+
+    // Read by the SUM and AVERAGE built-ins
+    void setSummationMode(SummationMode mode) {
+        summationMode = mode;
+    }
+
+    SummationMode getSummationMode() const {
+        return summationMode;
+    }
+
+    static std::string normalizeName(std::string_view name);
+
+private:
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, uint32_t> ids;
+    SummationMode summationMode = SummationMode::Fast;
+};
+
+} // namespace ExcelCore
+
+// TODO: Fold calls to pure functions whose arguments are all constants at compile time
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace ExcelCore {
+
+// Thread-safe table that maps integer handles handed to C API callers to
+// shared objects. The table is split into lock-striped shards so unrelated
+// handles never contend; lookups take a shard's lock in shared mode only.
+//
+// A handle packs a slot index and the slot's generation. Freeing a slot bumps
+// its generation, so a stale handle never reaches an object that later reuses
+// the slot; a slot whose generations are used up is retired instead of
+// wrapping, so no handle value is ever issued twice. Lookups return a
+// shared_ptr: an object removed while a call is using it stays alive until
+// that call returns.
+template <typename T>
+class HandleRegistry {
+public:
+    static constexpr uint32_t kShardCount = 16;
+    static constexpr uint32_t kSlotBits = 20;
+    static constexpr uint32_t kGenerationBits = 11;
+    static constexpr uint32_t kSlotsPerShard = (1u << kSlotBits) / kShardCount;
+    static constexpr uint32_t kMaxGeneration = (1u << kGenerationBits) - 1;
+
+    // Stores an object and returns its handle (always positive)
+    int add(std::shared_ptr<T> object) {
+        uint32_t shardIndex = nextShard.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+        Shard& shard = shards[shardIndex];
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+        uint32_t local;
+        if (!shard.freeSlots.empty()) {
+            local = shard.freeSlots.back();
+            shard.freeSlots.pop_back();
+        } else {
+            // Retired slots keep their place, so this also bounds the handles ever issued
+            if (shard.slots.size() >= kSlotsPerShard) {
+                throw std::length_error("Too many open handles");
+            }
+            local = static_cast<uint32_t>(shard.slots.size());
+            shard.slots.emplace_back();
+        }
+        Slot& slot = shard.slots[local];
+        slot.object = std::move(object);
+        return makeHandle(local * kShardCount + shardIndex, slot.generation);
+    }
+
+    // Returns the object, or nullptr for unknown and stale handles
+    std::shared_ptr<T> find(int handle) const {
+        const Shard* shard;
+        uint32_t local;
+        uint32_t generation;
+        if (!decode(handle, shard, local, generation)) {
+            return nullptr;
+        }
+        std::shared_lock<std::shared_mutex> lock(shard->mutex);
+        if (local >= shard->slots.size() || shard->slots[local].generation != generation) {
+            return nullptr;
+        }
+        return shard->slots[local].object;
+    }
+
+    // Removes the handle and returns its object (nullptr if the handle was invalid)
+    std::shared_ptr<T> remove(int handle) {
+        const Shard* constShard;
+        uint32_t local;
+        uint32_t generation;
+        if (!decode(handle, constShard, local, generation)) {
+            return nullptr;
+        }
+        Shard& shard = const_cast<Shard&>(*constShard);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (local >= shard.slots.size() || shard.slots[local].generation != generation ||
+            !shard.slots[local].object) {
+            return nullptr;
+        }
+        Slot& slot = shard.slots[local];
+        std::shared_ptr<T> object = std::move(slot.object);
+        slot.object.reset();
+        // Generation 0 is never issued, so handle 0 stays invalid and a
+        // retired slot matches no handle
+        if (slot.generation < kMaxGeneration) {
+            ++slot.generation;
+            shard.freeSlots.push_back(local);
+        } else {
+            slot.generation = 0;
+        }
+        return object;
+    }
+
+    // Calls f with every stored object, one shard at a time under its shared
+    // lock; f must not add or remove handles of this registry
+    template <typename F>
+    void forEach(F&& f) const {
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const Slot& slot : shard.slots) {
+                if (slot.object) {
+                    f(slot.object);
+                }
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        std::shared_ptr<T> object;
+        uint32_t generation = 1;
+    };
+
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+    };
+
+    std::array<Shard, kShardCount> shards;
+    std::atomic<uint32_t> nextShard{0};
+
+    static int makeHandle(uint32_t slotIndex, uint32_t generation) {
+        return static_cast<int>((generation << kSlotBits) | slotIndex);
+    }
+
+    bool decode(int handle, const Shard*& shard, uint32_t& local, uint32_t& generation) const {
+        if (handle <= 0) {
+            return false;
+        }
+        uint32_t bits = static_cast<uint32_t>(handle);
+        uint32_t slotIndex = bits & ((1u << kSlotBits) - 1);
+        generation = bits >> kSlotBits;
+        shard = &shards[slotIndex % kShardCount];
+        local = slotIndex / kShardCount;
+        return generation != 0;
+    }
+};
+
+} // namespace ExcelCore
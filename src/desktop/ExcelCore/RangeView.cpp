@@ -0,0 +1,50 @@
+#include "RangeView.h"
+#include <algorithm>
+
+namespace ExcelCore {
+
+CellValue RangeView::getValue(uint32_t rowOffset, uint32_t columnOffset) const {
+    if (worksheet == nullptr || rowOffset >= getRowCount() || columnOffset >= getColumnCount()) {
+        return CellValue();
+    }
+    return worksheet->getCellValue(CellAddress(first.row + rowOffset, first.column + columnOffset));
+}
+
+void RangeView::forEachValue(const std::function<void(const CellAddress&, const CellValue&)>& visitor) const {
+    if (worksheet == nullptr || worksheet->values.getColumnCount() == 0) {
+        return;
+    }
+    // Columns past the last populated one hold nothing
+    uint32_t lastColumn = std::min(last.column, worksheet->values.getColumnCount() - 1);
+    for (uint32_t column = first.column; column <= lastColumn; ++column) {
+        worksheet->values.forEachCell(column, first.row, last.row, visitor);
+    }
+}
+
+AggregateResult RangeView::aggregate(SummationMode mode) const {
+    AggregateResult result;
+    if (worksheet == nullptr || worksheet->values.getColumnCount() == 0) {
+        return result;
+    }
+    uint32_t lastColumn = std::min(last.column, worksheet->values.getColumnCount() - 1);
+    for (uint32_t column = first.column; column <= lastColumn; ++column) {
+        result.merge(Aggregates::aggregateColumn(worksheet->values, column, first.row, last.row, mode), mode);
+    }
+    return result;
+}
+
+CellValue FunctionArgument::toValue() const {
+    if (!isRange()) {
+        return getValue();
+    }
+    const RangeView& range = getRange();
+    if (range.size() == 1) {
+        return range.getValue(0, 0);
+    }
+    return CellValue::error(ErrorCode::Value);
+}
+
+} // namespace ExcelCore
+
+// TODO: Add implicit intersection for multi-cell ranges used as single values
+// TODO: Support 3-D references spanning several worksheets
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "DataStructures.h"
+#include "AggregateKernels.h"
+#include "EvaluationArena.h"
+#include <functional>
+#include <variant>
+
+namespace ExcelCore {
+
+// A lazy, read-only view of a rectangular block of worksheet cells. Nothing is
+// copied when a range is passed to a function: the view only holds the corners
+// and reads the column store when it is iterated or aggregated.
+class RangeView {
+public:
+    RangeView() = default;
+    RangeView(const Worksheet& worksheet, const CellAddress& first, const CellAddress& last)
+        : worksheet(&worksheet), first(first), last(last) {}
+
+    const CellAddress& getFirst() const {
+        return first;
+    }
+
+    const CellAddress& getLast() const {
+        return last;
+    }
+
+    uint32_t getRowCount() const {
+        return last.row - first.row + 1;
+    }
+
+    uint32_t getColumnCount() const {
+        return last.column - first.column + 1;
+    }
+
+    uint64_t size() const {
+        return static_cast<uint64_t>(getRowCount()) * getColumnCount();
+    }
+
+    // Value at an offset from the top-left corner
+    CellValue getValue(uint32_t rowOffset, uint32_t columnOffset) const;
+
+    // Visits the non-empty cells column by column; empty cells are skipped, so
+    // a whole-column view costs as much as the data it holds
+    void forEachValue(const std::function<void(const CellAddress&, const CellValue&)>& visitor) const;
+
+    // Sums, counts and bounds the numeric cells with the vectorized column kernels
+    AggregateResult aggregate(SummationMode mode = SummationMode::Fast) const;
+
+private:
+    const Worksheet* worksheet = nullptr;
+    CellAddress first;
+    CellAddress last;
+};
+
+// A function argument: a single value or a range view
+class FunctionArgument {
+public:
+    FunctionArgument() = default;
+    FunctionArgument(const CellValue& value) : argument(value) {}
+    FunctionArgument(CellValue&& value) : argument(std::move(value)) {}
+    FunctionArgument(const RangeView& range) : argument(range) {}
+
+    bool isRange() const {
+        return std::holds_alternative<RangeView>(argument);
+    }
+
+    const CellValue& getValue() const {
+        return std::get<CellValue>(argument);
+    }
+
+    const RangeView& getRange() const {
+        return std::get<RangeView>(argument);
+    }
+
+    // Reduces the argument to one value: a single-cell range yields its cell,
+    // larger ranges cannot be used where a single value is expected
+    CellValue toValue() const;
+
+private:
+    std::variant<CellValue, RangeView> argument;
+};
+
+// The arguments of one function call: a read-only view into the interpreter's
+// value stack (or its arena scratch), valid only for the duration of the call
+template <typename T>
+class ArgumentList {
+public:
+    ArgumentList() = default;
+    ArgumentList(const T* data, size_t count) : first(data), count(count) {}
+    ArgumentList(const std::vector<T>& values) : first(values.data()), count(values.size()) {}
+    ArgumentList(const ScratchVector<T>& values) : first(values.data()), count(values.size()) {}
+
+    const T* begin() const {
+        return first;
+    }
+
+    const T* end() const {
+        return first + count;
+    }
+
+    const T* data() const {
+        return first;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return first[index];
+    }
+
+private:
+    const T* first = nullptr;
+    size_t count = 0;
+};
+
+} // namespace ExcelCore
@@ -0,0 +1,151 @@
+#include "StringPool.h"
+#include <mutex>
+#include <stdexcept>
+
+namespace ExcelCore {
+
+namespace {
+thread_local StringPool* activeResultPool = nullptr;
+}
+
+StringPool::StringPool() {
+    strings.emplace_back();
+    ids.emplace(std::string_view(strings.back()), 0);
+}
+
+uint32_t StringPool::intern(std::string_view text) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = ids.find(text);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(text);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    uint32_t id = static_cast<uint32_t>(strings.size());
+    if (id >= kResultBit) {
+        throw std::length_error("String pool is full");
+    }
+    strings.emplace_back(text);
+    ids.emplace(std::string_view(strings.back()), id);
+    return id;
+}
+
+// A new result starts without references and is queued for the next reclaim,
+// which frees it unless a cell has retained it by then
+uint32_t StringPool::internResult(std::string_view text) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(text);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    auto result = resultSlots.find(text);
+    if (result != resultSlots.end()) {
+        return result->second | kResultBit;
+    }
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        results[slot].assign(text.data(), text.size());
+        references[slot] = 0;
+    } else {
+        slot = static_cast<uint32_t>(results.size());
+        if (slot >= kResultBit) {
+            throw std::length_error("String pool is full");
+        }
+        results.emplace_back(text);
+        references.push_back(0);
+    }
+    resultSlots.emplace(std::string_view(results[slot]), slot);
+    unreferenced.push_back(slot);
+    return slot | kResultBit;
+}
+
+void StringPool::retain(uint32_t id) {
+    if (!isResult(id)) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    uint32_t slot = id & ~kResultBit;
+    if (slot < references.size() && references[slot] != kFreedSlot) {
+        ++references[slot];
+    }
+}
+
+void StringPool::release(uint32_t id) {
+    if (!isResult(id)) {
+        return;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    uint32_t slot = id & ~kResultBit;
+    if (slot < references.size() && references[slot] != kFreedSlot && references[slot] > 0 &&
+        --references[slot] == 0) {
+        unreferenced.push_back(slot);
+    }
+}
+
+void StringPool::reclaim() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    for (uint32_t slot : unreferenced) {
+        // A slot may be queued more than once, or retained again since
+        if (references[slot] != 0) {
+            continue;
+        }
+        resultSlots.erase(std::string_view(results[slot]));
+        std::string().swap(results[slot]);
+        references[slot] = kFreedSlot;
+        freeSlots.push_back(slot);
+    }
+    unreferenced.clear();
+}
+
+const std::string& StringPool::get(uint32_t id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (isResult(id)) {
+        uint32_t slot = id & ~kResultBit;
+        if (slot >= results.size()) {
+            throw std::out_of_range("Invalid string pool ID");
+        }
+        return results[slot];
+    }
+    if (id >= strings.size()) {
+        throw std::out_of_range("Invalid string pool ID");
+    }
+    return strings[id];
+}
+
+size_t StringPool::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return strings.size();
+}
+
+size_t StringPool::resultCount() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return results.size() - freeSlots.size();
+}
+
+StringPool& StringPool::global() {
+    static StringPool pool;
+    return pool;
+}
+
+StringPool::ResultScope::ResultScope(StringPool& pool) : previous(activeResultPool) {
+    activeResultPool = &pool;
+}
+
+StringPool::ResultScope::~ResultScope() {
+    activeResultPool = previous;
+}
+
+StringPool* StringPool::currentResultPool() {
+    return activeResultPool;
+}
+
+} // namespace ExcelCore
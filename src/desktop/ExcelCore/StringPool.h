@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ExcelCore {
+
+// Per-workbook intern pool for cell strings. Each distinct string is stored
+// once and identified by a stable 32-bit ID; ID 0 is the empty string.
+// Thread-safe: formula results may be interned from recalculation workers.
+//
+// Literal and input strings are interned for the pool's lifetime. Strings a
+// formula computes are result strings instead: they carry kResultBit in their
+// ID, are counted by the cells that hold them (retain/release), and are freed
+// by reclaim() once no cell does, so recalculating volatile text does not grow
+// the pool.
+class StringPool {
+public:
+    static constexpr uint32_t kResultBit = 0x80000000u;
+
+    StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+
+    // Returns the ID of the string, adding it on first use
+    uint32_t intern(std::string_view text);
+
+    // Returns the ID of a formula result string: the interned ID if the text is
+    // interned already, otherwise a result ID that lives until the first
+    // reclaim() at which no cell retains it
+    uint32_t internResult(std::string_view text);
+
+    // Counts a cell holding a result string; no-ops for interned IDs
+    void retain(uint32_t id);
+    void release(uint32_t id);
+
+    // Frees the result strings no cell holds. A value still carrying such an
+    // ID would read another string, so this only runs between recalculations.
+    void reclaim();
+
+    static bool isResult(uint32_t id) {
+        return (id & kResultBit) != 0;
+    }
+
+    // Returns the string for an ID; the reference stays valid for the pool's
+    // lifetime, or for a result string until it is reclaimed
+    const std::string& get(uint32_t id) const;
+
+    // Number of interned strings (IDs 0 to size() - 1)
+    size_t size() const;
+
+    // Number of result strings currently stored
+    size_t resultCount() const;
+
+    // Process-wide pool for strings created without a workbook (e.g. CellValue("text")
+    // in host code); it lives until the process exits
+    static StringPool& global();
+
+    // While a scope is active, strings the thread builds without a pool
+    // (CellValue("text") in a custom function) become result strings of the
+    // given pool instead of entering global(). Set around formula evaluation.
+    class ResultScope {
+    public:
+        explicit ResultScope(StringPool& pool);
+        ~ResultScope();
+
+        ResultScope(const ResultScope&) = delete;
+        ResultScope& operator=(const ResultScope&) = delete;
+
+    private:
+        StringPool* previous;
+    };
+
+    // The pool of the innermost active ResultScope on this thread, if any
+    static StringPool* currentResultPool();
+
+private:
+    static constexpr uint32_t kFreedSlot = UINT32_MAX;
+
+    mutable std::shared_mutex mutex;
+    // std::deque never relocates its elements on push_back, so the views used
+    // as map keys and the references handed out by get() stay valid
+    std::deque<std::string> strings;
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+    // Result strings by slot (the ID without kResultBit). Freed slots are
+    // reused; references holds kFreedSlot for them.
+    std::deque<std::string> results;
+    std::vector<uint32_t> references;
+    std::unordered_map<std::string_view, uint32_t> resultSlots;
+    std::vector<uint32_t> freeSlots;
+    // Slots whose count dropped to zero (or started there) since the last reclaim
+    std::vector<uint32_t> unreferenced;
+};
+
+} // namespace ExcelCore
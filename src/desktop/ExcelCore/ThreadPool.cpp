@@ -0,0 +1,139 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace ExcelCore {
+
+namespace {
+// Identifies the pool and deque of the current worker thread, if any
+thread_local ThreadPool* t_currentPool = nullptr;
+thread_local size_t t_currentIndex = 0;
+}
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    queues.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::defaultThreadCount() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+// Queues a task on the calling worker's deque, or round-robin when called from outside
+void ThreadPool::submit(std::function<void()> task) {
+    size_t index = (t_currentPool == this)
+        ? t_currentIndex
+        : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    unfinishedTasks.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Publishing under wakeMutex prevents a worker from missing the wakeup
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        queuedTasks.fetch_add(1, std::memory_order_release);
+    }
+    wakeCondition.notify_one();
+}
+
+// Waits for all outstanding work, executing stolen tasks on the calling thread
+void ThreadPool::waitIdle() {
+    std::function<void()> task;
+    while (unfinishedTasks.load(std::memory_order_acquire) != 0) {
+        if (trySteal(queues.size(), task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        idleCondition.wait(lock, [this] {
+            return unfinishedTasks.load(std::memory_order_acquire) == 0 ||
+                   queuedTasks.load(std::memory_order_acquire) != 0;
+        });
+    }
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    t_currentPool = this;
+    t_currentIndex = index;
+
+    std::function<void()> task;
+    for (;;) {
+        if (tryPopLocal(index, task) || trySteal(index, task)) {
+            runTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this] {
+            return stopping || queuedTasks.load(std::memory_order_acquire) != 0;
+        });
+        if (stopping && queuedTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+// Takes the most recently pushed task from the worker's own deque
+bool ThreadPool::tryPopLocal(size_t index, std::function<void()>& task) {
+    WorkQueue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+// Takes the oldest task from another deque, starting after the thief's own slot
+bool ThreadPool::trySteal(size_t thiefIndex, std::function<void()>& task) {
+    const size_t count = queues.size();
+    for (size_t offset = 1; offset <= count; ++offset) {
+        WorkQueue& queue = *queues[(thiefIndex + offset) % count];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) {
+            continue;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::runTask(std::function<void()>& task) {
+    try {
+        task();
+    } catch (...) {
+        // Tasks report their own errors; an escaping exception must not kill the worker
+    }
+    task = nullptr;
+
+    if (unfinishedTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        idleCondition.notify_all();
+    }
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ExcelCore {
+
+// Work-stealing thread pool. Every worker owns a deque: it pushes and pops its
+// own work at the back (LIFO, cache friendly) and steals from the front of
+// other workers' deques when it runs dry. Tasks submitted from inside a worker
+// go to that worker's deque, so task trees spread out only when needed.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Queues a task; safe to call from worker threads and from outside the pool
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task (including tasks spawned by tasks) has
+    // finished. The calling thread helps by stealing work while it waits.
+    void waitIdle();
+
+    // Returns std::thread::hardware_concurrency() with a floor of one
+    static size_t defaultThreadCount();
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queuedTasks{0};
+    std::atomic<size_t> unfinishedTasks{0};
+    std::atomic<size_t> nextQueue{0};
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable idleCondition;
+    bool stopping = false;
+
+    void workerLoop(size_t index);
+    bool tryPopLocal(size_t index, std::function<void()>& task);
+    bool trySteal(size_t thiefIndex, std::function<void()>& task);
+    void runTask(std::function<void()>& task);
+};
+
+} // namespace ExcelCore
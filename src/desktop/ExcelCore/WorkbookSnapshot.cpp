@@ -0,0 +1,561 @@
+#include "WorkbookSnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+namespace ExcelCore {
+
+namespace {
+constexpr char kMagic[8] = {'X', 'C', 'S', 'N', 'A', 'P', '\r', '\n'};
+constexpr uint32_t kByteOrderMark = 0x01020304;
+// Dense blocks start here; the mapping is page-aligned, so they are 64-byte aligned
+constexpr uint64_t kPayloadOffset = 64;
+// Program index of a formula cell stored as text (not compiled when saved)
+constexpr uint32_t kTextFormula = 0xFFFFFFFF;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t payloadOffset;
+    uint64_t payloadSize;
+    uint64_t metadataOffset;
+    uint64_t metadataSize;
+};
+
+static_assert(sizeof(SnapshotHeader) <= kPayloadOffset, "Header must fit before the payload");
+static_assert(ColumnChunk::kDenseBytes % 64 == 0, "Dense blocks keep the payload 64-byte aligned");
+
+[[noreturn]] void corrupt() {
+    throw std::runtime_error("Snapshot file is truncated or corrupt");
+}
+
+class MetadataWriter {
+public:
+    std::vector<uint8_t> bytes;
+
+    template <typename T>
+    void put(T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Only plain values are stored");
+        size_t position = bytes.size();
+        bytes.resize(position + sizeof(T));
+        std::memcpy(bytes.data() + position, &value, sizeof(T));
+    }
+
+    void putString(std::string_view text) {
+        put(static_cast<uint32_t>(text.size()));
+        bytes.insert(bytes.end(), text.begin(), text.end());
+    }
+
+    void append(const MetadataWriter& other) {
+        bytes.insert(bytes.end(), other.bytes.begin(), other.bytes.end());
+    }
+};
+
+// Bounds-checked cursor over the mapped metadata
+class MetadataReader {
+public:
+    MetadataReader(const uint8_t* data, size_t size) : position(data), end(data + size) {}
+
+    template <typename T>
+    T get() {
+        if (static_cast<size_t>(end - position) < sizeof(T)) {
+            corrupt();
+        }
+        T value;
+        std::memcpy(&value, position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::string_view getString() {
+        uint32_t size = get<uint32_t>();
+        if (static_cast<size_t>(end - position) < size) {
+            corrupt();
+        }
+        std::string_view text(reinterpret_cast<const char*>(position), size);
+        position += size;
+        return text;
+    }
+
+    // Reads an element count and checks that many elements of at least
+    // minimumBytes each can follow, so a corrupt count cannot drive a huge allocation
+    uint32_t getCount(size_t minimumBytes) {
+        uint32_t count = get<uint32_t>();
+        if (static_cast<uint64_t>(count) * minimumBytes > static_cast<uint64_t>(end - position)) {
+            corrupt();
+        }
+        return count;
+    }
+
+private:
+    const uint8_t* position;
+    const uint8_t* end;
+};
+
+void writeReference(MetadataWriter& out, const FormulaReference& reference) {
+    out.put(reference.row);
+    out.put(reference.column);
+    out.put(static_cast<uint8_t>(reference.rowAbsolute));
+    out.put(static_cast<uint8_t>(reference.columnAbsolute));
+}
+
+FormulaReference readReference(MetadataReader& in) {
+    FormulaReference reference;
+    reference.row = in.get<int32_t>();
+    reference.column = in.get<int32_t>();
+    reference.rowAbsolute = in.get<uint8_t>() != 0;
+    reference.columnAbsolute = in.get<uint8_t>() != 0;
+    return reference;
+}
+
+// CallFunction operands are written as indices into the snapshot's own
+// function name table; strings as IDs in the workbook's pool
+void writeProgram(MetadataWriter& out, const CompiledFormula& program, StringPool& pool,
+                  const std::vector<std::string>& functionNames, std::unordered_map<uint32_t, uint32_t>& functionIds,
+                  std::vector<std::string>& storedFunctions) {
+    out.put(static_cast<uint32_t>(program.code.size()));
+    for (const Instruction& instruction : program.code) {
+        uint32_t operand = instruction.operand;
+        if (instruction.opcode == OpCode::CallFunction) {
+            auto inserted = functionIds.emplace(operand, static_cast<uint32_t>(storedFunctions.size()));
+            if (inserted.second) {
+                storedFunctions.push_back(operand < functionNames.size() ? functionNames[operand] : std::string());
+            }
+            operand = inserted.first->second;
+        }
+        out.put(static_cast<uint8_t>(instruction.opcode));
+        out.put(instruction.argumentCount);
+        out.put(operand);
+    }
+
+    out.put(static_cast<uint32_t>(program.numbers.size()));
+    for (double number : program.numbers) {
+        out.put(number);
+    }
+
+    out.put(static_cast<uint32_t>(program.strings.size()));
+    for (const CellValue& text : program.strings) {
+        out.put(text.getStringPool() == &pool ? text.getStringId() : pool.intern(text.getString()));
+    }
+
+    out.put(static_cast<uint32_t>(program.references.size()));
+    for (const FormulaReference& reference : program.references) {
+        writeReference(out, reference);
+    }
+
+    out.put(static_cast<uint32_t>(program.ranges.size()));
+    for (const FormulaRange& range : program.ranges) {
+        writeReference(out, range.first);
+        writeReference(out, range.last);
+        out.put(static_cast<uint8_t>(range.kind));
+    }
+
+    out.put(static_cast<uint32_t>(program.tokens.size()));
+    for (size_t i = 0; i < program.tokens.size(); ++i) {
+        out.putString(program.tokens[i]);
+        out.put(program.tokenReferences[i]);
+        out.put(program.tokenRanges[i]);
+    }
+
+    out.putString(program.errorMessage);
+}
+
+// Every operand is checked against its pool and the stack depth is recomputed,
+// so the interpreter can trust a loaded program as it trusts a compiled one
+std::shared_ptr<const CompiledFormula> readProgram(MetadataReader& in, const StringPool& pool, size_t poolSize,
+                                                   const std::vector<uint32_t>& functionSlots) {
+    auto program = std::make_shared<CompiledFormula>();
+
+    uint32_t codeCount = in.getCount(7);
+    program->code.reserve(codeCount);
+    for (uint32_t i = 0; i < codeCount; ++i) {
+        uint8_t opcode = in.get<uint8_t>();
+        if (opcode > static_cast<uint8_t>(OpCode::PushError)) {
+            corrupt();
+        }
+        uint16_t argumentCount = in.get<uint16_t>();
+        uint32_t operand = in.get<uint32_t>();
+        program->code.push_back(Instruction{static_cast<OpCode>(opcode), argumentCount, operand});
+    }
+
+    uint32_t numberCount = in.getCount(sizeof(double));
+    program->numbers.reserve(numberCount);
+    for (uint32_t i = 0; i < numberCount; ++i) {
+        program->numbers.push_back(in.get<double>());
+    }
+
+    uint32_t stringCount = in.getCount(sizeof(uint32_t));
+    program->strings.reserve(stringCount);
+    for (uint32_t i = 0; i < stringCount; ++i) {
+        uint32_t id = in.get<uint32_t>();
+        if (id >= poolSize) {
+            corrupt();
+        }
+        program->strings.push_back(CellValue::fromStringId(pool, id));
+    }
+
+    uint32_t referenceCount = in.getCount(10);
+    program->references.reserve(referenceCount);
+    for (uint32_t i = 0; i < referenceCount; ++i) {
+        program->references.push_back(readReference(in));
+    }
+
+    uint32_t rangeCount = in.getCount(21);
+    program->ranges.reserve(rangeCount);
+    for (uint32_t i = 0; i < rangeCount; ++i) {
+        FormulaRange range;
+        range.first = readReference(in);
+        range.last = readReference(in);
+        uint8_t kind = in.get<uint8_t>();
+        if (kind > static_cast<uint8_t>(FormulaRange::Kind::Rows)) {
+            corrupt();
+        }
+        range.kind = static_cast<FormulaRange::Kind>(kind);
+        program->ranges.push_back(range);
+    }
+
+    uint32_t tokenCount = in.getCount(12);
+    program->tokens.reserve(tokenCount);
+    program->tokenReferences.reserve(tokenCount);
+    program->tokenRanges.reserve(tokenCount);
+    for (uint32_t i = 0; i < tokenCount; ++i) {
+        program->tokens.emplace_back(in.getString());
+        int32_t reference = in.get<int32_t>();
+        int32_t range = in.get<int32_t>();
+        if (reference < -1 || reference >= static_cast<int64_t>(referenceCount) ||
+            range < -1 || range >= static_cast<int64_t>(rangeCount)) {
+            corrupt();
+        }
+        program->tokenReferences.push_back(reference);
+        program->tokenRanges.push_back(range);
+    }
+
+    program->errorMessage = std::string(in.getString());
+
+    int64_t depth = 0;
+    for (Instruction& instruction : program->code) {
+        switch (instruction.opcode) {
+            case OpCode::PushNumber:
+            case OpCode::PushString:
+            case OpCode::PushCell:
+            case OpCode::PushRange: {
+                size_t limit = instruction.opcode == OpCode::PushNumber ? numberCount
+                             : instruction.opcode == OpCode::PushString ? stringCount
+                             : instruction.opcode == OpCode::PushCell   ? referenceCount
+                             : rangeCount;
+                if (instruction.operand >= limit) {
+                    corrupt();
+                }
+                ++depth;
+                break;
+            }
+            case OpCode::PushBoolean:
+                ++depth;
+                break;
+            case OpCode::PushError:
+                if (instruction.operand < static_cast<uint32_t>(ErrorCode::Null) ||
+                    instruction.operand > static_cast<uint32_t>(ErrorCode::NA)) {
+                    corrupt();
+                }
+                ++depth;
+                break;
+            case OpCode::CallFunction:
+                if (instruction.operand >= functionSlots.size() || depth < instruction.argumentCount) {
+                    corrupt();
+                }
+                instruction.operand = functionSlots[instruction.operand];
+                depth += 1 - static_cast<int64_t>(instruction.argumentCount);
+                break;
+            case OpCode::Negate:
+            case OpCode::Percent:
+                if (depth < 1) {
+                    corrupt();
+                }
+                break;
+            default:
+                if (depth < 2) {
+                    corrupt();
+                }
+                --depth;
+                break;
+        }
+        program->maxStackDepth = std::max(program->maxStackDepth, static_cast<uint32_t>(depth));
+    }
+    if (!program->code.empty() && depth != 1) {
+        corrupt();
+    }
+    return program;
+}
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path) : path(path) {}
+
+void SnapshotWriter::write(const Workbook& workbook, const std::vector<std::string>& functionNames,
+                           const std::vector<SheetCellAddress>& dirtyCells) {
+    // Written beside the target and renamed over it at the end: truncating a
+    // file that is still mapped by an open snapshot would pull pages out from under it
+    std::string temporaryPath = path + ".tmp";
+    std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Cannot create snapshot file: " + path);
+    }
+
+    try {
+        StringPool& pool = *workbook.stringPool;
+        out.write(std::string(kPayloadOffset, '\0').data(), kPayloadOffset);
+
+        // Worksheets first: dense blocks go straight to the payload, and the
+        // programs they use are collected for the metadata
+        MetadataWriter sheets;
+        std::unordered_map<const CompiledFormula*, uint32_t> programIds;
+        std::vector<const CompiledFormula*> storedPrograms;
+        std::vector<uint64_t> block(ColumnChunk::kDenseBytes / sizeof(uint64_t));
+        std::vector<ColumnChunk::SparseEntry> entries;
+        uint64_t blockCount = 0;
+
+        sheets.put(static_cast<uint32_t>(workbook.getWorksheetCount()));
+        for (const Worksheet& worksheet : workbook.worksheets) {
+            const ColumnStore& values = worksheet.values;
+            sheets.putString(worksheet.name);
+            sheets.put(values.getColumnCount());
+            for (uint32_t column = 0; column < values.getColumnCount(); ++column) {
+                uint32_t chunkCount = 0;
+                for (uint32_t chunkIndex = 0; chunkIndex < values.getChunkCount(column); ++chunkIndex) {
+                    chunkCount += values.getChunk(column, chunkIndex) != nullptr ? 1 : 0;
+                }
+                sheets.put(chunkCount);
+                for (uint32_t chunkIndex = 0; chunkIndex < values.getChunkCount(column); ++chunkIndex) {
+                    const ColumnChunk* chunk = values.getChunk(column, chunkIndex);
+                    if (!chunk) {
+                        continue;
+                    }
+                    sheets.put(chunkIndex);
+                    sheets.put(static_cast<uint8_t>(chunk->getMode()));
+                    values.copyChunk(column, chunkIndex, block.data(), entries);
+                    if (chunk->getMode() == ColumnChunk::Mode::Dense) {
+                        out.write(reinterpret_cast<const char*>(block.data()), ColumnChunk::kDenseBytes);
+                        sheets.put(blockCount++);
+                    } else {
+                        sheets.put(static_cast<uint32_t>(entries.size()));
+                        for (const ColumnChunk::SparseEntry& entry : entries) {
+                            sheets.put(entry.row);
+                            sheets.put(entry.type);
+                            sheets.put(entry.stringId);
+                            sheets.put(entry.number);
+                        }
+                    }
+                }
+            }
+
+            sheets.put(static_cast<uint32_t>(worksheet.formulas.size()));
+            for (const auto& entry : worksheet.formulas) {
+                sheets.put(entry.first.row);
+                sheets.put(entry.first.column);
+                const CompiledFormula* program = entry.second.compiledFormula.get();
+                if (program == nullptr) {
+                    sheets.put(kTextFormula);
+                    sheets.putString(entry.second.formula);
+                    continue;
+                }
+                auto inserted = programIds.emplace(program, static_cast<uint32_t>(storedPrograms.size()));
+                if (inserted.second) {
+                    storedPrograms.push_back(program);
+                }
+                sheets.put(inserted.first->second);
+            }
+        }
+
+        // Programs may intern strings from other pools, so the string table comes last
+        MetadataWriter programs;
+        std::unordered_map<uint32_t, uint32_t> functionIds;
+        std::vector<std::string> storedFunctions;
+        programs.put(static_cast<uint32_t>(storedPrograms.size()));
+        for (const CompiledFormula* program : storedPrograms) {
+            writeProgram(programs, *program, pool, functionNames, functionIds, storedFunctions);
+        }
+
+        MetadataWriter metadata;
+        metadata.putString(workbook.name);
+        uint32_t stringCount = static_cast<uint32_t>(pool.size());
+        metadata.put(stringCount);
+        for (uint32_t id = 1; id < stringCount; ++id) {
+            metadata.putString(pool.get(id));
+        }
+        metadata.put(static_cast<uint32_t>(storedFunctions.size()));
+        for (const std::string& name : storedFunctions) {
+            metadata.putString(name);
+        }
+        metadata.append(programs);
+        metadata.put(static_cast<uint32_t>(dirtyCells.size()));
+        for (const SheetCellAddress& cell : dirtyCells) {
+            metadata.put(cell.sheetIndex);
+            metadata.put(cell.address.row);
+            metadata.put(cell.address.column);
+        }
+        metadata.append(sheets);
+        out.write(reinterpret_cast<const char*>(metadata.bytes.data()), static_cast<std::streamsize>(metadata.bytes.size()));
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kVersion;
+        header.byteOrder = kByteOrderMark;
+        header.payloadOffset = kPayloadOffset;
+        header.payloadSize = blockCount * ColumnChunk::kDenseBytes;
+        header.metadataOffset = kPayloadOffset + header.payloadSize;
+        header.metadataSize = metadata.bytes.size();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Cannot write snapshot file: " + path);
+        }
+        std::filesystem::rename(temporaryPath, path);
+    } catch (...) {
+        out.close();
+        std::error_code ignored;
+        std::filesystem::remove(temporaryPath, ignored);
+        throw;
+    }
+}
+
+SnapshotReader::SnapshotReader(const std::string& path) : file(std::make_shared<MappedFile>(path)) {
+    SnapshotHeader header;
+    if (file->size() < sizeof(header)) {
+        corrupt();
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a workbook snapshot: " + path);
+    }
+    if (header.version != SnapshotWriter::kVersion || header.byteOrder != kByteOrderMark) {
+        throw std::runtime_error("Snapshot was written by an incompatible build: " + path);
+    }
+}
+
+void SnapshotReader::read(Workbook& workbook, const std::function<uint32_t(const std::string&)>& resolveFunction) {
+    SnapshotHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+    uint64_t size = file->size();
+    if (header.payloadOffset % alignof(double) != 0 || header.payloadSize % ColumnChunk::kDenseBytes != 0 ||
+        header.payloadOffset > size || header.payloadSize > size - header.payloadOffset ||
+        header.metadataOffset > size || header.metadataSize > size - header.metadataOffset) {
+        corrupt();
+    }
+    uint64_t blockCount = header.payloadSize / ColumnChunk::kDenseBytes;
+    uint8_t* payload = file->data() + header.payloadOffset;
+    MetadataReader in(file->data() + header.metadataOffset, static_cast<size_t>(header.metadataSize));
+
+    workbook.name = std::string(in.getString());
+
+    // Interned in stored order into a fresh pool, so every ID keeps its value
+    StringPool& pool = *workbook.stringPool;
+    uint32_t stringCount = in.getCount(sizeof(uint32_t));
+    if (stringCount == 0 || pool.size() != 1) {
+        corrupt();
+    }
+    for (uint32_t id = 1; id < stringCount; ++id) {
+        if (pool.intern(in.getString()) != id) {
+            corrupt();
+        }
+    }
+
+    uint32_t functionCount = in.getCount(sizeof(uint32_t));
+    std::vector<uint32_t> functionSlots;
+    functionSlots.reserve(functionCount);
+    for (uint32_t i = 0; i < functionCount; ++i) {
+        functionSlots.push_back(resolveFunction(std::string(in.getString())));
+    }
+
+    uint32_t programCount = in.getCount(7 * sizeof(uint32_t));
+    programs.reserve(programCount);
+    for (uint32_t i = 0; i < programCount; ++i) {
+        programs.push_back(readProgram(in, pool, stringCount, functionSlots));
+    }
+
+    uint32_t dirtyCount = in.getCount(3 * sizeof(uint32_t));
+    dirtyCells.reserve(dirtyCount);
+    for (uint32_t i = 0; i < dirtyCount; ++i) {
+        uint32_t sheetIndex = in.get<uint32_t>();
+        uint32_t row = in.get<uint32_t>();
+        uint32_t column = in.get<uint32_t>();
+        dirtyCells.emplace_back(sheetIndex, CellAddress(row, column));
+    }
+
+    uint32_t sheetCount = in.getCount(3 * sizeof(uint32_t));
+    workbook.worksheets.reserve(sheetCount);
+    for (uint32_t sheetIndex = 0; sheetIndex < sheetCount; ++sheetIndex) {
+        Worksheet& worksheet = workbook.addWorksheet(std::string(in.getString()));
+        uint32_t columnCount = in.getCount(sizeof(uint32_t));
+        for (uint32_t column = 0; column < columnCount; ++column) {
+            uint32_t chunkCount = in.getCount(2 * sizeof(uint32_t));
+            for (uint32_t i = 0; i < chunkCount; ++i) {
+                uint32_t chunkIndex = in.get<uint32_t>();
+                if (chunkIndex >= kMaxRows / ColumnChunk::kRows || column >= kMaxColumns) {
+                    corrupt();
+                }
+                if (in.get<uint8_t>() == static_cast<uint8_t>(ColumnChunk::Mode::Dense)) {
+                    uint64_t blockIndex = in.get<uint64_t>();
+                    if (blockIndex >= blockCount) {
+                        corrupt();
+                    }
+                    worksheet.values.attachDenseChunk(column, chunkIndex, payload + blockIndex * ColumnChunk::kDenseBytes, file);
+                    continue;
+                }
+
+                uint32_t entryCount = in.getCount(15);
+                if (entryCount > ColumnChunk::kRows) {
+                    corrupt();
+                }
+                std::vector<ColumnChunk::SparseEntry> entries(entryCount);
+                for (uint32_t e = 0; e < entryCount; ++e) {
+                    ColumnChunk::SparseEntry& entry = entries[e];
+                    entry.row = in.get<uint16_t>();
+                    entry.type = in.get<uint8_t>();
+                    entry.stringId = in.get<uint32_t>();
+                    entry.number = in.get<double>();
+                    if (entry.row >= ColumnChunk::kRows || (e > 0 && entry.row <= entries[e - 1].row) ||
+                        entry.type > static_cast<uint8_t>(CellType::Empty) || entry.stringId >= stringCount) {
+                        corrupt();
+                    }
+                }
+                worksheet.values.loadSparseChunk(column, chunkIndex, std::move(entries));
+            }
+        }
+
+        uint32_t formulaCount = in.getCount(3 * sizeof(uint32_t));
+        worksheet.formulas.reserve(formulaCount);
+        for (uint32_t i = 0; i < formulaCount; ++i) {
+            uint32_t row = in.get<uint32_t>();
+            uint32_t column = in.get<uint32_t>();
+            CellAddress address(row, column);
+            uint32_t programIndex = in.get<uint32_t>();
+            if (address.row >= kMaxRows || address.column >= kMaxColumns) {
+                corrupt();
+            }
+            FormulaCell& cell = worksheet.formulas[address];
+            if (programIndex == kTextFormula) {
+                cell.setFormula(std::string(in.getString()));
+            } else if (programIndex < programs.size()) {
+                cell.compiledFormula = programs[programIndex];
+            } else {
+                corrupt();
+            }
+            worksheet.values.reserve(address);
+        }
+    }
+
+    for (const SheetCellAddress& cell : dirtyCells) {
+        if (cell.sheetIndex >= sheetCount) {
+            corrupt();
+        }
+    }
+}
+
+} // namespace ExcelCore
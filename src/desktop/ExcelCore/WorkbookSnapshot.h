@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CompiledFormula.h"
+#include "DataStructures.h"
+#include "MappedFile.h"
+
+namespace ExcelCore {
+
+// Native binary snapshot of a workbook for fast reopening: the string pool,
+// every column chunk, the compiled formula programs and the cells changed
+// since the last recalculation. Values are stored in the machine's own layout, so a
+// snapshot is only readable by builds with the same byte order (XLSX is the
+// interchange format).
+//
+// Layout: a header, a payload of dense chunks as raw ColumnChunk::kDenseBytes
+// blocks, and a metadata section with everything else. The reader maps the
+// file copy-on-write and points dense chunks straight at their blocks, so
+// opening reads only the metadata; values are paged in on first access and
+// copied only when a chunk is written.
+class SnapshotWriter {
+public:
+    static constexpr uint32_t kVersion = 2;
+
+    explicit SnapshotWriter(const std::string& path);
+
+    // functionNames maps the slots of CallFunction instructions to function
+    // names; dirtyCells are the cells changed since the last recalculation.
+    // The file is replaced atomically, so a mapped older snapshot stays valid.
+    void write(const Workbook& workbook, const std::vector<std::string>& functionNames,
+               const std::vector<SheetCellAddress>& dirtyCells);
+
+private:
+    std::string path;
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path);
+
+    // Loads the snapshot into an empty workbook. resolveFunction returns the
+    // slot of a stored function name in the parser that will run the programs.
+    void read(Workbook& workbook, const std::function<uint32_t(const std::string&)>& resolveFunction);
+
+    // Programs referenced by the loaded formula cells, each stored once
+    const std::vector<std::shared_ptr<const CompiledFormula>>& getPrograms() const {
+        return programs;
+    }
+
+    const std::vector<SheetCellAddress>& getDirtyCells() const {
+        return dirtyCells;
+    }
+
+private:
+    std::shared_ptr<MappedFile> file;
+    std::vector<std::shared_ptr<const CompiledFormula>> programs;
+    std::vector<SheetCellAddress> dirtyCells;
+};
+
+} // namespace ExcelCore
+
+// TODO: Store the dependency graph's edges as flat arrays so opening does not rebuild it
+// TODO: Compress sparse chunks and formula tables
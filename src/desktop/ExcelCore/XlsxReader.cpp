@@ -0,0 +1,667 @@
+#include "XlsxReader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace ExcelCore {
+
+namespace {
+using Event = XmlScanner::Event;
+
+// Days from 1970-01-01 to the 1899-12-30 epoch of Excel serial dates
+constexpr double kExcelEpochOffsetDays = 25569.0;
+constexpr double kSecondsPerDay = 86400.0;
+
+// Serial dates are fractions of a day, so a time such as 12:30:00 comes out a
+// few nanoseconds short; Excel resolves times to the millisecond
+double serialToSeconds(double serial) {
+    return std::round((serial - kExcelEpochOffsetDays) * kSecondsPerDay * 1000.0) / 1000.0;
+}
+
+bool endsWith(std::string_view text, std::string_view suffix) {
+    return text.size() >= suffix.size() && text.substr(text.size() - suffix.size()) == suffix;
+}
+
+// Resolves a relationship target against the directory of the part that owns it
+std::string resolvePath(const std::string& baseDirectory, std::string_view target) {
+    std::string combined = !target.empty() && target[0] == '/' ? std::string(target.substr(1))
+                                                                : baseDirectory + std::string(target);
+    std::vector<std::string> segments;
+    size_t start = 0;
+    while (start <= combined.size()) {
+        size_t slash = combined.find('/', start);
+        std::string segment = combined.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+        if (segment == "..") {
+            if (!segments.empty()) {
+                segments.pop_back();
+            }
+        } else if (!segment.empty() && segment != ".") {
+            segments.push_back(segment);
+        }
+        if (slash == std::string::npos) {
+            break;
+        }
+        start = slash + 1;
+    }
+    std::string path;
+    for (const auto& segment : segments) {
+        if (!path.empty()) {
+            path += '/';
+        }
+        path += segment;
+    }
+    return path;
+}
+
+std::string directoryOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+template <typename T>
+bool parseInteger(std::string_view text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+bool parseNumber(std::string_view text, double& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+// Zero-based column of the letters at the start of text ("AB12" -> 27); returns the letter count
+size_t parseColumn(std::string_view text, uint32_t& column) {
+    size_t i = 0;
+    column = 0;
+    while (i < text.size() && i < 3 && std::isalpha(static_cast<unsigned char>(text[i]))) {
+        column = column * 26 + static_cast<uint32_t>(std::toupper(static_cast<unsigned char>(text[i])) - 'A' + 1);
+        ++i;
+    }
+    if (i > 0) {
+        --column;
+    }
+    return i;
+}
+
+std::string columnLetters(uint32_t column) {
+    std::string letters;
+    for (uint32_t value = column + 1; value > 0; value = (value - 1) / 26) {
+        letters.insert(letters.begin(), static_cast<char>('A' + (value - 1) % 26));
+    }
+    return letters;
+}
+
+// Parses a cell reference such as "B12" (no '$')
+bool parseCellReference(std::string_view text, CellAddress& address) {
+    uint32_t column;
+    size_t letters = parseColumn(text, column);
+    uint32_t row;
+    if (letters == 0 || !parseInteger(text.substr(letters), row) || row == 0) {
+        return false;
+    }
+    address = CellAddress(row - 1, column);
+    return true;
+}
+
+// Expands the _xHHHH_ escapes OOXML uses for characters XML cannot carry
+void decodeEscapes(std::string& text) {
+    size_t escape = text.find("_x");
+    if (escape == std::string::npos) {
+        return;
+    }
+    std::string out;
+    out.reserve(text.size());
+    size_t i = 0;
+    while (escape != std::string::npos) {
+        uint32_t codePoint = 0;
+        bool valid = escape + 7 <= text.size() && text[escape + 6] == '_';
+        if (valid) {
+            auto result = std::from_chars(text.data() + escape + 2, text.data() + escape + 6, codePoint, 16);
+            valid = result.ec == std::errc() && result.ptr == text.data() + escape + 6;
+        }
+        if (!valid) {
+            escape = text.find("_x", escape + 1);
+            continue;
+        }
+        out.append(text, i, escape - i);
+        if (codePoint < 0x80) {
+            out += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codePoint >> 6));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xE0 | (codePoint >> 12));
+            out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        i = escape + 7;
+        escape = text.find("_x", i);
+    }
+    out.append(text, i, std::string::npos);
+    text.swap(out);
+}
+
+// Text of a string item (<si>, <is>): plain <t> or rich-text runs, without phonetic hints
+void readRichText(XmlScanner& scanner, std::string& out) {
+    size_t openRuns = 0;
+    for (;;) {
+        Event event = scanner.next();
+        if (event == Event::End) {
+            break;
+        }
+        if (event == Event::EndElement) {
+            if (openRuns == 0) {
+                break;
+            }
+            --openRuns;
+        } else if (event == Event::StartElement) {
+            if (scanner.name() == "t") {
+                scanner.readElementText(out);
+            } else if (scanner.name() == "r") {
+                ++openRuns;
+            } else {
+                // Run properties and phonetic hints (rPh) carry no cell text
+                scanner.skipElement();
+            }
+        }
+    }
+    decodeEscapes(out);
+}
+
+// "2024-03-01T12:30:00" (cells of type d) as seconds since 1970
+bool parseIsoDate(std::string_view text, double& seconds) {
+    int year, month, day, hour = 0, minute = 0;
+    double second = 0.0;
+    if (text.size() < 10 || !parseInteger(text.substr(0, 4), year) || !parseInteger(text.substr(5, 2), month) ||
+        !parseInteger(text.substr(8, 2), day)) {
+        return false;
+    }
+    if (text.size() >= 16 && text[10] == 'T') {
+        if (!parseInteger(text.substr(11, 2), hour) || !parseInteger(text.substr(14, 2), minute)) {
+            return false;
+        }
+        if (text.size() >= 19) {
+            size_t secondEnd = text.find_first_not_of("0123456789.", 17);
+            parseNumber(text.substr(17, secondEnd == std::string_view::npos ? std::string_view::npos : secondEnd - 17), second);
+        }
+    }
+    seconds = static_cast<double>(daysFromCivil(year, month, day)) * kSecondsPerDay + hour * 3600.0 + minute * 60.0 + second;
+    return true;
+}
+
+// Whether a number format code displays a date or time
+bool isDateFormatCode(std::string_view code) {
+    bool quoted = false;
+    for (size_t i = 0; i < code.size(); ++i) {
+        char character = code[i];
+        if (character == '"') {
+            quoted = !quoted;
+        } else if (quoted) {
+            continue;
+        } else if (character == '\\' || character == '_' || character == '*') {
+            ++i;
+        } else if (character == '[') {
+            size_t close = code.find(']', i);
+            if (close == std::string_view::npos) {
+                break;
+            }
+            i = close;
+        } else if (character == ';') {
+            break;
+        } else {
+            switch (std::tolower(static_cast<unsigned char>(character))) {
+                case 'y':
+                case 'm':
+                case 'd':
+                case 'h':
+                case 's':
+                    return true;
+                default:
+                    break;
+            }
+        }
+    }
+    return false;
+}
+
+bool isBuiltInDateFormat(uint32_t id) {
+    return (id >= 14 && id <= 22) || (id >= 27 && id <= 36) || (id >= 45 && id <= 47) || (id >= 50 && id <= 58);
+}
+
+// Cell types as written in the t attribute
+enum class CellKind {
+    Number,
+    SharedString,
+    InlineString,
+    FormulaString,
+    Boolean,
+    Error,
+    Date
+};
+
+CellKind parseCellKind(std::string_view type) {
+    if (type.empty() || type == "n") return CellKind::Number;
+    if (type == "s") return CellKind::SharedString;
+    if (type == "inlineStr") return CellKind::InlineString;
+    if (type == "str") return CellKind::FormulaString;
+    if (type == "b") return CellKind::Boolean;
+    if (type == "e") return CellKind::Error;
+    if (type == "d") return CellKind::Date;
+    throw std::runtime_error("Unknown cell type: " + std::string(type));
+}
+} // namespace
+
+XlsxReader::XlsxReader(const std::string& path) : archive(path) {}
+
+std::unique_ptr<XmlScanner> XlsxReader::openPart(const std::string& path) {
+    const ZipReader::Entry* entry = archive.findEntry(path);
+    if (entry == nullptr) {
+        return nullptr;
+    }
+    std::shared_ptr<ZipReader::EntryStream> stream = archive.open(*entry);
+    return std::make_unique<XmlScanner>([stream](char* buffer, size_t size) { return stream->read(buffer, size); });
+}
+
+void XlsxReader::read(Workbook& workbook) {
+    std::string workbookPath = readPackageRelationships();
+    readWorkbookPart(workbookPath);
+    readSharedStrings(*workbook.stringPool);
+    readStyles();
+
+    for (const auto& sheet : sheets) {
+        Worksheet& worksheet = workbook.addWorksheet(sheet.name);
+        readWorksheet(sheet.path, worksheet);
+    }
+}
+
+// Finds the workbook part through the package relationships (_rels/.rels)
+std::string XlsxReader::readPackageRelationships() {
+    std::unique_ptr<XmlScanner> scanner = openPart("_rels/.rels");
+    if (scanner) {
+        for (Event event; (event = scanner->next()) != Event::End;) {
+            if (event == Event::StartElement && scanner->name() == "Relationship" &&
+                endsWith(scanner->attribute("Type"), "/officeDocument")) {
+                return resolvePath(std::string(), scanner->attribute("Target"));
+            }
+        }
+    }
+    return "xl/workbook.xml";
+}
+
+// Reads the sheet list and the locations of the shared strings and styles parts
+void XlsxReader::readWorkbookPart(const std::string& workbookPath) {
+    std::string directory = directoryOf(workbookPath);
+    std::string relationshipsPath = directory + "_rels/" + workbookPath.substr(directory.size()) + ".rels";
+
+    std::unordered_map<std::string, std::string> targets;
+    if (std::unique_ptr<XmlScanner> scanner = openPart(relationshipsPath)) {
+        for (Event event; (event = scanner->next()) != Event::End;) {
+            if (event != Event::StartElement || scanner->name() != "Relationship") {
+                continue;
+            }
+            std::string target = resolvePath(directory, scanner->attribute("Target"));
+            std::string_view type = scanner->attribute("Type");
+            if (endsWith(type, "/sharedStrings")) {
+                sharedStringsPath = target;
+            } else if (endsWith(type, "/styles")) {
+                stylesPath = target;
+            }
+            targets.emplace(std::string(scanner->attribute("Id")), std::move(target));
+        }
+    }
+
+    std::unique_ptr<XmlScanner> scanner = openPart(workbookPath);
+    if (!scanner) {
+        throw std::runtime_error("Not an XLSX file: missing " + workbookPath);
+    }
+    for (Event event; (event = scanner->next()) != Event::End;) {
+        if (event != Event::StartElement || scanner->name() != "sheet") {
+            continue;
+        }
+        auto target = targets.find(std::string(scanner->attribute("id")));
+        if (target == targets.end()) {
+            throw std::runtime_error("Missing worksheet part for sheet " + std::string(scanner->attribute("name")));
+        }
+        sheets.push_back(SheetPart{std::string(scanner->attribute("name")), target->second});
+    }
+}
+
+// Interns every shared string once; cells then only carry pool IDs
+void XlsxReader::readSharedStrings(StringPool& pool) {
+    sharedStrings.clear();
+    std::unique_ptr<XmlScanner> scanner = sharedStringsPath.empty() ? nullptr : openPart(sharedStringsPath);
+    if (!scanner) {
+        return;
+    }
+    std::string text;
+    for (Event event; (event = scanner->next()) != Event::End;) {
+        if (event != Event::StartElement) {
+            continue;
+        }
+        if (scanner->name() == "sst") {
+            uint32_t uniqueCount = 0;
+            if (parseInteger(scanner->attribute("uniqueCount"), uniqueCount)) {
+                sharedStrings.reserve(uniqueCount);
+            }
+        } else if (scanner->name() == "si") {
+            text.clear();
+            readRichText(*scanner, text);
+            sharedStrings.push_back(pool.intern(text));
+        }
+    }
+}
+
+// Records which cell formats display dates, so date serials load as dates
+void XlsxReader::readStyles() {
+    dateFormats.clear();
+    std::unique_ptr<XmlScanner> scanner = stylesPath.empty() ? nullptr : openPart(stylesPath);
+    if (!scanner) {
+        return;
+    }
+    std::unordered_map<uint32_t, bool> customFormats;
+    bool inCellFormats = false;
+    for (Event event; (event = scanner->next()) != Event::End;) {
+        if (event == Event::EndElement && scanner->name() == "cellXfs") {
+            inCellFormats = false;
+        }
+        if (event != Event::StartElement) {
+            continue;
+        }
+        if (scanner->name() == "numFmt") {
+            uint32_t id;
+            if (parseInteger(scanner->attribute("numFmtId"), id)) {
+                customFormats[id] = isDateFormatCode(scanner->attribute("formatCode"));
+            }
+        } else if (scanner->name() == "cellXfs") {
+            inCellFormats = true;
+        } else if (inCellFormats && scanner->name() == "xf") {
+            uint32_t id = 0;
+            parseInteger(scanner->attribute("numFmtId"), id);
+            auto custom = customFormats.find(id);
+            dateFormats.push_back(custom != customFormats.end() ? custom->second : isBuiltInDateFormat(id));
+        }
+    }
+}
+
+void XlsxReader::readWorksheet(const std::string& path, Worksheet& worksheet) {
+    std::unique_ptr<XmlScanner> scanner = openPart(path);
+    if (!scanner) {
+        throw std::runtime_error("Missing worksheet part " + path);
+    }
+    StringPool& pool = worksheet.values.getStringPool();
+
+    struct PendingCell {
+        CellAddress address;
+        CellValue value;
+        bool hasFormula;
+    };
+    std::vector<PendingCell> batch;
+    batch.reserve(kBatchCells);
+
+    // Rows arrive in order, so grouping a batch by column gives each column
+    // chunk one run of ascending writes instead of one write per row
+    auto flush = [&]() {
+        std::stable_sort(batch.begin(), batch.end(), [](const PendingCell& a, const PendingCell& b) {
+            return a.address.column < b.address.column;
+        });
+        for (const auto& cell : batch) {
+            if (cell.value.getType() == CellType::Empty) {
+                if (cell.hasFormula) {
+                    worksheet.values.reserve(cell.address);
+                }
+            } else {
+                worksheet.values.set(cell.address, cell.value);
+            }
+        }
+        batch.clear();
+    };
+
+    struct SharedFormula {
+        CellAddress origin;
+        std::string text;
+    };
+    std::unordered_map<uint32_t, SharedFormula> sharedFormulas;
+
+    uint32_t currentRow = 0;
+    uint32_t nextRow = 0;
+    uint32_t nextColumn = 0;
+    std::string valueText;
+    std::string formulaText;
+    for (Event event; (event = scanner->next()) != Event::End;) {
+        if (event != Event::StartElement) {
+            continue;
+        }
+        if (scanner->name() == "row") {
+            // r is optional: rows without it follow the previous one
+            uint32_t rowNumber;
+            currentRow = parseInteger(scanner->attribute("r"), rowNumber) && rowNumber > 0 ? rowNumber - 1 : nextRow;
+            nextRow = currentRow + 1;
+            nextColumn = 0;
+            continue;
+        }
+        if (scanner->name() != "c") {
+            // Columns, merged cells, conditional formats etc. are not part of the model yet
+            if (scanner->name() != "worksheet" && scanner->name() != "sheetData") {
+                scanner->skipElement();
+            }
+            continue;
+        }
+
+        // The attributes are views into the scanner's buffer: decode them before reading on
+        CellAddress address(currentRow, nextColumn);
+        std::string_view reference = scanner->attribute("r");
+        if (!reference.empty() && !parseCellReference(reference, address)) {
+            throw std::runtime_error("Invalid cell reference " + std::string(reference));
+        }
+        nextColumn = address.column + 1;
+        CellKind kind = parseCellKind(scanner->attribute("t"));
+        uint32_t style = 0;
+        parseInteger(scanner->attribute("s"), style);
+
+        valueText.clear();
+        formulaText.clear();
+        bool hasValue = false;
+        bool hasFormula = false;
+        for (Event inner; (inner = scanner->next()) != Event::EndElement || scanner->name() != "c";) {
+            if (inner == Event::End) {
+                throw std::runtime_error("Unexpected end of worksheet " + path);
+            }
+            if (inner != Event::StartElement) {
+                continue;
+            }
+            if (scanner->name() == "v") {
+                scanner->readElementText(valueText);
+                hasValue = true;
+            } else if (scanner->name() == "is") {
+                readRichText(*scanner, valueText);
+                hasValue = true;
+            } else if (scanner->name() == "f") {
+                std::string_view formulaType = scanner->attribute("t");
+                uint32_t sharedIndex = 0;
+                bool shared = formulaType == "shared" && parseInteger(scanner->attribute("si"), sharedIndex);
+                if (formulaType == "dataTable") {
+                    scanner->skipElement();
+                    continue;
+                }
+                scanner->readElementText(formulaText);
+                if (shared) {
+                    if (!formulaText.empty()) {
+                        sharedFormulas[sharedIndex] = SharedFormula{address, formulaText};
+                    } else {
+                        auto master = sharedFormulas.find(sharedIndex);
+                        if (master != sharedFormulas.end()) {
+                            formulaText = shiftFormula(master->second.text,
+                                                       int64_t(address.row) - master->second.origin.row,
+                                                       int64_t(address.column) - master->second.origin.column);
+                        }
+                    }
+                }
+                hasFormula = !formulaText.empty();
+            } else {
+                scanner->skipElement();
+            }
+        }
+
+        CellValue value;
+        if (hasValue) {
+            switch (kind) {
+                case CellKind::SharedString: {
+                    uint32_t index;
+                    if (!parseInteger(valueText, index) || index >= sharedStrings.size()) {
+                        throw std::runtime_error("Invalid shared string index in " + address.toString());
+                    }
+                    value = CellValue::fromStringId(pool, sharedStrings[index]);
+                    break;
+                }
+                case CellKind::InlineString:
+                case CellKind::FormulaString:
+                    value = CellValue(pool, valueText);
+                    break;
+                case CellKind::Boolean:
+                    value = CellValue(valueText == "1" || valueText == "true");
+                    break;
+                case CellKind::Error: {
+                    ErrorCode code = parseErrorCode(valueText);
+                    value = CellValue::error(code != ErrorCode::None ? code : ErrorCode::Value);
+                    break;
+                }
+                case CellKind::Date: {
+                    double seconds;
+                    value = parseIsoDate(valueText, seconds) ? CellValue::fromDateSeconds(seconds) : CellValue(pool, valueText);
+                    break;
+                }
+                case CellKind::Number: {
+                    double number;
+                    if (!parseNumber(valueText, number)) {
+                        throw std::runtime_error("Invalid number in " + address.toString());
+                    }
+                    if (style < dateFormats.size() && dateFormats[style]) {
+                        value = CellValue::fromDateSeconds(serialToSeconds(number));
+                    } else {
+                        value = CellValue(number);
+                    }
+                    break;
+                }
+            }
+        }
+
+        if (hasFormula) {
+            worksheet.formulas[address].setFormula("=" + formulaText);
+        }
+        if (hasFormula || value.getType() != CellType::Empty) {
+            batch.push_back(PendingCell{address, value, hasFormula});
+            if (batch.size() == kBatchCells) {
+                flush();
+            }
+        }
+    }
+    flush();
+}
+
+std::string XlsxReader::shiftFormula(const std::string& formula, int64_t rowOffset, int64_t columnOffset) {
+    auto isTokenCharacter = [](char character) {
+        return std::isalnum(static_cast<unsigned char>(character)) || character == '$' || character == '_' ||
+               character == '.';
+    };
+
+    std::string out;
+    out.reserve(formula.size() + 8);
+    for (size_t i = 0; i < formula.size();) {
+        char character = formula[i];
+
+        // String literals, quoted sheet names and structured references are copied as they are
+        if (character == '"' || character == '\'' || character == '[') {
+            char close = character == '[' ? ']' : character;
+            size_t j = i + 1;
+            while (j < formula.size()) {
+                if (formula[j] == close) {
+                    if (close != ']' && j + 1 < formula.size() && formula[j + 1] == close) {
+                        j += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++j;
+            }
+            j = std::min(j + 1, formula.size());
+            out.append(formula, i, j - i);
+            i = j;
+            continue;
+        }
+        if (!isTokenCharacter(character)) {
+            out += character;
+            ++i;
+            continue;
+        }
+
+        size_t j = i;
+        while (j < formula.size() && isTokenCharacter(formula[j])) {
+            ++j;
+        }
+        std::string_view token(formula.data() + i, j - i);
+        char following = j < formula.size() ? formula[j] : '\0';
+        char preceding = i > 0 ? formula[i - 1] : '\0';
+        bool inRange = following == ':' || preceding == ':';
+        i = j;
+
+        if (following == '(' || following == '!') {
+            out.append(token.data(), token.size());
+            continue;
+        }
+
+        // Split into [$]letters[$]digits
+        size_t k = 0;
+        bool columnAbsolute = k < token.size() && token[k] == '$';
+        k += columnAbsolute ? 1 : 0;
+        size_t letterStart = k;
+        while (k < token.size() && std::isalpha(static_cast<unsigned char>(token[k]))) {
+            ++k;
+        }
+        size_t letterCount = k - letterStart;
+        bool rowAbsolute = k < token.size() && token[k] == '$';
+        k += rowAbsolute ? 1 : 0;
+        size_t digitStart = k;
+        while (k < token.size() && std::isdigit(static_cast<unsigned char>(token[k]))) {
+            ++k;
+        }
+        size_t digitCount = k - digitStart;
+        bool whole = k == token.size();
+
+        bool cellReference = whole && letterCount >= 1 && letterCount <= 3 && digitCount > 0;
+        bool columnReference = whole && inRange && letterCount >= 1 && letterCount <= 3 && digitCount == 0 && !rowAbsolute;
+        bool rowReference = whole && inRange && letterCount == 0 && digitCount > 0 && !rowAbsolute;
+        if (!cellReference && !columnReference && !rowReference) {
+            out.append(token.data(), token.size());
+            continue;
+        }
+
+        std::string shifted;
+        bool valid = true;
+        if (letterCount > 0) {
+            uint32_t column;
+            parseColumn(token.substr(letterStart, letterCount), column);
+            int64_t target = columnAbsolute ? column : int64_t(column) + columnOffset;
+            valid = target >= 0 && target < int64_t(kMaxColumns);
+            shifted += columnAbsolute ? "$" : "";
+            shifted += valid ? columnLetters(static_cast<uint32_t>(target)) : "";
+        }
+        if (digitCount > 0) {
+            // A bare row reference keeps its '$' in the column slot
+            bool absolute = letterCount > 0 ? rowAbsolute : columnAbsolute;
+            int64_t row = 0;
+            parseInteger(token.substr(digitStart, digitCount), row);
+            int64_t target = absolute ? row : row + rowOffset;
+            valid = valid && target >= 1 && target <= int64_t(kMaxRows);
+            shifted += absolute ? "$" : "";
+            shifted += std::to_string(target);
+        }
+        out += valid ? shifted : "#REF!";
+    }
+    return out;
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataStructures.h"
+#include "XmlScanner.h"
+#include "ZipArchive.h"
+
+namespace ExcelCore {
+
+// Streaming XLSX (Office Open XML) reader. Worksheet XML is inflated and
+// tokenized on the fly and cells are written into the column store in batches,
+// so memory use is the workbook's own plus a few fixed-size buffers. Shared
+// strings are interned into the workbook's string pool once; cells refer to
+// them by pool ID.
+//
+// Formulas are loaded as text together with their cached results, so a loaded
+// workbook shows the values saved in the file without recalculating.
+class XlsxReader {
+public:
+    // Cells buffered before they are written to the column store
+    static constexpr size_t kBatchCells = 64 * 1024;
+
+    explicit XlsxReader(const std::string& path);
+
+    // Appends the file's worksheets to the workbook, in workbook order
+    void read(Workbook& workbook);
+
+    // Moves the relative references of a formula (A1 notation, no leading '=')
+    // by the given offsets, as Excel does when copying it; used to expand
+    // shared formulas. References pushed off the sheet become #REF!.
+    static std::string shiftFormula(const std::string& formula, int64_t rowOffset, int64_t columnOffset);
+
+private:
+    struct SheetPart {
+        std::string name;
+        std::string path;
+    };
+
+    ZipReader archive;
+    std::vector<SheetPart> sheets;
+    std::string sharedStringsPath;
+    std::string stylesPath;
+    // Shared string index -> string pool ID
+    std::vector<uint32_t> sharedStrings;
+    // Cell format (cellXfs) index -> whether it displays a date
+    std::vector<bool> dateFormats;
+
+    std::unique_ptr<XmlScanner> openPart(const std::string& path);
+    std::string readPackageRelationships();
+    void readWorkbookPart(const std::string& workbookPath);
+    void readSharedStrings(StringPool& pool);
+    void readStyles();
+    void readWorksheet(const std::string& path, Worksheet& worksheet);
+};
+
+} // namespace ExcelCore
+
+// TODO: Read defined names, merged cells and column widths
+// TODO: Load worksheets in parallel (one archive handle per thread)
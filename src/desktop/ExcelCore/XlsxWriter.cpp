@@ -0,0 +1,333 @@
+#include "XlsxWriter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace ExcelCore {
+
+namespace {
+constexpr double kExcelEpochOffsetDays = 25569.0;
+constexpr double kSecondsPerDay = 86400.0;
+// Index of the date cell format in the styles part written below
+constexpr const char* kDateStyle = "1";
+
+const char* const kContentTypesHeader =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+    "<Override PartName=\"/xl/workbook.xml\" "
+    "ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>"
+    "<Override PartName=\"/xl/styles.xml\" "
+    "ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.styles+xml\"/>"
+    "<Override PartName=\"/xl/sharedStrings.xml\" "
+    "ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sharedStrings+xml\"/>";
+
+const char* const kPackageRelationships =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Id=\"rId1\" "
+    "Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\" "
+    "Target=\"xl/workbook.xml\"/>"
+    "</Relationships>";
+
+// Cell format 0 is General, 1 shows dates (built-in format 22, "m/d/yy h:mm")
+const char* const kStyles =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+    "<styleSheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<fonts count=\"1\"><font><sz val=\"11\"/><name val=\"Calibri\"/></font></fonts>"
+    "<fills count=\"2\"><fill><patternFill patternType=\"none\"/></fill>"
+    "<fill><patternFill patternType=\"gray125\"/></fill></fills>"
+    "<borders count=\"1\"><border><left/><right/><top/><bottom/><diagonal/></border></borders>"
+    "<cellStyleXfs count=\"1\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\"/></cellStyleXfs>"
+    "<cellXfs count=\"2\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\"/>"
+    "<xf numFmtId=\"22\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/></cellXfs>"
+    "<cellStyles count=\"1\"><cellStyle name=\"Normal\" xfId=\"0\" builtinId=\"0\"/></cellStyles>"
+    "</styleSheet>";
+
+const char* const kRelationshipType = "http://schemas.openxmlformats.org/officeDocument/2006/relationships/";
+
+// Escapes text for XML content and attributes. With cellText, control
+// characters and literal "_x" sequences use the OOXML _xHHHH_ escape.
+void appendEscaped(std::string& out, std::string_view text, bool cellText = false) {
+    static const char* const kHex = "0123456789ABCDEF";
+    for (size_t i = 0; i < text.size(); ++i) {
+        char character = text[i];
+        switch (character) {
+            case '&': out += "&amp;"; break;
+            case '<': out += "&lt;"; break;
+            case '>': out += "&gt;"; break;
+            case '"': out += "&quot;"; break;
+            default: {
+                unsigned char code = static_cast<unsigned char>(character);
+                bool control = code < 0x20 && code != '\t' && code != '\n' && code != '\r';
+                bool literalEscape = cellText && character == '_' && i + 1 < text.size() && text[i + 1] == 'x';
+                if (control || literalEscape) {
+                    if (!cellText) {
+                        break;
+                    }
+                    out += "_x00";
+                    out += kHex[code >> 4];
+                    out += kHex[code & 15];
+                    out += '_';
+                } else {
+                    out += character;
+                }
+                break;
+            }
+        }
+    }
+}
+
+void appendNumber(std::string& out, double number) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr);
+}
+
+void appendInteger(std::string& out, uint64_t number) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    out.append(digits, result.ptr);
+}
+} // namespace
+
+XlsxWriter::XlsxWriter(const std::string& path) : archive(path) {}
+
+void XlsxWriter::writePart(const std::string& name, const std::string& content) {
+    archive.beginEntry(name);
+    archive.write(content);
+    archive.endEntry();
+}
+
+void XlsxWriter::write(const Workbook& workbook) {
+    const size_t sheetCount = workbook.getWorksheetCount();
+
+    std::string contentTypes = kContentTypesHeader;
+    std::string workbookXml =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+        "<workbook xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" "
+        "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\"><sheets>";
+    std::string relationships =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+        "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">";
+    for (size_t i = 0; i < sheetCount; ++i) {
+        std::string number = std::to_string(i + 1);
+        contentTypes += "<Override PartName=\"/xl/worksheets/sheet" + number +
+                        ".xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>";
+        workbookXml += "<sheet name=\"";
+        appendEscaped(workbookXml, workbook.getWorksheet(i).name);
+        workbookXml += "\" sheetId=\"" + number + "\" r:id=\"rId" + number + "\"/>";
+        relationships += "<Relationship Id=\"rId" + number + "\" Type=\"" + kRelationshipType +
+                         "worksheet\" Target=\"worksheets/sheet" + number + ".xml\"/>";
+    }
+    contentTypes += "</Types>";
+    workbookXml += "</sheets></workbook>";
+    std::string stylesId = std::to_string(sheetCount + 1);
+    std::string sharedStringsId = std::to_string(sheetCount + 2);
+    relationships += "<Relationship Id=\"rId" + stylesId + "\" Type=\"" + kRelationshipType +
+                     "styles\" Target=\"styles.xml\"/>";
+    relationships += "<Relationship Id=\"rId" + sharedStringsId + "\" Type=\"" + kRelationshipType +
+                     "sharedStrings\" Target=\"sharedStrings.xml\"/>";
+    relationships += "</Relationships>";
+
+    writePart("[Content_Types].xml", contentTypes);
+    writePart("_rels/.rels", kPackageRelationships);
+    writePart("xl/workbook.xml", workbookXml);
+    writePart("xl/_rels/workbook.xml.rels", relationships);
+    writePart("xl/styles.xml", kStyles);
+    for (size_t i = 0; i < sheetCount; ++i) {
+        writeWorksheet("xl/worksheets/sheet" + std::to_string(i + 1) + ".xml", workbook.getWorksheet(i));
+    }
+    // Written last: its contents are collected while the worksheets are written
+    writeSharedStrings();
+    archive.finish();
+}
+
+void XlsxWriter::flushXml(bool force) {
+    if (force || xml.size() >= kFlushSize) {
+        archive.write(xml);
+        xml.clear();
+    }
+}
+
+uint32_t XlsxWriter::sharedStringIndexOf(std::string_view text) {
+    auto inserted = sharedStringIndex.emplace(text, static_cast<uint32_t>(sharedStrings.size()));
+    if (inserted.second) {
+        sharedStrings.push_back(text);
+    }
+    return inserted.first->second;
+}
+
+void XlsxWriter::writeWorksheet(const std::string& name, const Worksheet& worksheet) {
+    archive.beginEntry(name);
+    xml = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+          "<worksheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" "
+          "xmlns:r=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships\"><sheetData>";
+
+    // Formulas without a stored result have no value slot to visit, so they
+    // are merged in from a sorted list of formula cells
+    std::vector<CellAddress> formulaCells;
+    formulaCells.reserve(worksheet.formulas.size());
+    uint32_t lastRow = 0;
+    for (const auto& entry : worksheet.formulas) {
+        if (entry.second.hasFormula()) {
+            formulaCells.push_back(entry.first);
+            lastRow = std::max(lastRow, entry.first.row);
+        }
+    }
+    auto rowMajor = [](const CellAddress& a, const CellAddress& b) {
+        return a.row != b.row ? a.row < b.row : a.column < b.column;
+    };
+    std::sort(formulaCells.begin(), formulaCells.end(), rowMajor);
+
+    const ColumnStore& values = worksheet.values;
+    const uint32_t columnCount = values.getColumnCount();
+    for (uint32_t column = 0; column < columnCount; ++column) {
+        uint32_t chunkCount = values.getChunkCount(column);
+        if (chunkCount > 0) {
+            lastRow = std::max(lastRow, chunkCount * ColumnChunk::kRows - 1);
+        }
+    }
+
+    // The column store is column-major; cells are gathered one band of rows at a time
+    std::vector<std::pair<CellAddress, CellValue>> band;
+    size_t nextFormula = 0;
+    const bool empty = columnCount == 0 && formulaCells.empty();
+    for (uint32_t firstRow = 0; !empty && firstRow <= lastRow; firstRow += ColumnChunk::kRows) {
+        uint32_t bandLastRow = firstRow + ColumnChunk::kRows - 1;
+        band.clear();
+        for (uint32_t column = 0; column < columnCount; ++column) {
+            values.forEachCell(column, firstRow, bandLastRow, [&](const CellAddress& address, const CellValue& value) {
+                band.emplace_back(address, value);
+            });
+        }
+        for (; nextFormula < formulaCells.size() && formulaCells[nextFormula].row <= bandLastRow; ++nextFormula) {
+            band.emplace_back(formulaCells[nextFormula], CellValue());
+        }
+        // Row-major order; a formula cell that also has a value keeps the value
+        std::sort(band.begin(), band.end(), [&](const auto& a, const auto& b) {
+            if (a.first != b.first) {
+                return rowMajor(a.first, b.first);
+            }
+            return a.second.getType() != CellType::Empty && b.second.getType() == CellType::Empty;
+        });
+        band.erase(std::unique(band.begin(), band.end(), [](const auto& a, const auto& b) { return a.first == b.first; }),
+                   band.end());
+
+        for (size_t i = 0; i < band.size();) {
+            uint32_t row = band[i].first.row;
+            xml += "<row r=\"";
+            appendInteger(xml, uint64_t(row) + 1);
+            xml += "\">";
+            for (; i < band.size() && band[i].first.row == row; ++i) {
+                writeCell(worksheet, band[i].first, band[i].second);
+            }
+            xml += "</row>";
+            flushXml(false);
+        }
+    }
+
+    xml += "</sheetData></worksheet>";
+    flushXml(true);
+    archive.endEntry();
+}
+
+void XlsxWriter::writeCell(const Worksheet& worksheet, const CellAddress& address, const CellValue& value) {
+    const FormulaCell* formulaCell = worksheet.findFormulaCell(address);
+    std::string formula = formulaCell != nullptr && formulaCell->hasFormula() ? formulaCell->getFormula(address) : std::string();
+    if (!formula.empty() && formula[0] == '=') {
+        formula.erase(0, 1);
+    }
+
+    xml += "<c r=\"";
+    xml += address.toString();
+    xml += '"';
+
+    CellType type = value.getType();
+    double number = type == CellType::Date ? value.getDateSeconds() / kSecondsPerDay + kExcelEpochOffsetDays
+                                           : value.getNumber();
+    bool numeric = type == CellType::Number || type == CellType::Date;
+    if (numeric && !std::isfinite(number)) {
+        // Excel has no infinities or NaN; they surface as #NUM!
+        type = CellType::Error;
+    }
+    switch (type) {
+        case CellType::String:
+            xml += formula.empty() ? " t=\"s\"" : " t=\"str\"";
+            break;
+        case CellType::Boolean:
+            xml += " t=\"b\"";
+            break;
+        case CellType::Error:
+            xml += " t=\"e\"";
+            break;
+        case CellType::Date:
+            xml += " s=\"";
+            xml += kDateStyle;
+            xml += '"';
+            break;
+        default:
+            break;
+    }
+    xml += '>';
+
+    if (!formula.empty()) {
+        xml += "<f>";
+        appendEscaped(xml, formula);
+        xml += "</f>";
+    }
+    switch (type) {
+        case CellType::Number:
+        case CellType::Date:
+            xml += "<v>";
+            appendNumber(xml, number);
+            xml += "</v>";
+            break;
+        case CellType::String:
+            xml += "<v>";
+            if (formula.empty()) {
+                appendInteger(xml, sharedStringIndexOf(value.getString()));
+            } else {
+                appendEscaped(xml, value.getString(), true);
+            }
+            xml += "</v>";
+            break;
+        case CellType::Boolean:
+            xml += value.getBoolean() ? "<v>1</v>" : "<v>0</v>";
+            break;
+        case CellType::Error:
+            xml += "<v>";
+            xml += errorCodeText(value.getErrorCode() != ErrorCode::None ? value.getErrorCode() : ErrorCode::Num);
+            xml += "</v>";
+            break;
+        default:
+            break;
+    }
+    xml += "</c>";
+}
+
+void XlsxWriter::writeSharedStrings() {
+    archive.beginEntry("xl/sharedStrings.xml");
+    xml = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n"
+          "<sst xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\" count=\"";
+    appendInteger(xml, sharedStrings.size());
+    xml += "\" uniqueCount=\"";
+    appendInteger(xml, sharedStrings.size());
+    xml += "\">";
+    for (std::string_view text : sharedStrings) {
+        bool preserve = !text.empty() && (text.front() == ' ' || text.back() == ' ' ||
+                                          text.find_first_of("\t\n\r") != std::string_view::npos);
+        xml += preserve ? "<si><t xml:space=\"preserve\">" : "<si><t>";
+        appendEscaped(xml, text, true);
+        xml += "</t></si>";
+        flushXml(false);
+    }
+    xml += "</sst>";
+    flushXml(true);
+    archive.endEntry();
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "DataStructures.h"
+#include "ZipArchive.h"
+
+namespace ExcelCore {
+
+// Streaming XLSX (Office Open XML) writer. Worksheets are written a band of
+// ColumnChunk::kRows rows at a time straight into the compressed archive, so
+// only one band of cells is held in memory. Strings go to the shared strings
+// table once each, keyed by their text in the string pool.
+class XlsxWriter {
+public:
+    explicit XlsxWriter(const std::string& path);
+
+    void write(const Workbook& workbook);
+
+private:
+    // Bytes of XML buffered before they are handed to the archive
+    static constexpr size_t kFlushSize = 64 * 1024;
+
+    ZipWriter archive;
+    std::string xml;
+    // Shared strings in order of first use; the views point into string pools
+    std::unordered_map<std::string_view, uint32_t> sharedStringIndex;
+    std::vector<std::string_view> sharedStrings;
+
+    void writePart(const std::string& name, const std::string& content);
+    void writeWorksheet(const std::string& name, const Worksheet& worksheet);
+    void writeCell(const Worksheet& worksheet, const CellAddress& address, const CellValue& value);
+    void writeSharedStrings();
+    void flushXml(bool force);
+    uint32_t sharedStringIndexOf(std::string_view text);
+};
+
+} // namespace ExcelCore
+
+// TODO: Write cell styles and number formats beyond the built-in date format
@@ -0,0 +1,318 @@
+#include "XmlScanner.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace ExcelCore {
+
+namespace {
+bool isSpace(char character) {
+    return character == ' ' || character == '\t' || character == '\n' || character == '\r';
+}
+
+void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+} // namespace
+
+XmlScanner::XmlScanner(Source source) : source(std::move(source)), buffer(kChunkSize) {}
+
+// Makes at least `required` unread bytes available, unless the input ends first.
+// May move the buffered bytes, so offsets are kept relative to `position`.
+bool XmlScanner::fill(size_t required) {
+    while (end - position < required && !exhausted) {
+        if (position > 0) {
+            std::memmove(buffer.data(), buffer.data() + position, end - position);
+            end -= position;
+            position = 0;
+        }
+        if (buffer.size() - end < kChunkSize) {
+            buffer.resize(end + kChunkSize);
+        }
+        size_t count = source(buffer.data() + end, buffer.size() - end);
+        if (count == 0) {
+            exhausted = true;
+        }
+        end += count;
+    }
+    return end - position >= required;
+}
+
+size_t XmlScanner::find(char character, size_t from) {
+    for (;;) {
+        size_t available = end - position;
+        if (from < available) {
+            const char* start = buffer.data() + position;
+            const void* hit = std::memchr(start + from, character, available - from);
+            if (hit != nullptr) {
+                return static_cast<size_t>(static_cast<const char*>(hit) - start);
+            }
+            from = available;
+        }
+        if (!fill(available + 1)) {
+            return std::string_view::npos;
+        }
+    }
+}
+
+size_t XmlScanner::find(std::string_view text, size_t from) {
+    for (;;) {
+        size_t available = end - position;
+        std::string_view window(buffer.data() + position, available);
+        size_t hit = window.find(text, from);
+        if (hit != std::string_view::npos) {
+            return hit;
+        }
+        if (available >= text.size()) {
+            from = std::max(from, available - text.size() + 1);
+        }
+        if (!fill(available + 1)) {
+            return std::string_view::npos;
+        }
+    }
+}
+
+// Offset of the '>' closing the tag at `position`; '>' inside quoted attribute values does not count
+size_t XmlScanner::findTagEnd() {
+    char quote = 0;
+    size_t i = 1;
+    for (;;) {
+        if (i >= end - position && !fill(i + 1)) {
+            return std::string_view::npos;
+        }
+        // Scan what is buffered without re-checking the refill condition per byte
+        const char* data = buffer.data() + position;
+        size_t available = end - position;
+        for (; i < available; ++i) {
+            char character = data[i];
+            if (quote != 0) {
+                if (character == quote) {
+                    quote = 0;
+                }
+            } else if (character == '"' || character == '\'') {
+                quote = character;
+            } else if (character == '>') {
+                return i;
+            }
+        }
+    }
+}
+
+std::string_view XmlScanner::decode(std::string_view raw) {
+    size_t ampersand = raw.find('&');
+    if (ampersand == std::string_view::npos) {
+        return raw;
+    }
+
+    std::string& out = decoded.emplace_back();
+    out.reserve(raw.size());
+    out.append(raw.data(), ampersand);
+    for (size_t i = ampersand; i < raw.size();) {
+        if (raw[i] != '&') {
+            out += raw[i++];
+            continue;
+        }
+        size_t semicolon = raw.find(';', i);
+        std::string_view entity = semicolon == std::string_view::npos ? std::string_view() : raw.substr(i + 1, semicolon - i - 1);
+        if (entity == "lt") {
+            out += '<';
+        } else if (entity == "gt") {
+            out += '>';
+        } else if (entity == "amp") {
+            out += '&';
+        } else if (entity == "quot") {
+            out += '"';
+        } else if (entity == "apos") {
+            out += '\'';
+        } else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x' || entity[1] == 'X';
+            uint32_t codePoint = static_cast<uint32_t>(
+                std::strtoul(std::string(entity.substr(hex ? 2 : 1)).c_str(), nullptr, hex ? 16 : 10));
+            appendUtf8(out, codePoint);
+        } else {
+            // Not an entity we know: keep the text as written
+            out += '&';
+            ++i;
+            continue;
+        }
+        i = semicolon + 1;
+    }
+    return out;
+}
+
+std::string_view XmlScanner::localName(std::string_view name) {
+    size_t colon = name.find(':');
+    return colon == std::string_view::npos ? name : name.substr(colon + 1);
+}
+
+void XmlScanner::parseAttributes(std::string_view body) {
+    size_t i = 0;
+    while (i < body.size()) {
+        while (i < body.size() && isSpace(body[i])) {
+            ++i;
+        }
+        size_t nameStart = i;
+        while (i < body.size() && body[i] != '=' && !isSpace(body[i])) {
+            ++i;
+        }
+        std::string_view attributeName = body.substr(nameStart, i - nameStart);
+        while (i < body.size() && (isSpace(body[i]) || body[i] == '=')) {
+            ++i;
+        }
+        if (i >= body.size() || (body[i] != '"' && body[i] != '\'')) {
+            break;
+        }
+        char quote = body[i++];
+        size_t valueEnd = body.find(quote, i);
+        if (valueEnd == std::string_view::npos) {
+            throw std::runtime_error("Malformed XML attribute");
+        }
+        // Namespace declarations would shadow prefixed attributes ("xmlns:r" vs "r")
+        if (attributeName != "xmlns" && attributeName.substr(0, 6) != "xmlns:") {
+            attributes.emplace_back(localName(attributeName), decode(body.substr(i, valueEnd - i)));
+        }
+        i = valueEnd + 1;
+    }
+}
+
+std::string_view XmlScanner::attribute(std::string_view attributeName) const {
+    for (const auto& entry : attributes) {
+        if (entry.first == attributeName) {
+            return entry.second;
+        }
+    }
+    return {};
+}
+
+XmlScanner::Event XmlScanner::next() {
+    attributes.clear();
+    if (!decoded.empty()) {
+        decoded.clear();
+    }
+    if (pendingEnd) {
+        // The name of the self-closing tag is still current
+        pendingEnd = false;
+        --depth;
+        return Event::EndElement;
+    }
+
+    for (;;) {
+        if (!fill(1)) {
+            return Event::End;
+        }
+
+        if (buffer[position] != '<') {
+            size_t length = find('<', 0);
+            if (length == std::string_view::npos) {
+                length = end - position;
+            }
+            std::string_view raw(buffer.data() + position, length);
+            position += length;
+            currentText = decode(raw);
+            return Event::Text;
+        }
+
+        if (!fill(2)) {
+            throw std::runtime_error("Unexpected end of XML");
+        }
+        char kind = buffer[position + 1];
+        if (kind == '?' || kind == '!') {
+            if (kind == '!' && fill(9) && std::string_view(buffer.data() + position, 9) == "<![CDATA[") {
+                size_t close = find("]]>", 9);
+                if (close == std::string_view::npos) {
+                    throw std::runtime_error("Unterminated CDATA section");
+                }
+                currentText = std::string_view(buffer.data() + position + 9, close - 9);
+                position += close + 3;
+                return Event::Text;
+            }
+            bool comment = kind == '!' && fill(4) && std::string_view(buffer.data() + position, 4) == "<!--";
+            size_t close = comment ? find("-->", 4) : kind == '?' ? find("?>", 2) : find('>', 2);
+            if (close == std::string_view::npos) {
+                throw std::runtime_error("Unterminated XML declaration or comment");
+            }
+            position += close + (comment ? 3 : kind == '?' ? 2 : 1);
+            continue;
+        }
+
+        size_t close = findTagEnd();
+        if (close == std::string_view::npos) {
+            throw std::runtime_error("Unterminated XML tag");
+        }
+        std::string_view body(buffer.data() + position + 1, close - 1);
+        position += close + 1;
+
+        if (kind == '/') {
+            body.remove_prefix(1);
+            while (!body.empty() && isSpace(body.back())) {
+                body.remove_suffix(1);
+            }
+            currentName = localName(body);
+            if (depth == 0) {
+                throw std::runtime_error("Unbalanced XML end tag");
+            }
+            --depth;
+            return Event::EndElement;
+        }
+
+        bool selfClosing = !body.empty() && body.back() == '/';
+        if (selfClosing) {
+            body.remove_suffix(1);
+        }
+        size_t nameEnd = 0;
+        while (nameEnd < body.size() && !isSpace(body[nameEnd])) {
+            ++nameEnd;
+        }
+        currentName = localName(body.substr(0, nameEnd));
+        parseAttributes(body.substr(nameEnd));
+        ++depth;
+        pendingEnd = selfClosing;
+        return Event::StartElement;
+    }
+}
+
+void XmlScanner::skipElement() {
+    size_t target = depth - 1;
+    for (;;) {
+        Event event = next();
+        if (event == Event::End) {
+            throw std::runtime_error("Unexpected end of XML");
+        }
+        if (event == Event::EndElement && depth == target) {
+            return;
+        }
+    }
+}
+
+void XmlScanner::readElementText(std::string& out) {
+    size_t target = depth - 1;
+    for (;;) {
+        Event event = next();
+        if (event == Event::End) {
+            throw std::runtime_error("Unexpected end of XML");
+        }
+        if (event == Event::Text) {
+            out.append(currentText.data(), currentText.size());
+        } else if (event == Event::EndElement && depth == target) {
+            return;
+        }
+    }
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ExcelCore {
+
+// Pull-style (SAX-like) XML tokenizer for streamed input. Only a window of the
+// document is buffered: the buffer grows to the largest single tag or text run,
+// never to the document. Namespace prefixes are stripped from element and
+// attribute names ("x:row" -> "row"); DTDs, comments and processing
+// instructions are skipped.
+class XmlScanner {
+public:
+    enum class Event {
+        StartElement,
+        EndElement,
+        Text,
+        End
+    };
+
+    // Fills up to size bytes and returns how many were read; 0 at the end of input
+    using Source = std::function<size_t(char*, size_t)>;
+
+    explicit XmlScanner(Source source);
+
+    // Advances to the next event. A self-closing tag yields StartElement
+    // followed by EndElement. The views returned by the accessors below are
+    // valid until the next call.
+    Event next();
+
+    std::string_view name() const {
+        return currentName;
+    }
+
+    // Entity-decoded text of a Text event
+    std::string_view text() const {
+        return currentText;
+    }
+
+    // Entity-decoded attribute value; empty if the element has no such attribute
+    std::string_view attribute(std::string_view attributeName) const;
+
+    // Skips the content of the element just started, up to its end tag
+    void skipElement();
+
+    // Appends the text content of the element just started (including text
+    // inside its descendants) and consumes its end tag
+    void readElementText(std::string& out);
+
+private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    Source source;
+    std::vector<char> buffer;
+    size_t position = 0;
+    size_t end = 0;
+    bool exhausted = false;
+    bool pendingEnd = false;
+    size_t depth = 0;
+
+    std::string_view currentName;
+    std::string_view currentText;
+    std::vector<std::pair<std::string_view, std::string_view>> attributes;
+    // Owns decoded copies of text and attribute values that contained entities
+    std::deque<std::string> decoded;
+
+    bool fill(size_t required);
+    size_t find(char character, size_t from);
+    size_t find(std::string_view text, size_t from);
+    size_t findTagEnd();
+    std::string_view decode(std::string_view raw);
+    void parseAttributes(std::string_view body);
+    static std::string_view localName(std::string_view name);
+};
+
+} // namespace ExcelCore
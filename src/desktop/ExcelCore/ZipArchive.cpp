@@ -0,0 +1,839 @@
+#include "ZipArchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace ExcelCore {
+
+namespace {
+constexpr uint32_t kLocalHeaderSignature = 0x04034b50;
+constexpr uint32_t kCentralHeaderSignature = 0x02014b50;
+constexpr uint32_t kEndOfDirectorySignature = 0x06054b50;
+constexpr uint32_t kZip64LocatorSignature = 0x07064b50;
+constexpr uint32_t kZip64EndOfDirectorySignature = 0x06064b50;
+constexpr uint16_t kMethodStored = 0;
+constexpr uint16_t kMethodDeflated = 8;
+constexpr size_t kInputBufferSize = 64 * 1024;
+
+// DEFLATE length and distance codes: base value and number of extra bits
+constexpr uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+                                        513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Slicing-by-8 tables: values[k][b] is the CRC of byte b followed by k zero bytes
+struct CrcTable {
+    uint32_t values[8][256];
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            values[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                values[k][i] = (values[k - 1][i] >> 8) ^ values[0][values[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+uint32_t reverseBits(uint32_t code, uint32_t length) {
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
+}
+
+uint64_t readLE(const unsigned char* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; --i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+void appendLE(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void readExactly(std::ifstream& file, char* buffer, size_t size) {
+    if (!file.read(buffer, static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Unexpected end of ZIP archive");
+    }
+}
+} // namespace
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc) {
+    static const CrcTable table;
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint32_t low = crc ^ (uint32_t(bytes[i]) | uint32_t(bytes[i + 1]) << 8 | uint32_t(bytes[i + 2]) << 16 |
+                              uint32_t(bytes[i + 3]) << 24);
+        crc = table.values[7][low & 0xFF] ^ table.values[6][(low >> 8) & 0xFF] ^
+              table.values[5][(low >> 16) & 0xFF] ^ table.values[4][low >> 24] ^
+              table.values[3][bytes[i + 4]] ^ table.values[2][bytes[i + 5]] ^
+              table.values[1][bytes[i + 6]] ^ table.values[0][bytes[i + 7]];
+    }
+    for (; i < size; ++i) {
+        crc = table.values[0][(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// ---------------------------------------------------------------------------
+// Inflater
+
+Inflater::Inflater(std::ifstream& input, uint64_t compressedSize)
+    : input(input), remainingInput(compressedSize), inputBuffer(kInputBufferSize),
+      output(new uint8_t[kWindowSize + kOutputSize]) {}
+
+uint8_t Inflater::nextByte() {
+    if (inputPosition == inputEnd) {
+        if (remainingInput == 0) {
+            // Lookahead may run past the last byte; consuming that far is corruption
+            if (++paddingBytes > 8) {
+                throw std::runtime_error("Truncated deflate stream");
+            }
+            return 0;
+        }
+        size_t count = static_cast<size_t>(std::min<uint64_t>(remainingInput, inputBuffer.size()));
+        readExactly(input, inputBuffer.data(), count);
+        remainingInput -= count;
+        inputPosition = 0;
+        inputEnd = count;
+    }
+    return static_cast<uint8_t>(inputBuffer[inputPosition++]);
+}
+
+void Inflater::needBits(uint32_t count) {
+    while (bitCount < count) {
+        bitBuffer |= static_cast<uint64_t>(nextByte()) << bitCount;
+        bitCount += 8;
+    }
+}
+
+uint32_t Inflater::takeBits(uint32_t count) {
+    needBits(count);
+    uint32_t value = static_cast<uint32_t>(bitBuffer & ((uint64_t(1) << count) - 1));
+    bitBuffer >>= count;
+    bitCount -= count;
+    return value;
+}
+
+void Inflater::buildTable(HuffmanTable& table, const uint8_t* lengths, uint32_t count) {
+    table.counts.fill(0);
+    table.fast.fill(0);
+    for (uint32_t symbol = 0; symbol < count; ++symbol) {
+        ++table.counts[lengths[symbol]];
+    }
+    table.counts[0] = 0;
+
+    int left = 1;
+    for (uint32_t length = 1; length < 16; ++length) {
+        left = (left << 1) - table.counts[length];
+        if (left < 0) {
+            throw std::runtime_error("Invalid Huffman code lengths");
+        }
+    }
+
+    std::array<uint16_t, 16> offsets{};
+    std::array<uint32_t, 16> nextCode{};
+    uint32_t code = 0;
+    for (uint32_t length = 1; length < 16; ++length) {
+        if (length < 15) {
+            offsets[length + 1] = static_cast<uint16_t>(offsets[length] + table.counts[length]);
+        }
+        code = (code + table.counts[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    for (uint32_t symbol = 0; symbol < count; ++symbol) {
+        uint32_t length = lengths[symbol];
+        if (length == 0) {
+            continue;
+        }
+        table.symbols[offsets[length]++] = static_cast<uint16_t>(symbol);
+        uint32_t symbolCode = nextCode[length]++;
+        if (length <= kFastBits) {
+            uint16_t entry = static_cast<uint16_t>(symbol << 4 | length);
+            for (uint32_t i = reverseBits(symbolCode, length); i < (1u << kFastBits); i += 1u << length) {
+                table.fast[i] = entry;
+            }
+        }
+    }
+}
+
+uint32_t Inflater::decodeSymbol(const HuffmanTable& table) {
+    needBits(kFastBits);
+    uint16_t entry = table.fast[bitBuffer & ((1u << kFastBits) - 1)];
+    if (entry != 0) {
+        uint32_t length = entry & 15;
+        bitBuffer >>= length;
+        bitCount -= length;
+        return entry >> 4;
+    }
+
+    // Long code: walk the canonical code one bit at a time
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (uint32_t length = 1; length < 16; ++length) {
+        code |= static_cast<int>(takeBits(1));
+        int count = table.counts[length];
+        if (code - count < first) {
+            return table.symbols[index + (code - first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    throw std::runtime_error("Invalid Huffman code");
+}
+
+void Inflater::readDynamicTables() {
+    static constexpr uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    uint32_t literalCount = takeBits(5) + 257;
+    uint32_t distanceCount = takeBits(5) + 1;
+    uint32_t codeLengthCount = takeBits(4) + 4;
+    if (literalCount > 286 || distanceCount > 30) {
+        throw std::runtime_error("Invalid deflate block header");
+    }
+
+    uint8_t lengths[320] = {};
+    for (uint32_t i = 0; i < codeLengthCount; ++i) {
+        lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(takeBits(3));
+    }
+    HuffmanTable codeLengthTable;
+    buildTable(codeLengthTable, lengths, 19);
+
+    uint8_t codeLengths[320] = {};
+    uint32_t total = literalCount + distanceCount;
+    for (uint32_t n = 0; n < total;) {
+        uint32_t symbol = decodeSymbol(codeLengthTable);
+        if (symbol < 16) {
+            codeLengths[n++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        uint8_t value = 0;
+        uint32_t repeat;
+        if (symbol == 16) {
+            if (n == 0) {
+                throw std::runtime_error("Invalid deflate code lengths");
+            }
+            value = codeLengths[n - 1];
+            repeat = 3 + takeBits(2);
+        } else if (symbol == 17) {
+            repeat = 3 + takeBits(3);
+        } else {
+            repeat = 11 + takeBits(7);
+        }
+        if (n + repeat > total) {
+            throw std::runtime_error("Invalid deflate code lengths");
+        }
+        std::fill(codeLengths + n, codeLengths + n + repeat, value);
+        n += repeat;
+    }
+    if (codeLengths[256] == 0) {
+        throw std::runtime_error("Deflate block has no end code");
+    }
+
+    buildTable(literalTable, codeLengths, literalCount);
+    buildTable(distanceTable, codeLengths + literalCount, distanceCount);
+}
+
+void Inflater::beginBlock() {
+    if (finalBlock) {
+        state = State::Done;
+        return;
+    }
+    finalBlock = takeBits(1) != 0;
+    switch (takeBits(2)) {
+        case 0: {
+            takeBits(bitCount % 8);
+            uint32_t length = takeBits(16);
+            uint32_t complement = takeBits(16);
+            if ((length ^ 0xFFFF) != complement) {
+                throw std::runtime_error("Invalid stored deflate block");
+            }
+            storedRemaining = length;
+            state = State::Stored;
+            break;
+        }
+        case 1: {
+            uint8_t lengths[320];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            std::fill(lengths + 288, lengths + 320, 5);
+            buildTable(literalTable, lengths, 288);
+            buildTable(distanceTable, lengths + 288, 30);
+            state = State::Compressed;
+            break;
+        }
+        case 2:
+            readDynamicTables();
+            state = State::Compressed;
+            break;
+        default:
+            throw std::runtime_error("Invalid deflate block type");
+    }
+}
+
+// Decodes until the output buffer is full or the stream ends
+void Inflater::decode() {
+    constexpr uint32_t capacity = kWindowSize + kOutputSize;
+    uint8_t* out = output.get();
+    while (outputEnd < capacity) {
+        // A back-reference may be cut short by a full buffer and resume here
+        if (copyLength > 0) {
+            uint32_t count = std::min(copyLength, capacity - outputEnd);
+            const uint8_t* from = out + outputEnd - copyDistance;
+            if (copyDistance >= count) {
+                std::memcpy(out + outputEnd, from, count);
+            } else {
+                // Overlapping copy repeats the last copyDistance bytes
+                for (uint32_t i = 0; i < count; ++i) {
+                    out[outputEnd + i] = from[i];
+                }
+            }
+            outputEnd += count;
+            copyLength -= count;
+            continue;
+        }
+
+        switch (state) {
+            case State::BlockHeader:
+                beginBlock();
+                break;
+            case State::Stored: {
+                if (storedRemaining == 0) {
+                    state = State::BlockHeader;
+                    break;
+                }
+                // Bytes still in the bit buffer first, then straight from the input buffer
+                size_t count = bitCount >= 8 ? 0 : std::min<size_t>({storedRemaining, capacity - outputEnd, inputEnd - inputPosition});
+                if (count == 0) {
+                    out[outputEnd++] = static_cast<uint8_t>(takeBits(8));
+                    --storedRemaining;
+                    break;
+                }
+                std::memcpy(out + outputEnd, inputBuffer.data() + inputPosition, count);
+                inputPosition += count;
+                outputEnd += static_cast<uint32_t>(count);
+                storedRemaining -= static_cast<uint32_t>(count);
+                break;
+            }
+            case State::Compressed: {
+                uint32_t symbol = decodeSymbol(literalTable);
+                if (symbol < 256) {
+                    out[outputEnd++] = static_cast<uint8_t>(symbol);
+                } else if (symbol == 256) {
+                    state = State::BlockHeader;
+                } else {
+                    symbol -= 257;
+                    if (symbol >= 29) {
+                        throw std::runtime_error("Invalid deflate length code");
+                    }
+                    copyLength = kLengthBase[symbol] + takeBits(kLengthExtra[symbol]);
+                    uint32_t distanceSymbol = decodeSymbol(distanceTable);
+                    if (distanceSymbol >= 30) {
+                        throw std::runtime_error("Invalid deflate distance code");
+                    }
+                    copyDistance = kDistanceBase[distanceSymbol] + takeBits(kDistanceExtra[distanceSymbol]);
+                    // The buffer always holds at least a full window once it has slid
+                    if (copyDistance > outputEnd) {
+                        throw std::runtime_error("Deflate distance reaches before the stream start");
+                    }
+                }
+                break;
+            }
+            case State::Done:
+                return;
+        }
+    }
+}
+
+size_t Inflater::read(char* buffer, size_t size) {
+    size_t produced = 0;
+    while (produced < size) {
+        if (readPosition == outputEnd) {
+            if (state == State::Done) {
+                break;
+            }
+            if (outputEnd == kWindowSize + kOutputSize) {
+                std::memmove(output.get(), output.get() + outputEnd - kWindowSize, kWindowSize);
+                outputEnd = kWindowSize;
+                readPosition = kWindowSize;
+            }
+            decode();
+            continue;
+        }
+        size_t count = std::min<size_t>(size - produced, outputEnd - readPosition);
+        std::memcpy(buffer + produced, output.get() + readPosition, count);
+        readPosition += static_cast<uint32_t>(count);
+        produced += count;
+    }
+    return produced;
+}
+
+// ---------------------------------------------------------------------------
+// ZipReader
+
+ZipReader::ZipReader(const std::string& path) : file(path, std::ios::binary) {
+    if (!file) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    readCentralDirectory();
+}
+
+void ZipReader::readCentralDirectory() {
+    file.seekg(0, std::ios::end);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+    // The end-of-directory record sits in the last 22 bytes plus a comment of up to 64 KB
+    size_t tailSize = static_cast<size_t>(std::min<uint64_t>(fileSize, 22 + 65535));
+    std::vector<unsigned char> tail(tailSize);
+    file.seekg(static_cast<std::streamoff>(fileSize - tailSize));
+    readExactly(file, reinterpret_cast<char*>(tail.data()), tailSize);
+
+    size_t record = std::string::npos;
+    for (size_t i = tailSize >= 22 ? tailSize - 22 + 1 : 0; i-- > 0;) {
+        if (readLE(&tail[i], 4) == kEndOfDirectorySignature) {
+            record = i;
+            break;
+        }
+    }
+    if (record == std::string::npos) {
+        throw std::runtime_error("Not a ZIP archive");
+    }
+
+    uint64_t entryCount = readLE(&tail[record + 10], 2);
+    uint64_t directorySize = readLE(&tail[record + 12], 4);
+    uint64_t directoryOffset = readLE(&tail[record + 16], 4);
+
+    // Zip64: the real values live in a second record found through a locator
+    if (entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        if (record < 20 || readLE(&tail[record - 20], 4) != kZip64LocatorSignature) {
+            throw std::runtime_error("Missing Zip64 end of directory locator");
+        }
+        unsigned char zip64[56];
+        file.seekg(static_cast<std::streamoff>(readLE(&tail[record - 20 + 8], 8)));
+        readExactly(file, reinterpret_cast<char*>(zip64), sizeof(zip64));
+        if (readLE(zip64, 4) != kZip64EndOfDirectorySignature) {
+            throw std::runtime_error("Invalid Zip64 end of directory record");
+        }
+        entryCount = readLE(zip64 + 32, 8);
+        directorySize = readLE(zip64 + 40, 8);
+        directoryOffset = readLE(zip64 + 48, 8);
+    }
+    if (directoryOffset + directorySize > fileSize) {
+        throw std::runtime_error("Invalid ZIP central directory");
+    }
+
+    std::vector<unsigned char> directory(static_cast<size_t>(directorySize));
+    file.seekg(static_cast<std::streamoff>(directoryOffset));
+    readExactly(file, reinterpret_cast<char*>(directory.data()), directory.size());
+
+    entries.reserve(static_cast<size_t>(std::min<uint64_t>(entryCount, directorySize / 46)));
+    size_t position = 0;
+    for (uint64_t i = 0; i < entryCount; ++i) {
+        if (position + 46 > directory.size() || readLE(&directory[position], 4) != kCentralHeaderSignature) {
+            throw std::runtime_error("Invalid ZIP central directory entry");
+        }
+        const unsigned char* header = &directory[position];
+        size_t nameLength = static_cast<size_t>(readLE(header + 28, 2));
+        size_t extraLength = static_cast<size_t>(readLE(header + 30, 2));
+        size_t commentLength = static_cast<size_t>(readLE(header + 32, 2));
+        if (position + 46 + nameLength + extraLength + commentLength > directory.size()) {
+            throw std::runtime_error("Invalid ZIP central directory entry");
+        }
+        if (readLE(header + 8, 2) & 1) {
+            throw std::runtime_error("Encrypted ZIP entries are not supported");
+        }
+
+        Entry entry;
+        entry.method = static_cast<uint16_t>(readLE(header + 10, 2));
+        entry.crc = static_cast<uint32_t>(readLE(header + 16, 4));
+        entry.compressedSize = readLE(header + 20, 4);
+        entry.uncompressedSize = readLE(header + 24, 4);
+        entry.localHeaderOffset = readLE(header + 42, 4);
+        entry.name.assign(reinterpret_cast<const char*>(header + 46), nameLength);
+
+        // Zip64 extra field: 64-bit values for the fields saturated above, in this order
+        const unsigned char* extra = header + 46 + nameLength;
+        for (size_t offset = 0; offset + 4 <= extraLength;) {
+            uint16_t id = static_cast<uint16_t>(readLE(extra + offset, 2));
+            size_t size = static_cast<size_t>(readLE(extra + offset + 2, 2));
+            if (id == 0x0001) {
+                const unsigned char* field = extra + offset + 4;
+                const unsigned char* end = field + std::min(size, extraLength - offset - 4);
+                uint64_t* targets[3] = {&entry.uncompressedSize, &entry.compressedSize, &entry.localHeaderOffset};
+                for (uint64_t* target : targets) {
+                    if (*target == 0xFFFFFFFF && field + 8 <= end) {
+                        *target = readLE(field, 8);
+                        field += 8;
+                    }
+                }
+            }
+            offset += 4 + size;
+        }
+
+        entries.push_back(std::move(entry));
+        position += 46 + nameLength + extraLength + commentLength;
+    }
+}
+
+const ZipReader::Entry* ZipReader::findEntry(const std::string& name) const {
+    for (const auto& entry : entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+std::unique_ptr<ZipReader::EntryStream> ZipReader::open(const Entry& entry) {
+    file.clear();
+    return std::make_unique<EntryStream>(file, entry);
+}
+
+ZipReader::EntryStream::EntryStream(std::ifstream& file, const Entry& entry)
+    : file(file), entry(entry), remaining(entry.uncompressedSize) {
+    unsigned char header[30];
+    file.seekg(static_cast<std::streamoff>(entry.localHeaderOffset));
+    readExactly(file, reinterpret_cast<char*>(header), sizeof(header));
+    if (readLE(header, 4) != kLocalHeaderSignature) {
+        throw std::runtime_error("Invalid ZIP local header for " + entry.name);
+    }
+    file.seekg(static_cast<std::streamoff>(entry.localHeaderOffset + 30 + readLE(header + 26, 2) + readLE(header + 28, 2)));
+
+    if (entry.method == kMethodDeflated) {
+        inflater = std::make_unique<Inflater>(file, entry.compressedSize);
+    } else if (entry.method != kMethodStored) {
+        throw std::runtime_error("Unsupported compression method in " + entry.name);
+    }
+}
+
+size_t ZipReader::EntryStream::read(char* buffer, size_t size) {
+    size_t count = 0;
+    if (remaining > 0 && size > 0) {
+        size = static_cast<size_t>(std::min<uint64_t>(size, remaining));
+        if (inflater) {
+            count = inflater->read(buffer, size);
+        } else {
+            readExactly(file, buffer, size);
+            count = size;
+        }
+        remaining -= count;
+        crc = crc32(buffer, count, crc);
+    }
+    if (count == 0 && size > 0 && (remaining != 0 || crc != entry.crc)) {
+        throw std::runtime_error("Corrupt ZIP entry " + entry.name);
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+// ZipWriter
+
+namespace {
+constexpr uint32_t kHashBits = 15;
+constexpr uint32_t kMaxChain = 16;
+constexpr uint32_t kMaxMatch = 258;
+constexpr uint32_t kMaxDistance = 32768;
+// Fixed DOS timestamp (1980-01-01 00:00) keeps the output reproducible
+constexpr uint16_t kDosTime = 0;
+constexpr uint16_t kDosDate = (0 << 9) | (1 << 5) | 1;
+
+uint32_t hash3(const uint8_t* data) {
+    uint32_t value = (uint32_t(data[0]) << 16) | (uint32_t(data[1]) << 8) | data[2];
+    return (value * 2654435761u) >> (32 - kHashBits);
+}
+} // namespace
+
+ZipWriter::ZipWriter(const std::string& path) : file(path, std::ios::binary | std::ios::trunc) {
+    if (!file) {
+        throw std::runtime_error("Cannot create file: " + path);
+    }
+}
+
+void ZipWriter::writeRaw(const void* data, size_t size) {
+    if (!file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Failed to write ZIP archive");
+    }
+    offset += size;
+}
+
+void ZipWriter::beginEntry(const std::string& name) {
+    if (inEntry || finished) {
+        throw std::logic_error("ZIP entry already open");
+    }
+    Entry entry;
+    entry.name = name;
+    entry.localHeaderOffset = offset;
+
+    // CRC and sizes are patched in by endEntry()
+    std::vector<uint8_t> header;
+    appendLE(header, kLocalHeaderSignature, 4);
+    appendLE(header, 20, 2);
+    appendLE(header, 0, 2);
+    appendLE(header, kMethodDeflated, 2);
+    appendLE(header, kDosTime, 2);
+    appendLE(header, kDosDate, 2);
+    appendLE(header, 0, 4);
+    appendLE(header, 0, 4);
+    appendLE(header, 0, 4);
+    appendLE(header, name.size(), 2);
+    appendLE(header, 0, 2);
+    header.insert(header.end(), name.begin(), name.end());
+    writeRaw(header.data(), header.size());
+
+    entries.push_back(std::move(entry));
+    inEntry = true;
+    deflater.reset();
+}
+
+void ZipWriter::write(const char* data, size_t size) {
+    if (!inEntry) {
+        throw std::logic_error("No ZIP entry open");
+    }
+    Entry& entry = entries.back();
+    entry.crc = crc32(data, size, entry.crc);
+    entry.uncompressedSize += size;
+    deflater.write(reinterpret_cast<const uint8_t*>(data), size);
+    flushOutput();
+}
+
+void ZipWriter::endEntry() {
+    if (!inEntry) {
+        throw std::logic_error("No ZIP entry open");
+    }
+    deflater.finish();
+    flushOutput();
+    inEntry = false;
+
+    Entry& entry = entries.back();
+    uint64_t dataStart = entry.localHeaderOffset + 30 + entry.name.size();
+    entry.compressedSize = offset - dataStart;
+    if (offset > std::numeric_limits<uint32_t>::max() || entry.uncompressedSize > std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error("ZIP archive exceeds 4 GB");
+    }
+
+    std::vector<uint8_t> patch;
+    appendLE(patch, entry.crc, 4);
+    appendLE(patch, entry.compressedSize, 4);
+    appendLE(patch, entry.uncompressedSize, 4);
+    file.seekp(static_cast<std::streamoff>(entry.localHeaderOffset + 14));
+    file.write(reinterpret_cast<const char*>(patch.data()), static_cast<std::streamsize>(patch.size()));
+    file.seekp(static_cast<std::streamoff>(offset));
+    if (!file) {
+        throw std::runtime_error("Failed to write ZIP archive");
+    }
+}
+
+void ZipWriter::finish() {
+    if (inEntry) {
+        endEntry();
+    }
+    if (finished) {
+        return;
+    }
+    if (entries.size() >= 0xFFFF) {
+        throw std::length_error("Too many ZIP entries");
+    }
+
+    uint64_t directoryOffset = offset;
+    std::vector<uint8_t> directory;
+    for (const auto& entry : entries) {
+        appendLE(directory, kCentralHeaderSignature, 4);
+        appendLE(directory, 20, 2);
+        appendLE(directory, 20, 2);
+        appendLE(directory, 0, 2);
+        appendLE(directory, kMethodDeflated, 2);
+        appendLE(directory, kDosTime, 2);
+        appendLE(directory, kDosDate, 2);
+        appendLE(directory, entry.crc, 4);
+        appendLE(directory, entry.compressedSize, 4);
+        appendLE(directory, entry.uncompressedSize, 4);
+        appendLE(directory, entry.name.size(), 2);
+        appendLE(directory, 0, 2);
+        appendLE(directory, 0, 2);
+        appendLE(directory, 0, 2);
+        appendLE(directory, 0, 2);
+        appendLE(directory, 0, 4);
+        appendLE(directory, entry.localHeaderOffset, 4);
+        directory.insert(directory.end(), entry.name.begin(), entry.name.end());
+    }
+    appendLE(directory, kEndOfDirectorySignature, 4);
+    appendLE(directory, 0, 2);
+    appendLE(directory, 0, 2);
+    appendLE(directory, entries.size(), 2);
+    appendLE(directory, entries.size(), 2);
+    appendLE(directory, directory.size() - 4 - 2 - 2 - 2 - 2, 4);
+    appendLE(directory, directoryOffset, 4);
+    appendLE(directory, 0, 2);
+    writeRaw(directory.data(), directory.size());
+    file.flush();
+    if (!file || offset > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Failed to write ZIP archive");
+    }
+    finished = true;
+}
+
+void Deflater::putBits(uint32_t value, uint32_t count) {
+    bitBuffer |= static_cast<uint64_t>(value) << bitCount;
+    bitCount += count;
+    while (bitCount >= 8) {
+        output.push_back(static_cast<uint8_t>(bitBuffer));
+        bitBuffer >>= 8;
+        bitCount -= 8;
+    }
+}
+
+// Fixed Huffman code of a literal/length symbol (RFC 1951, 3.2.6)
+void Deflater::putLiteral(uint32_t symbol) {
+    uint32_t code;
+    uint32_t length;
+    if (symbol < 144) {
+        code = 0x30 + symbol;
+        length = 8;
+    } else if (symbol < 256) {
+        code = 0x190 + (symbol - 144);
+        length = 9;
+    } else if (symbol < 280) {
+        code = symbol - 256;
+        length = 7;
+    } else {
+        code = 0xC0 + (symbol - 280);
+        length = 8;
+    }
+    putBits(reverseBits(code, length), length);
+}
+
+void Deflater::putMatch(uint32_t length, uint32_t distance) {
+    uint32_t lengthCode = static_cast<uint32_t>(std::upper_bound(kLengthBase, kLengthBase + 29, length) - kLengthBase - 1);
+    putLiteral(257 + lengthCode);
+    putBits(length - kLengthBase[lengthCode], kLengthExtra[lengthCode]);
+
+    uint32_t distanceCode =
+        static_cast<uint32_t>(std::upper_bound(kDistanceBase, kDistanceBase + 30, distance) - kDistanceBase - 1);
+    putBits(reverseBits(distanceCode, 5), 5);
+    putBits(distance - kDistanceBase[distanceCode], kDistanceExtra[distanceCode]);
+}
+
+Deflater::Deflater() : head(size_t(1) << kHashBits), previous(kBlockSize) {
+    pending.reserve(kBlockSize);
+}
+
+void Deflater::reset() {
+    pending.clear();
+    output.clear();
+    bitBuffer = 0;
+    bitCount = 0;
+}
+
+void Deflater::write(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t count = std::min(size, kBlockSize - pending.size());
+        pending.insert(pending.end(), data, data + count);
+        data += count;
+        size -= count;
+        if (pending.size() == kBlockSize) {
+            compressBlock(false);
+        }
+    }
+}
+
+void Deflater::finish() {
+    compressBlock(true);
+    if (bitCount > 0) {
+        output.push_back(static_cast<uint8_t>(bitBuffer));
+        bitBuffer = 0;
+        bitCount = 0;
+    }
+}
+
+// Compresses the pending input as one fixed-Huffman block. Matches are found
+// within the block only, which costs little ratio on 64 KB blocks of XML.
+void Deflater::compressBlock(bool finalBlock) {
+    putBits(finalBlock ? 1 : 0, 1);
+    putBits(1, 2);
+
+    const uint8_t* data = pending.data();
+    const int32_t size = static_cast<int32_t>(pending.size());
+    std::fill(head.begin(), head.end(), -1);
+    auto insert = [&](int32_t position) {
+        if (position + 3 <= size) {
+            uint32_t hash = hash3(data + position);
+            previous[position] = head[hash];
+            head[hash] = position;
+        }
+    };
+
+    for (int32_t position = 0; position < size;) {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        if (position + 3 <= size) {
+            uint32_t limit = static_cast<uint32_t>(std::min<int32_t>(kMaxMatch, size - position));
+            int32_t candidate = head[hash3(data + position)];
+            for (uint32_t chain = 0; candidate >= 0 && chain < kMaxChain &&
+                                     static_cast<uint32_t>(position - candidate) <= kMaxDistance; ++chain) {
+                if (data[candidate + bestLength] == data[position + bestLength]) {
+                    uint32_t length = 0;
+                    while (length < limit && data[candidate + length] == data[position + length]) {
+                        ++length;
+                    }
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = static_cast<uint32_t>(position - candidate);
+                        if (length == limit) {
+                            break;
+                        }
+                    }
+                }
+                candidate = previous[candidate];
+            }
+        }
+
+        if (bestLength >= 3) {
+            putMatch(bestLength, bestDistance);
+            for (uint32_t i = 0; i < bestLength; ++i) {
+                insert(position + static_cast<int32_t>(i));
+            }
+            position += static_cast<int32_t>(bestLength);
+        } else {
+            putLiteral(data[position]);
+            insert(position);
+            ++position;
+        }
+    }
+    putLiteral(256);
+
+    pending.clear();
+}
+
+void ZipWriter::flushOutput() {
+    std::vector<uint8_t>& output = deflater.getOutput();
+    if (!output.empty()) {
+        writeRaw(output.data(), output.size());
+        output.clear();
+    }
+}
+
+} // namespace ExcelCore
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ExcelCore {
+
+// CRC-32 (IEEE) as used by ZIP; pass the previous result to continue a running checksum
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// Streaming decoder for raw DEFLATE data (RFC 1951). Output is decoded into
+// a fixed buffer that also serves as the 32 KB history window and handed out
+// on demand, so memory stays constant no matter how large the stream is.
+class Inflater {
+public:
+    explicit Inflater(std::ifstream& input, uint64_t compressedSize);
+
+    // Fills up to size bytes and returns how many were written; 0 at the end of the stream
+    size_t read(char* buffer, size_t size);
+
+private:
+    static constexpr uint32_t kWindowSize = 32768;
+    static constexpr uint32_t kOutputSize = 64 * 1024;
+    static constexpr uint32_t kFastBits = 10;
+
+    // Canonical Huffman code: a lookup table for codes up to kFastBits long and
+    // per-length symbol lists for the rest
+    struct HuffmanTable {
+        std::array<uint16_t, 1u << kFastBits> fast{};  // symbol << 4 | length, 0 = slow path
+        std::array<uint16_t, 16> counts{};
+        std::array<uint16_t, 288> symbols{};
+    };
+
+    enum class State : uint8_t {
+        BlockHeader,
+        Stored,
+        Compressed,
+        Done
+    };
+
+    std::ifstream& input;
+    uint64_t remainingInput;
+    std::vector<char> inputBuffer;
+    size_t inputPosition = 0;
+    size_t inputEnd = 0;
+    uint32_t paddingBytes = 0;
+
+    uint64_t bitBuffer = 0;
+    uint32_t bitCount = 0;
+
+    State state = State::BlockHeader;
+    bool finalBlock = false;
+    uint32_t storedRemaining = 0;
+    uint32_t copyLength = 0;
+    uint32_t copyDistance = 0;
+
+    // History followed by fresh output: [0, outputEnd) is decoded, [readPosition,
+    // outputEnd) not yet returned. When full, the last kWindowSize bytes slide to the front.
+    std::unique_ptr<uint8_t[]> output;
+    uint32_t outputEnd = 0;
+    uint32_t readPosition = 0;
+
+    HuffmanTable literalTable;
+    HuffmanTable distanceTable;
+
+    uint8_t nextByte();
+    void needBits(uint32_t count);
+    uint32_t takeBits(uint32_t count);
+    void beginBlock();
+    void readDynamicTables();
+    static void buildTable(HuffmanTable& table, const uint8_t* lengths, uint32_t count);
+    uint32_t decodeSymbol(const HuffmanTable& table);
+    void decode();
+};
+
+// Read access to the entries of a ZIP archive (the container of XLSX files).
+// Only the central directory is loaded up front; entries are decompressed as
+// they are read. Supports stored and deflated entries and Zip64 archives.
+class ZipReader {
+public:
+    struct Entry {
+        std::string name;
+        uint16_t method = 0;
+        uint32_t crc = 0;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t localHeaderOffset = 0;
+    };
+
+    // Sequential reader for one entry; verifies the CRC when the end is reached
+    class EntryStream {
+    public:
+        EntryStream(std::ifstream& file, const Entry& entry);
+
+        size_t read(char* buffer, size_t size);
+
+    private:
+        std::ifstream& file;
+        Entry entry;
+        std::unique_ptr<Inflater> inflater;
+        uint64_t remaining;
+        uint32_t crc = 0;
+    };
+
+    explicit ZipReader(const std::string& path);
+
+    // Returns nullptr if the archive has no entry with that name
+    const Entry* findEntry(const std::string& name) const;
+
+    const std::vector<Entry>& getEntries() const {
+        return entries;
+    }
+
+    // Only one stream may be read at a time: they share the file handle
+    std::unique_ptr<EntryStream> open(const Entry& entry);
+
+private:
+    std::ifstream file;
+    std::vector<Entry> entries;
+
+    void readCentralDirectory();
+};
+
+// Raw DEFLATE compressor (RFC 1951): fixed Huffman codes, with hash-chain
+// matching within blocks of kBlockSize bytes. Input is buffered one block at
+// a time and compressed bytes collect in getOutput(), which the caller drains.
+class Deflater {
+public:
+    static constexpr size_t kBlockSize = 64 * 1024;
+
+    Deflater();
+
+    void write(const uint8_t* data, size_t size);
+
+    // Compresses the buffered input as the final block and pads the output to
+    // a whole byte; reset() starts the next stream
+    void finish();
+    void reset();
+
+    std::vector<uint8_t>& getOutput() {
+        return output;
+    }
+
+private:
+    std::vector<uint8_t> pending;          // uncompressed input of the current block
+    std::vector<uint8_t> output;           // compressed bytes not yet taken
+    std::vector<int32_t> head;             // hash -> latest position in the block
+    std::vector<int32_t> previous;         // position -> earlier position with the same hash
+    uint64_t bitBuffer = 0;
+    uint32_t bitCount = 0;
+
+    void compressBlock(bool finalBlock);
+    void putBits(uint32_t value, uint32_t count);
+    void putLiteral(uint32_t symbol);
+    void putMatch(uint32_t length, uint32_t distance);
+};
+
+// Writes a ZIP archive entry by entry. Entry data is streamed through a
+// Deflater, so only one block of input is held in memory. Archives are
+// limited to 4 GB (no Zip64).
+class ZipWriter {
+public:
+    static constexpr size_t kBlockSize = Deflater::kBlockSize;
+
+    explicit ZipWriter(const std::string& path);
+
+    ZipWriter(const ZipWriter&) = delete;
+    ZipWriter& operator=(const ZipWriter&) = delete;
+
+    void beginEntry(const std::string& name);
+    void write(const char* data, size_t size);
+    void write(const std::string& text) {
+        write(text.data(), text.size());
+    }
+    void endEntry();
+
+    // Writes the central directory; the archive is incomplete without it
+    void finish();
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t crc = 0;
+        uint64_t compressedSize = 0;
+        uint64_t uncompressedSize = 0;
+        uint64_t localHeaderOffset = 0;
+    };
+
+    std::ofstream file;
+    uint64_t offset = 0;
+    std::vector<Entry> entries;
+    bool inEntry = false;
+    bool finished = false;
+    Deflater deflater;
+
+    void flushOutput();
+    void writeRaw(const void* data, size_t size);
+};
+
+} // namespace ExcelCore
+
+// TODO: Add Zip64 output for archives over 4 GB
+// TODO: Use dynamic Huffman blocks when writing for a better compression ratio